@@ -18,25 +18,44 @@ void UDPEventSender::begin(IPAddress target, uint16_t port, uint16_t localPort)
 }
 
 void UDPEventSender::loop() {
-  
-  int packetSize = m_udp.parsePacket();
-  if (packetSize <= 0) return;
-
-  
-  static uint8_t buf[1472];
-  int len = m_udp.read(buf, sizeof(buf));
-  if (len <= 0) return;
-
-  if (m_onReceive) {
-    IPAddress remote = m_udp.remoteIP();
-    uint16_t rport = m_udp.remotePort();
-    m_onReceive(buf, (size_t)len, remote, rport);
+
+  // Drain everything lwIP has queued (bounded by the budget) so bursts
+  // do not pile up between polls and delay the datagrams behind them.
+  uint32_t n = 0;
+  while (n < m_budget) {
+    int packetSize = m_udp.parsePacket();
+    if (packetSize <= 0) break;
+
+    int len = m_udp.read(m_buf, sizeof(m_buf));
+    if (packetSize > (int)sizeof(m_buf)) {
+      // discard the unread tail, otherwise parsePacket() stalls on it
+      m_udp.flush();
+      m_stats.truncated++;
+    }
+    n++;
+    if (len <= 0) continue;
+
+    m_stats.packets++;
+    if (m_onReceive) {
+      IPAddress remote = m_udp.remoteIP();
+      uint16_t rport = m_udp.remotePort();
+      m_onReceive(m_buf, (size_t)len, remote, rport);
+    }
   }
+
+  if (n == 0) return;
+  m_stats.polls++;
+  if (n > m_stats.maxBatch) m_stats.maxBatch = n;
+  if (n == m_budget) m_stats.budgetHits++;
 }
 
 bool UDPEventSender::sendBytes(const uint8_t* data, size_t len) {
+  return sendBytesTo(m_target, m_port, data, len);
+}
+
+bool UDPEventSender::sendBytesTo(IPAddress target, uint16_t port, const uint8_t* data, size_t len) {
 
-  if (m_udp.beginPacket(m_target, m_port)) {
+  if (m_udp.beginPacket(target, port)) {
     m_udp.write(data, len);
     m_udp.endPacket();
     return true;
@@ -10,30 +10,53 @@
 class UDPEventSender {
 public:
 
-
-
-  // Poll incoming packets; must be called in loop()
+  // Receive counters, updated by loop()
+  struct Stats {
+    uint32_t packets;      // datagrams handed to the receive handler
+    uint32_t truncated;    // datagrams larger than the receive buffer (tail dropped)
+    uint32_t polls;        // loop() calls that found at least one datagram
+    uint32_t maxBatch;     // most datagrams drained by a single loop() call
+    uint32_t budgetHits;   // loop() calls that stopped at the budget with data possibly still queued
+  };
+
+  // Drain pending packets (up to the receive budget); must be called in loop()
   void loop();
 
   // Register data receive handler (optional)
   using ReceiveHandler = std::function<void(const uint8_t*, size_t, const IPAddress&, uint16_t)>;
   void onReceive(ReceiveHandler cb) { m_onReceive = cb; }
 
+  // Maximum datagrams processed per loop() call (default 16, minimum 1)
+  void setReceiveBudget(uint8_t budget) { m_budget = budget ? budget : 1; }
+
+  const Stats& stats() const { return m_stats; }
 
   void begin(IPAddress target, uint16_t port, uint16_t localPort = 0);
 
 
 
 
+  // Change the send target without rebinding the socket
+  void setTarget(IPAddress target) { m_target = target; }
+  IPAddress target() const { return m_target; }
+
   // Raw bytes sender (binary payload)
   bool sendBytes(const uint8_t* data, size_t len);
 
+  // Raw bytes to an explicit destination (shared socket, several peers)
+  bool sendBytesTo(IPAddress target, uint16_t port, const uint8_t* data, size_t len);
+
 
 private:
   WiFiUDP   m_udp;
   IPAddress m_target;
   uint16_t  m_port = 0;
-  
+  uint8_t   m_budget = 16;
+  Stats     m_stats = {};
+
+  // Per-instance receive buffer; valid only for the duration of the handler call
+  uint8_t   m_buf[1472];
+
   // Receive callback
   ReceiveHandler m_onReceive = nullptr;
 };
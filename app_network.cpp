@@ -5,6 +5,10 @@
 #include <ArduinoJson.h>
 #include "workout_manager.h"
 #include "workout_storage.h"
+#include "swim_machine.h"
+#include "packet_capture.h"
+#include "request_ids.h"
+#include <memory>
 #include "hub75.h"
 #include "otapassword.h"
 
@@ -12,6 +16,7 @@
 /* Internal singletons */
 static AsyncWebServer g_server(80);
 static AsyncEventSource g_sse("/events");
+static AsyncWebSocket g_ws("/ws");
 
 
 namespace AppNetwork
@@ -21,6 +26,11 @@ static const uint32_t maxJsonSize = 1024 * 8;
 
 static const size_t kPSKLen = 10; // PSK = first 10 chars of OTA_PASSWORD
 
+// WebSocket handlers, defined with their sections below
+static void send_packets();
+static void ws_event(AsyncWebSocket *, AsyncWebSocketClient *c, AwsEventType type, void *arg, uint8_t *data, size_t len);
+static void rest_control(AsyncWebServerRequest *r, const char *op, size_t m, const String &workout);
+
  // Check PSK from header X-PSK (case-insensitive), or query/body param "psk"
 static bool check_psk(AsyncWebServerRequest* r) {
   auto getHeaderCaseInsensitive = [&](const char* name) -> String {
@@ -105,6 +115,22 @@ static bool require_id(AsyncWebServerRequest *r, String &id)
   return true;
 }
 
+// helper: optional ?m= machine index (default 0)
+static bool require_machine(AsyncWebServerRequest *r, size_t &m)
+{
+  m = 0;
+  if (!r->hasParam("m"))
+    return true;
+  long v = r->getParam("m")->value().toInt();
+  if (v < 0 || v >= (long)SwimMachine::kMaxMachines)
+  {
+    r->send(400, "text/plain", "bad m");
+    return false;
+  }
+  m = (size_t)v;
+  return true;
+}
+
 static void serve_index(AsyncWebServerRequest *req)
 {
   // When only SoftAP is active (no STA/Ethernet), redirect to Wi-Fi setup page
@@ -154,8 +180,303 @@ static void addCaptivePortalRoutes()
 
 }
 
+/* ---------- SSE /events: per-client budgets ---------------------- */
+// Everything pushed on the stream is a state snapshot (plan, progress,
+// ping), so a client that falls behind only needs the newest event of each
+// name. A client may have kSseBudget messages waiting in its queue; past
+// that an event is not queued but marks the client stale for that name,
+// and loop() sends it the latest payload once its queue drains. A client
+// whose queue stays full for kSseSlowMs (a phone that locked its screen)
+// is disconnected, and at most kMaxSseClients are admitted (one that gets
+// past the filter concurrently is told so and closed). What the stream
+// holds in the heap is bounded by clients x budget, however long a client
+// has been stuck.
+//
+// Every event carries an id, increasing from boot to reboot. A
+// client that connects gets the cached plan of each machine and a fresh
+// progress from the next loop(), so nothing waits for the next push. When an
+// EventSource reconnects it sends the last id it saw (Last-Event-ID), and
+// a plan it already has is not sent again. Ids start at a random value
+// each boot, so an id from before a reboot is not taken for a recent one.
+static const size_t kMaxSseClients = 8;
+static const size_t kSseSpare = 4;        // entries for clients waiting to be refused
+static const size_t kSseBudget = 4;       // messages waiting per client
+static const uint32_t kSseSlowMs = 10000; // queue full this long: disconnect
+static const size_t kSseEvents = 2 * SwimMachine::kMaxMachines + 2; // plan/progress per lane, ping
+static const size_t kSseNameLen = 16;
+static const uint32_t kSseRetryMs = 1000; // EventSource reconnect delay
+static const uint32_t kSseBusyRetryMs = 10000; // ... after being refused
+
+static struct
+{
+  AsyncEventSourceClient *client; // nullptr = free
+  uint32_t stale;                 // bit per s_latest entry not yet delivered
+  uint32_t fullSinceMs;           // 0 = queue below budget
+  bool refused;                   // over the limit: closed by the next loop()
+  bool greet;                     // connected: plan and progress due from loop()
+} s_sseClients[kMaxSseClients + kSseSpare];
+
+// Latest payload per event name, for stale and connecting clients
+static struct
+{
+  char name[kSseNameLen]; // "" = free
+  String json;
+  uint32_t id;
+} s_latest[kSseEvents];
+
+static uint32_t s_firstId = 1; // first event id of this boot
+static uint32_t s_lastId = 0;  // last one sent
+
+static struct
+{
+  uint32_t clients, clientsMax, rejected, slowClosed;
+  uint32_t queued, queuedBytes;   // events handed to client queues
+  uint32_t dropped, droppedBytes; // events not queued for a full client
+  uint32_t resent;                // latest payloads sent once a queue drained
+} s_sse;
+
+// Never held while another lock is taken, see sse_service().
+// Created in begin(); nothing is pushed before that.
+static SemaphoreHandle_t s_sseLock = nullptr;
+
+struct SseLock
+{
+  SseLock() { xSemaphoreTakeRecursive(s_sseLock, portMAX_DELAY); }
+  ~SseLock() { xSemaphoreGiveRecursive(s_sseLock); }
+};
+
+static bool sse_admit(AsyncWebServerRequest *)
+{
+  return s_sse.clients < kMaxSseClients; // refused requests get a 404
+}
+
+// Index of event e in s_latest, -1 if it has not been pushed
+static int find_latest(const char *e)
+{
+  for (size_t i = 0; i < kSseEvents; ++i)
+    if (s_latest[i].name[0] && !strcmp(s_latest[i].name, e))
+      return (int)i;
+  return -1;
+}
+
+// Store j as the latest payload of event e; its s_latest index, -1 if
+// there is no room (the event is then only dropped for full clients)
+static int remember_latest(const char *e, const char *j, uint32_t id)
+{
+  if (strlen(e) >= kSseNameLen)
+    return -1;
+  int slot = -1;
+  for (size_t i = 0; i < kSseEvents; ++i)
+  {
+    if (!strcmp(s_latest[i].name, e))
+    {
+      s_latest[i].json = j; // reuses the buffer once it has grown
+      s_latest[i].id = id;
+      return (int)i;
+    }
+    if (slot < 0 && !s_latest[i].name[0])
+      slot = (int)i;
+  }
+  if (slot >= 0)
+  {
+    strcpy(s_latest[slot].name, e);
+    s_latest[slot].json = j;
+    s_latest[slot].id = id;
+  }
+  return slot;
+}
+
+// Runs with the library's client list lock held: only s_sseLock is taken
+// in here. The progress is built by loop() (see sse_service()), not here:
+// that takes the protocol lock, and closing a client takes the list lock.
+static void sse_connect(AsyncEventSourceClient *client)
+{
+  SseLock lock;
+  for (auto &s : s_sseClients)
+    if (!s.client)
+    {
+      s.client = client;
+      s.stale = 0;
+      s.fullSinceMs = 0;
+      s.refused = s_sse.clients >= kMaxSseClients;
+      s.greet = !s.refused;
+      if (s.refused)
+      { // not closed from in here: the library holds its client list lock
+        s_sse.rejected++;
+        client->send("{\"error\":\"too many clients\"}", "busy", 0, kSseBusyRetryMs);
+        return;
+      }
+      if (++s_sse.clients > s_sse.clientsMax)
+        s_sse.clientsMax = s_sse.clients;
+      return;
+    }
+  // every spare entry waiting too: cannot happen with sse_admit() in front
+  s_sse.rejected++;
+}
+
+static void sse_disconnect(AsyncEventSourceClient *client)
+{
+  SseLock lock;
+  for (auto &s : s_sseClients)
+    if (s.client == client)
+    {
+      s.client = nullptr;
+      if (!s.refused)
+        s_sse.clients--;
+    }
+}
+
+void push_event(const char *e, const char *j)
+{
+  if (!s_sseLock)
+    return;
+  SseLock lock;
+  uint32_t id = ++s_lastId;
+  int latest = remember_latest(e, j, id);
+  uint32_t bit = latest < 0 ? 0 : 1u << latest;
+  size_t len = strlen(j);
+  for (auto &s : s_sseClients)
+  {
+    if (!s.client || s.refused)
+      continue;
+    if (s.client->packetsWaiting() >= kSseBudget)
+    {
+      s.stale |= bit;
+      s_sse.dropped++;
+      s_sse.droppedBytes += len;
+      continue;
+    }
+    s.stale &= ~bit; // this one is newer
+    s.client->send(j, e, id);
+    s_sse.queued++;
+    s_sse.queuedBytes += len;
+  }
+}
+
+// Greet new clients, resend the latest of each stale event to clients
+// whose queue drained, and disconnect clients that stayed full.
+// s_sseLock is never held while another lock is taken: the progress of a
+// greeting is built before, and clients are closed after (closing takes
+// the library's client list lock, which sse_connect() is called under).
+static void sse_service()
+{
+  if (!s_sseLock)
+    return;
+  uint32_t now = millis();
+  bool greet = false;
+  {
+    SseLock lock;
+    for (auto &s : s_sseClients)
+      greet |= s.client && s.greet;
+  }
+  String progress[SwimMachine::kMaxMachines];
+  size_t n = 0;
+  if (greet)
+  {
+    n = SwimMachine::machineCount();
+    for (size_t m = 0; m < n; ++m)
+      progress[m] = WorkoutManager::progress_json(m); // a cached one has old clocks
+  }
+
+  AsyncEventSourceClient *drop[kMaxSseClients + kSseSpare];
+  size_t drops = 0;
+  {
+    SseLock lock;
+    for (auto &s : s_sseClients)
+    {
+      if (!s.client)
+        continue;
+      if (s.refused)
+      {
+        drop[drops++] = s.client; // sse_disconnect() frees the entry
+        continue;
+      }
+      if (s.greet && greet)
+      { // the loaded workout (unless the client resumes past it) and the
+        // progress of every machine; after that only changes are pushed
+        s.greet = false;
+        uint32_t last = s.client->lastId();
+        bool resume = last >= s_firstId && last <= s_lastId;
+        for (size_t m = 0; m < n; ++m)
+        {
+          String suffix = m ? String((unsigned)m) : String();
+          int plan = find_latest(("plan" + suffix).c_str());
+          if (plan >= 0 && !(resume && s_latest[plan].id <= last))
+            s.client->send(s_latest[plan].json.c_str(), s_latest[plan].name, s_latest[plan].id);
+          s.client->send(progress[m].c_str(), ("progress" + suffix).c_str(), ++s_lastId, kSseRetryMs);
+        }
+        continue;
+      }
+      if (s.client->packetsWaiting() >= kSseBudget)
+      {
+        if (!s.fullSinceMs)
+          s.fullSinceMs = now | 1;
+        else if (now - s.fullSinceMs > kSseSlowMs)
+        {
+          s_sse.slowClosed++;
+          drop[drops++] = s.client;
+        }
+        continue;
+      }
+      s.fullSinceMs = 0;
+      for (size_t i = 0; s.stale && i < kSseEvents; ++i)
+      {
+        if (!(s.stale & (1u << i)))
+          continue;
+        if (s.client->packetsWaiting() >= kSseBudget)
+          break;
+        s.client->send(s_latest[i].json.c_str(), s_latest[i].name, s_latest[i].id);
+        s.stale &= ~(1u << i);
+        s_sse.resent++;
+        s_sse.queued++;
+        s_sse.queuedBytes += s_latest[i].json.length();
+      }
+    }
+  }
+  for (size_t i = 0; i < drops; ++i)
+    drop[i]->close(); // sse_disconnect() frees the entry
+}
+
+static void sse_stats_json(JsonObject o)
+{
+  SseLock lock;
+  o["clients"] = s_sse.clients;
+  o["clients_max"] = s_sse.clientsMax;
+  o["rejected"] = s_sse.rejected;
+  o["slow_closed"] = s_sse.slowClosed;
+  o["queued"] = s_sse.queued;
+  o["queued_bytes"] = s_sse.queuedBytes;
+  o["dropped"] = s_sse.dropped;
+  o["dropped_bytes"] = s_sse.droppedBytes;
+  o["resent"] = s_sse.resent;
+  o["last_id"] = s_lastId;
+  size_t waiting = 0;
+  for (auto &s : s_sseClients)
+    if (s.client)
+      waiting += s.client->packetsWaiting();
+  o["waiting"] = waiting;
+}
+
+void loop()
+{
+  sse_service();
+  send_packets();
+  g_ws.cleanupClients(); // drop closed WebSocket clients
+}
+
 void begin()
 {
+  g_ws.onEvent(ws_event);
+  g_server.addHandler(&g_ws);
+
+  // Event stream: bounded per-client queues, see the /events section
+  s_sseLock = xSemaphoreCreateRecursiveMutex();
+  s_firstId = (esp_random() >> 1) | 1; // never 0, which means "no id"
+  s_lastId = s_firstId - 1;
+  g_sse.setFilter(sse_admit);
+  g_sse.onConnect(sse_connect);
+  g_sse.onDisconnect(sse_disconnect);
+
   // Ensure SSE handler is present
   g_server.addHandler(&g_sse);
 
@@ -320,7 +641,12 @@ void begin()
                   r->send(400);
                   return;
                 }
-                WorkoutStorage::save(w);
+                if (!WorkoutStorage::save(w))
+                {
+                  r->send(500, "text/plain", "save failed");
+                  return;
+                }
+                WorkoutManager::workout_changed(w.id);
                 send_json(r, WorkoutStorage::to_json(w));
               });
 
@@ -335,34 +661,244 @@ void begin()
                   r->send(404);
                   return;
                 }
+                WorkoutManager::workout_changed(id);
                 r->send(200); });
 
-  // API: run only the specified workout
+  // API: run only the specified workout [on machine ?m=]
   g_server.on("/api/run", HTTP_POST, [](AsyncWebServerRequest *r)
               {
                 String id;
-                if (!require_id(r, id))
+                size_t m;
+                if (!require_id(r, id) || !require_machine(r, m))
                   return;
-                if (!WorkoutManager::run(id))
+                if (r->hasParam("rid"))
+                  return rest_control(r, "run", m, id);
+                if (!WorkoutManager::run(id, m))
                 {
                   r->send(404, "text/plain", "could not start workout");
                   return;
                 }
                 r->send(200, "text/plain", "OK"); });
 
-  // API: pause & stop
+  // API: stage a workout for a quick start [on machine ?m=]; /api/go starts it
+  g_server.on("/api/arm", HTTP_POST, [](AsyncWebServerRequest *r)
+              {
+                String id;
+                size_t m;
+                if (!require_id(r, id) || !require_machine(r, m))
+                  return;
+                if (r->hasParam("rid"))
+                  return rest_control(r, "arm", m, id);
+                if (!WorkoutManager::arm(id, m))
+                {
+                  r->send(409, "text/plain", SwimMachine::motorRunning(m) ? "machine is running" : "could not arm workout");
+                  return;
+                }
+                r->send(200, "text/plain", "OK"); });
+
+  g_server.on("/api/go", HTTP_POST, [](AsyncWebServerRequest *r)
+              {
+                size_t m;
+                if (!require_machine(r, m))
+                  return;
+                if (r->hasParam("rid"))
+                  return rest_control(r, "go", m, String());
+                if (!WorkoutManager::go(m))
+                {
+                  r->send(409, "text/plain", "not armed");
+                  return;
+                }
+                r->send(200, "text/plain", "OK"); });
+
+  // API: pause & stop [machine ?m=]
   g_server.on("/api/pause", HTTP_POST, [](AsyncWebServerRequest *r)
               {
-                WorkoutManager::pause();
+                size_t m;
+                if (!require_machine(r, m))
+                  return;
+                WorkoutManager::pause(m);
                 r->send(200); });
 
   g_server.on("/api/stop", HTTP_POST, [](AsyncWebServerRequest *r)
               {
-                WorkoutManager::stop();
+                size_t m;
+                if (!require_machine(r, m))
+                  return;
+                WorkoutManager::stop(m);
                 r->send(200); });
 
+  // API: machines known to this controller
+  g_server.on("/api/machines", HTTP_GET, [](AsyncWebServerRequest *r)
+              {
+                StaticJsonDocument<1024> d;
+                auto arr = d.to<JsonArray>();
+                size_t n = SwimMachine::machineCount();
+                for (size_t m = 0; m < n; ++m)
+                {
+                  SwimMachine::SwimStatus st = SwimMachine::getStatus(m);
+                  JsonObject o = arr.createNestedObject();
+                  o["m"] = m;
+                  o["ip"] = SwimMachine::machineIP(m).toString();
+                  o["peer"] = st.peer.toString();
+                  o["link"] = st.found ? "up" : (st.everFound ? "lost" : "searching");
+                  o["running"] = st.active;
+                  o["paused"] = st.paused;
+                  o["armed"] = st.armed;
+                }
+                String out;
+                serializeJson(d, out);
+                send_json(r, out); });
+
+  // API: per-segment timing of the current/last workout [machine ?m=]
+  g_server.on("/api/segments", HTTP_GET, [](AsyncWebServerRequest *r)
+              {
+                size_t m;
+                if (!require_machine(r, m))
+                  return;
+                std::vector<SwimMachine::SegmentReport> rep = SwimMachine::getSegmentReport(m);
+                DynamicJsonDocument d(256 + rep.size() * 160);
+                d["warp"] = SwimClock::warp();
+                JsonArray arr = d.createNestedArray("segments");
+                for (size_t i = 0; i < rep.size(); ++i)
+                {
+                  const auto &s = rep[i];
+                  JsonObject o = arr.createNestedObject();
+                  o["i"] = i;
+                  o["planned_ms"] = s.plannedMs;
+                  o["issued_ms"] = s.issuedMs;
+                  if (s.atSpeedMs >= 0)
+                  {
+                    o["at_speed_ms"] = s.atSpeedMs;
+                    o["err_ms"] = s.atSpeedMs - (int32_t)s.plannedMs;
+                  }
+                  o["commands"] = s.commands;
+                  o["retransmits"] = s.retransmits;
+                }
+                String out; serializeJson(d, out);
+                send_json(r, out); });
+
+#ifdef SWIM_CLOCK_WARP
+  // API: run the workout clock ?warp=N times faster (1 = real time)
+  g_server.on("/api/clock", HTTP_POST, [](AsyncWebServerRequest *r)
+              {
+                if (!r->hasParam("warp")) { r->send(400, "text/plain", "missing warp"); return; }
+                long f = r->getParam("warp")->value().toInt();
+                if (f < 1 || f > 1000) { r->send(400, "text/plain", "warp 1..1000"); return; }
+                SwimMachine::setClockWarp((uint16_t)f);
+                r->send(200); });
+#endif
+
+  // API: command send window [machine ?m=]; 1 = stop-and-wait
+  g_server.on("/api/protocol", HTTP_POST, [](AsyncWebServerRequest *r)
+              {
+                size_t m;
+                if (!require_machine(r, m))
+                  return;
+                if (!r->hasParam("window")) { r->send(400, "text/plain", "missing window"); return; }
+                long n = r->getParam("window")->value().toInt();
+                if (n < 1 || n > SwimMachine::kMaxSendWindow) { r->send(400, "text/plain", "window 1..4"); return; }
+                SwimMachine::setSendWindow((uint8_t)n, m);
+                r->send(200); });
+
+  // API: captured swim-machine packets as a pcap file (streamed)
+  g_server.on("/api/capture.pcap", HTTP_GET, [](AsyncWebServerRequest *r)
+              {
+                auto cur = std::make_shared<PacketCapture::Cursor>();
+                PacketCapture::startExport(*cur);
+                AsyncWebServerResponse *resp = r->beginChunkedResponse(
+                    "application/vnd.tcpdump.pcap",
+                    [cur](uint8_t *buf, size_t maxLen, size_t) -> size_t
+                    { return PacketCapture::read(*cur, buf, maxLen); });
+                resp->addHeader("Content-Disposition", "attachment; filename=\"swim.pcap\"");
+                r->send(resp); });
+
+  g_server.on("/api/capture", HTTP_DELETE, [](AsyncWebServerRequest *r)
+              {
+                PacketCapture::clear();
+                r->send(200); });
+
+  // API: swim-machine protocol counters [machine ?m=]
+  g_server.on("/api/protocol", HTTP_GET, [](AsyncWebServerRequest *r)
+              {
+                size_t m;
+                if (!require_machine(r, m))
+                  return;
+                SwimMachine::ProtocolStats ps = SwimMachine::getProtocolStats(m);
+                DynamicJsonDocument d(2048); // heap: the async_tcp task stack is small
+                JsonObject rx = d.createNestedObject("rx");
+                rx["packets"] = ps.rxPackets;
+                rx["bad_length"] = ps.rxBadLength;
+                rx["bad_crc"] = ps.rxBadCrc;
+                rx["no_slot"] = ps.rxNoSlot;
+                rx["max_batch"] = ps.rxMaxBatch;
+                rx["budget_hits"] = ps.rxBudgetHits;
+                rx["truncated"] = ps.rxTruncated;
+                JsonObject tx = d.createNestedObject("tx");
+                tx["queued"] = ps.txQueued;
+                tx["high_water"] = ps.txHighWater;
+                tx["coalesced"] = ps.txCoalesced;
+                tx["overflows"] = ps.txOverflows;
+                tx["preempted"] = ps.txPreempted;
+                tx["window"] = ps.sendWindow;
+                tx["window_fallbacks"] = ps.windowFallbacks;
+                tx["in_flight_max"] = ps.inFlightMax;
+                tx["time_to_motor_ms"] = ps.timeToMotorLastMs;
+                JsonObject urgent = d.createNestedObject("stop_latency_us");
+                urgent["count"] = ps.urgentCount;
+                urgent["last"] = ps.urgentLastUs;
+                urgent["max"] = ps.urgentMaxUs;
+                JsonObject ack = d.createNestedObject("ack_latency_ms");
+                ack["count"] = ps.ackCount;
+                ack["last"] = ps.ackLastMs;
+                ack["max"] = ps.ackMaxMs;
+                JsonObject rtt = d.createNestedObject("rtt_ms");
+                rtt["srtt"] = ps.srttMs;
+                rtt["rttvar"] = ps.rttvarMs;
+                rtt["rto"] = ps.rtoMs;
+                rtt["retransmits"] = ps.retransmits;
+                JsonObject sched = d.createNestedObject("schedule");
+                sched["ramp_up_ms_per_unit"] = ps.rampUpMsPerUnit;
+                sched["ramp_down_ms_per_unit"] = ps.rampDownMsPerUnit;
+                sched["speed_pace_k"] = ps.speedPaceK;
+                sched["lead_last_ms"] = ps.leadLastMs;
+                sched["boundary_err_last_ms"] = ps.boundaryErrLastMs;
+                sched["boundary_err_max_abs_ms"] = ps.boundaryErrMaxAbsMs;
+                JsonObject stream = sched.createNestedObject("pace_stream");
+                stream["sent"] = ps.rampPaceSent;
+                stream["skipped"] = ps.rampPaceSkipped;
+                stream["interval_ms"] = ps.rampStreamIntervalMs;
+                JsonArray cmds = d.createNestedArray("commands");
+                for (const auto &c : ps.commands)
+                {
+                  JsonObject o = cmds.createNestedObject();
+                  o["opcode"] = c.opcode;
+                  o["sent"] = c.sent;
+                  o["acked"] = c.acked;
+                  o["retransmits"] = c.retransmits;
+                  o["last_ack_ms"] = c.lastAckMs;
+                }
+                JsonArray le = ack.createNestedArray("le");
+                JsonArray hist = ack.createNestedArray("hist");
+                for (size_t i = 0; i < SwimMachine::kAckHistBuckets; ++i)
+                {
+                  if (i < SwimMachine::kAckHistBuckets - 1)
+                    le.add(SwimMachine::kAckHistBoundsMs[i]);
+                  hist.add(ps.ackHist[i]);
+                }
+                String out; serializeJson(d, out);
+                send_json(r, out); });
 
 
+  // API: event stream counters and heap (flat while clients misbehave)
+  g_server.on("/api/sse", HTTP_GET, [](AsyncWebServerRequest *r)
+              {
+                DynamicJsonDocument d(512);
+                sse_stats_json(d.to<JsonObject>());
+                d["heap_free"] = ESP.getFreeHeap();
+                d["heap_max_alloc"] = ESP.getMaxAllocHeap();
+                String out; serializeJson(d, out);
+                send_json(r, out); });
+
   // Start server
   g_server.begin();
 }
@@ -372,9 +908,271 @@ bool connected()
   return ConnectionManager::ethHasIp() || ConnectionManager::wifiHasIp();
 }
 
-void push_event(const char *e, const char *j)
+/* ---------- WebSocket /ws: binary packet stream ------------------- */
+// Clients subscribe with {"sub":"packets"} (and {"unsub":"packets"}) and
+// then get every protocol packet as one binary frame, the raw 44-byte
+// command or 111-byte status packet. With no subscriber push_packet()
+// returns before touching anything.
+//
+// push_packet() runs on the protocol task, where a client pointer could be
+// freed under it by async_tcp. It only copies the packet into a small
+// ring; loop() sends the ring to each subscriber by client id, which the
+// library looks up under its own lock, so a client gone meanwhile is just
+// not found. Control-only clients get nothing. While the ring is full
+// packets are skipped for everyone; a subscriber whose own queue is full
+// misses them without holding up the others.
+static const size_t kMaxPacketSubs = 4;
+static uint32_t s_packetSubs[kMaxPacketSubs]; // WebSocket client ids, 0 = free
+static volatile uint8_t s_packetSubCount = 0;
+static portMUX_TYPE s_subsMux = portMUX_INITIALIZER_UNLOCKED;
+
+static const size_t kPacketRing = 16;
+static const size_t kPacketMax = 111;
+static struct
+{
+  uint8_t len;
+  uint8_t data[kPacketMax];
+} s_packetRing[kPacketRing];
+static size_t s_ringHead = 0, s_ringCount = 0; // guarded by s_subsMux
+
+static bool subscribe_packets(uint32_t id, bool on)
+{
+  bool ok = !on;
+  portENTER_CRITICAL(&s_subsMux);
+  for (auto &sub : s_packetSubs)
+    if (sub == id)
+    {
+      if (!on)
+      {
+        sub = 0;
+        s_packetSubCount--;
+      }
+      ok = true;
+      on = false; // already subscribed
+    }
+  for (auto &sub : s_packetSubs)
+    if (on && !sub)
+    {
+      sub = id;
+      s_packetSubCount++;
+      ok = true;
+      break;
+    }
+  portEXIT_CRITICAL(&s_subsMux);
+  return ok;
+}
+
+void push_packet(const uint8_t *data, size_t len)
+{
+  if (!s_packetSubCount || len > kPacketMax)
+    return;
+  portENTER_CRITICAL(&s_subsMux);
+  if (s_ringCount < kPacketRing)
+  {
+    auto &f = s_packetRing[(s_ringHead + s_ringCount++) % kPacketRing];
+    f.len = (uint8_t)len;
+    memcpy(f.data, data, len);
+  }
+  portEXIT_CRITICAL(&s_subsMux);
+}
+
+// loop(): hand the queued packets to the socket clients
+static void send_packets()
 {
-  g_sse.send(j, e);
+  uint8_t buf[kPacketMax];
+  uint32_t subs[kMaxPacketSubs];
+  for (;;)
+  {
+    size_t len = 0;
+    portENTER_CRITICAL(&s_subsMux);
+    memcpy(subs, s_packetSubs, sizeof subs);
+    if (s_ringCount)
+    {
+      len = s_packetRing[s_ringHead].len;
+      memcpy(buf, s_packetRing[s_ringHead].data, len);
+      s_ringHead = (s_ringHead + 1) % kPacketRing;
+      s_ringCount--;
+    }
+    portEXIT_CRITICAL(&s_subsMux);
+    if (!len)
+      return;
+    for (uint32_t id : subs)
+      if (id && g_ws.availableForWrite(id))
+        g_ws.binary(id, buf, len);
+  }
+}
+
+/* ---------- WebSocket /ws: control ------------------------------- */
+// {"id": <request id>, "op": "...", "m": 0, ...} is answered on the same
+// socket with {"id": ..., "ok": true} or {"id": ..., "ok": false, "error":
+// "..."}. Ops are repeat-safe: pause/resume set the state instead of
+// toggling it, run/go on a running lane do not restart it, and adjust
+// takes an absolute offset. A request id seen recently (a client resending
+// after a reconnect) gets its first answer again with "dup": true and is
+// not executed twice. A client whose request timed out on the socket can
+// send it over REST instead (/api/run, /api/arm, /api/go) with the same
+// id as ?rid=: that is looked up with the socket's ids.
+static const size_t kRecentRequests = 16;
+static const size_t kRequestIdLen = 24;
+static RecentRequests<kRecentRequests, kRequestIdLen> s_recent;
+
+// Runs one control op; returns nullptr on success or the error text
+static const char *ws_control(JsonVariantConst d)
+{
+  const char *op = d["op"] | "";
+  long mv = d["m"] | 0L;
+  if (mv < 0 || mv >= (long)SwimMachine::kMaxMachines)
+    return "bad m";
+  size_t m = (size_t)mv;
+  String workout = d["workout"] | "";
+
+  if (!strcmp(op, "ping"))
+    return nullptr;
+  if (!strcmp(op, "run") || !strcmp(op, "arm"))
+  {
+    if (!workout.length())
+      return "missing workout";
+    if (SwimMachine::getStatus(m).active)
+      return WorkoutManager::workout_id(m) == workout ? nullptr : "another workout is running";
+    if (op[0] == 'r')
+      return WorkoutManager::run(workout, m) ? nullptr : "could not start workout";
+    if (WorkoutManager::arm(workout, m))
+      return nullptr;
+    return SwimMachine::motorRunning(m) ? "machine is running" : "could not arm workout";
+  }
+  if (!strcmp(op, "go"))
+  {
+    if (SwimMachine::getStatus(m).active)
+      return nullptr;
+    return WorkoutManager::go(m) ? nullptr : "not armed";
+  }
+  if (!strcmp(op, "pause") || !strcmp(op, "resume"))
+  {
+    WorkoutManager::set_paused(op[0] == 'p', m);
+    return nullptr;
+  }
+  if (!strcmp(op, "stop"))
+  {
+    WorkoutManager::stop(m);
+    return nullptr;
+  }
+  if (!strcmp(op, "adjust"))
+  {
+    long off = d["pace_offset"] | 0L;
+    if (off < -(long)WorkoutStorage::kMaxPace100s || off > (long)WorkoutStorage::kMaxPace100s)
+      return "bad pace_offset";
+    WorkoutManager::adjust((int16_t)off, m);
+    return nullptr;
+  }
+  return "unknown op";
+}
+
+// The s_recent key of a request id: its JSON text, so 1 and "1" differ
+static bool request_key(JsonVariantConst id, char (&key)[kRequestIdLen])
+{
+  return !id.isNull() && serializeJson(id, key, sizeof key) < sizeof key - 1;
+}
+
+// ws_control() at most once per request id; dup is set when the id was
+// answered before, and its first answer is returned
+static const char *control_once(JsonVariantConst d, const char *key, bool &dup)
+{
+  const char *error;
+  dup = s_recent.seen(key, error);
+  if (dup)
+    return error;
+  error = ws_control(d);
+  s_recent.remember(key, error);
+  return error;
+}
+
+// A REST control call carrying ?rid=, see above
+static void rest_control(AsyncWebServerRequest *r, const char *op, size_t m, const String &workout)
+{
+  StaticJsonDocument<256> d;
+  d["id"] = r->getParam("rid")->value();
+  d["op"] = op;
+  d["m"] = m;
+  if (workout.length())
+    d["workout"] = workout;
+  char key[kRequestIdLen];
+  if (!request_key(d["id"], key))
+  {
+    r->send(400, "text/plain", "long rid");
+    return;
+  }
+  bool dup;
+  const char *error = control_once(d.as<JsonVariantConst>(), key, dup);
+  if (error)
+    r->send(409, "text/plain", error);
+  else
+    r->send(200, "text/plain", "OK");
+}
+
+static void ws_reply(AsyncWebSocketClient *c, JsonVariantConst id, const char *error, bool dup)
+{
+  StaticJsonDocument<192> r;
+  r["id"] = id;
+  r["ok"] = error == nullptr;
+  if (error)
+    r["error"] = error;
+  if (dup)
+    r["dup"] = true;
+  char out[192];
+  size_t n = serializeJson(r, out, sizeof out);
+  c->text(out, n);
+}
+
+static void ws_message(AsyncWebSocketClient *c, const uint8_t *data, size_t len)
+{
+  StaticJsonDocument<256> d;
+  if (deserializeJson(d, data, len))
+  {
+    c->text("{\"error\":\"bad json\"}");
+    return;
+  }
+  if (!d["op"].isNull())
+  {
+    JsonVariantConst id = d["id"];
+    char key[kRequestIdLen];
+    if (!request_key(id, key))
+    {
+      ws_reply(c, id, "missing or long id", false);
+      return;
+    }
+    bool dup;
+    const char *error = control_once(d.as<JsonVariantConst>(), key, dup);
+    ws_reply(c, id, error, dup);
+    return;
+  }
+  bool on = !d["sub"].isNull();
+  const char *topic = on ? (d["sub"] | "") : (d["unsub"] | "");
+  if (strcmp(topic, "packets") != 0)
+  {
+    c->text("{\"error\":\"unknown topic\"}");
+    return;
+  }
+  if (!subscribe_packets(c->id(), on))
+  {
+    c->text("{\"error\":\"too many subscribers\"}");
+    return;
+  }
+  c->text(on ? "{\"sub\":\"packets\"}" : "{\"unsub\":\"packets\"}");
+}
+
+static void ws_event(AsyncWebSocket *, AsyncWebSocketClient *c, AwsEventType type, void *arg, uint8_t *data, size_t len)
+{
+  if (type == WS_EVT_DISCONNECT)
+  {
+    subscribe_packets(c->id(), false);
+    return;
+  }
+  if (type != WS_EVT_DATA)
+    return;
+  AwsFrameInfo *info = (AwsFrameInfo *)arg;
+  // commands are small: one unfragmented text frame
+  if (info->final && info->index == 0 && info->len == len && info->opcode == WS_TEXT)
+    ws_message(c, data, len);
 }
 
 
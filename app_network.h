@@ -2,7 +2,8 @@
 
 
 /* Simple network facade built on ConnectionManager/NetworkSetup.
-   Owns AsyncWebServer and AsyncEventSource (SSE) and defines all routes. */
+   Owns AsyncWebServer, AsyncEventSource (SSE, /events) and AsyncWebSocket
+   (/ws) and defines all routes. */
 namespace AppNetwork {
 
   // Initialize networking (Ethernet/WiFi/SoftAP via ConnectionManager) and basic captive portal.
@@ -11,10 +12,17 @@ namespace AppNetwork {
   // Returns true if network is connected (Ethernet or WiFi STA).
   bool connected();
 
-  // Push an SSE event with given name and JSON payload.
+  // Push an SSE event with given name and JSON payload. Events are state
+  // snapshots: a client with a full queue gets only the newest of each name.
   void push_event(const char* , const char* );
 
-  // For compatibility; no-op for Async server.
+  // Push one protocol packet to the WebSocket clients subscribed to
+  // "packets" (binary frame, sent from loop()); free when there are none.
+  // Safe from any task.
+  void push_packet(const uint8_t* data, size_t len);
+
+  // Call in loop(); catches up or disconnects slow SSE clients, sends
+  // queued packets and drops closed WebSocket clients.
   void loop();
 
 } // namespace AppNetwork
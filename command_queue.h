@@ -0,0 +1,108 @@
+#pragma once
+#include <Arduino.h>
+
+// Fixed-capacity FIFO of swim-machine commands (opcode + 16-bit parameter).
+// The leading entries are the ones on the wire awaiting their ack (one with
+// stop-and-wait, up to the send window with pipelining) and stay put until
+// pop(); everything behind them is still pending and may be rewritten.
+class CommandQueue {
+public:
+  static constexpr uint8_t kCapacity = 16;
+
+  struct Command {
+    uint8_t  opcode;
+    uint16_t param;
+  };
+
+  struct Stats {
+    uint32_t pushed;     // commands accepted into a new slot
+    uint32_t coalesced;  // commands merged into a pending entry
+    uint32_t overflows;  // commands rejected because the queue was full
+    uint32_t dropped;    // commands discarded by dropPending()/preempt()
+    uint32_t preempted;  // preempt() calls
+    uint8_t  highWater;  // deepest the queue has been
+  };
+
+  bool   empty() const { return m_count == 0; }
+  bool   full()  const { return m_count == kCapacity; }
+  size_t size()  const { return m_count; }
+  const Stats& stats() const { return m_stats; }
+
+  // Oldest entry; only valid when !empty()
+  const Command& front() const { return m_buf[m_head]; }
+
+  // i-th oldest entry; only valid when i < size()
+  const Command& at(size_t i) const { return m_buf[(m_head + i) % kCapacity]; }
+
+  void pop() {
+    if (!m_count) return;
+    m_head = (m_head + 1) % kCapacity;
+    m_count--;
+  }
+
+  // Append a command. With coalesce set, a pending entry with the same opcode
+  // takes the new parameter instead (latest value wins) and no slot is used.
+  // The first `locked` entries (already on the wire) are never rewritten.
+  // Returns false if the queue is full.
+  bool push(uint8_t opcode, uint16_t param, bool coalesce, uint8_t locked) {
+    if (coalesce) {
+      for (uint8_t i = m_count; i-- > locked;) {
+        Command& c = m_buf[(m_head + i) % kCapacity];
+        if (c.opcode == opcode) {
+          c.param = param;
+          m_stats.coalesced++;
+          return true;
+        }
+      }
+    }
+    if (full()) {
+      m_stats.overflows++;
+      return false;
+    }
+    m_buf[(m_head + m_count) % kCapacity] = Command{opcode, param};
+    m_count++;
+    m_stats.pushed++;
+    if (m_count > m_stats.highWater) m_stats.highWater = m_count;
+    return true;
+  }
+
+  // Opcodes a caller wants to keep when discarding (nullptr: keep none)
+  using Keep = bool (*)(uint8_t opcode);
+
+  // Discard every entry behind the first `locked` ones, except those `keep`
+  // accepts (they stay in order).
+  void dropPending(uint8_t locked, Keep keep = nullptr) {
+    uint8_t n = locked < m_count ? locked : m_count;
+    for (uint8_t i = n; i < m_count; ++i) {
+      const Command c = at(i);
+      if (keep && keep(c.opcode)) m_buf[(m_head + n++) % kCapacity] = c;
+    }
+    m_stats.dropped += m_count - n;
+    m_count = n;
+  }
+
+  // Put one command in front of everything, including a front entry already
+  // on the wire (a stop must not wait behind pace updates or for the ack of
+  // the command in flight). The rest is discarded, except entries `keep`
+  // accepts: they follow the new command in their order, to be sent anew.
+  void preempt(uint8_t opcode, uint16_t param, Keep keep = nullptr) {
+    Command kept[kCapacity - 1];
+    uint8_t n = 0;
+    for (uint8_t i = 0; i < m_count; ++i)
+      if (keep && n < kCapacity - 1 && keep(at(i).opcode)) kept[n++] = at(i);
+    m_stats.dropped += m_count - n;
+    m_stats.preempted++;
+    m_stats.pushed++;
+    m_head = 0;
+    m_count = n + 1;
+    m_buf[0] = Command{opcode, param};
+    for (uint8_t i = 0; i < n; ++i) m_buf[i + 1] = kept[i];
+    if (m_count > m_stats.highWater) m_stats.highWater = m_count;
+  }
+
+private:
+  Command m_buf[kCapacity];
+  uint8_t m_head = 0;
+  uint8_t m_count = 0;
+  Stats   m_stats = {};
+};
@@ -0,0 +1,67 @@
+#include "crc32.h"
+#include <string.h>
+
+namespace
+{
+  // Four 256-entry tables: t[0] is the classic byte table, t[k][i] advances
+  // t[k-1][i] by one more zero byte, so four input bytes fold in one step.
+  struct Tables
+  {
+    uint32_t t[4][256];
+  };
+
+  constexpr Tables makeTables()
+  {
+    Tables tb{};
+    for (uint32_t i = 0; i < 256; ++i)
+    {
+      uint32_t c = i;
+      for (int k = 0; k < 8; ++k)
+        c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : (c >> 1);
+      tb.t[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; ++i)
+      for (int s = 1; s < 4; ++s)
+        tb.t[s][i] = (tb.t[s - 1][i] >> 8) ^ tb.t[0][tb.t[s - 1][i] & 0xFF];
+    return tb;
+  }
+
+  // const + constexpr: placed in .rodata (flash), no RAM and no start-up cost
+  constexpr Tables kTables = makeTables();
+}
+
+uint32_t Crc32::compute(const uint8_t *d, size_t n)
+{
+  const auto &t = kTables.t;
+  uint32_t c = 0xFFFFFFFF;
+
+  // head: bytewise until 4-byte aligned, so the word loads below are cheap
+  while (n && ((uintptr_t)d & 3))
+  {
+    c = (c >> 8) ^ t[0][(c ^ *d++) & 0xFF];
+    --n;
+  }
+  // body: one 32-bit word per step (ESP32 is little-endian)
+  while (n >= 4)
+  {
+    uint32_t w;
+    memcpy(&w, d, 4);
+    c ^= w;
+    c = t[3][c & 0xFF] ^ t[2][(c >> 8) & 0xFF] ^ t[1][(c >> 16) & 0xFF] ^ t[0][c >> 24];
+    d += 4;
+    n -= 4;
+  }
+  // tail
+  while (n--)
+    c = (c >> 8) ^ t[0][(c ^ *d++) & 0xFF];
+  return ~c;
+}
+
+bool Crc32::checkTrailer(const uint8_t *d, size_t len)
+{
+  if (len < 4)
+    return false;
+  uint32_t want;
+  memcpy(&want, d + len - 4, 4);
+  return compute(d, len - 4) == want;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <Arduino.h>
+
+/* CRC-32 (IEEE 802.3, reflected 0xEDB88320) used to frame swim-machine packets.
+   Table driven (slice-by-4); the tables are built at compile time and live in flash. */
+namespace Crc32
+{
+  /** CRC-32 of n bytes starting at d. */
+  uint32_t compute(const uint8_t *d, size_t n);
+
+  /** True if the last 4 bytes of d hold the CRC-32 (little-endian) of the bytes before them. */
+  bool checkTrailer(const uint8_t *d, size_t len);
+}
@@ -1,12 +1,17 @@
-// — on page load, subscribe to any status event. If a run is active, go to runner:
+// Machine (lane) this page controls: ?m=N, default 0. Its progress event is
+// "progress" for machine 0 and "progress<N>" for the others.
+const machineIdx = Number(new URLSearchParams(location.search).get('m')) || 0;
+const machineQuery = machineIdx ? `&m=${machineIdx}` : '';
+
+// — on page load, subscribe to the progress event. If a run is active, go to runner:
 window.addEventListener('DOMContentLoaded', () => {
   const es = new EventSource('/events');
-  es.addEventListener('status', e => {
+  es.addEventListener(machineIdx ? `progress${machineIdx}` : 'progress', e => {
     const st = JSON.parse(e.data);
     // if a run is active, and we're still on the editor page, redirect:
     if (st.running && !location.pathname.endsWith('run.html')) {
       sessionStorage.setItem('currentWorkouts', JSON.stringify(DB.workouts));
-      window.location.href = `/run.html?id=${current?.id || ''}`;
+      window.location.href = `/run.html?id=${current?.id || ''}${machineQuery}`;
     }
   });
 });
@@ -21,7 +26,19 @@ const mmssToSecs = txt => {
   const [m, s] = txt.split(':').map(Number);
   return (m || 0) * 60 + (s || 0);
 };
-const calcDistance = s => s.speed ? Math.round(s.dur * 100 / s.speed) : 0;
+// a ramp (speed → speed_end) covers dur * 100 * ln(end/start) / (end - start)
+const calcDistance = s => !s.speed ? 0
+  : s.speed_end && s.speed_end !== s.speed
+    ? Math.round(s.dur * 100 * Math.log(s.speed_end / s.speed) / (s.speed_end - s.speed))
+    : Math.round(s.dur * 100 / s.speed);
+// Repeat blocks ({repeat, pace_step, swims}) played out as plain steps
+const expandSwims = (swims, out = [], shift = 0) => {
+  for (const s of swims || []) {
+    if (s.repeat) for (let r = 0; r < s.repeat; r++) expandSwims(s.swims, out, shift + r * (s.pace_step || 0));
+    else out.push(s.speed ? { ...s, speed: s.speed + shift, ...(s.speed_end && { speed_end: s.speed_end + shift }) } : s);
+  }
+  return out;
+};
 
 const editorPane = $('editorPane');
 const pauseBtn = $('pauseBtn');
@@ -69,7 +86,7 @@ function updateButtons() {
 }
 
 async function togglePause() {
-  const res = await fetch('/api/pause', { method: 'POST' });
+  const res = await fetch(`/api/pause${machineIdx ? `?m=${machineIdx}` : ''}`, { method: 'POST' });
   const json = await res.json();             // {paused: true|false}
   const paused = json.paused;
 
@@ -133,7 +150,40 @@ const loadWorkout = async id => {
   if (editBtn) {
     editBtn.style.display = (!editMode && current) ? '' : 'none';
   }
+  armWorkout();
 };
+
+/* -------- arm: stage duration & first pace ahead of Start -------- */
+let armedId = null;
+
+async function armWorkout() {
+  armedId = null;
+  if (!current || dirty) return;
+  const id = current.id;
+  try {
+    const r = await control('arm', { workout: id }, `/api/arm?id=${encodeURIComponent(id)}${machineQuery}`);
+    if (r.ok && current?.id === id) armedId = id;
+    // not staged while the pool runs (e.g. started at the pool side)
+    if (r.error === 'machine is running' && current?.id === id)
+      $('srvStatus').textContent = 'Pool is running – not pre-staged; Start takes over';
+  } catch { /* Start falls back to run */ }
+}
+
+// An op over the control socket (control.js) while it is up, else the
+// REST call; resolves to {ok, error}. After a timeout on the socket the
+// REST call carries the same request id (rid), so the controller answers
+// it from the first try instead of running the op twice.
+async function control(op, args, url) {
+  let rid = null;
+  if (Control.ready()) {
+    const r = await Control.send(op, { m: machineIdx, ...args });
+    if (r.error !== 'timeout') return r;
+    rid = r.id;
+  }
+  if (rid) url += `${url.includes('?') ? '&' : '?'}rid=${encodeURIComponent(rid)}`;
+  const res = await fetch(url, { method: 'POST' });
+  return { ok: res.ok, error: res.ok ? undefined : (await res.text().catch(() => '')) || res.statusText };
+}
 const fillForm = () => {
   titleIn.value = current?.title || '';
   $('paneTitle').textContent = current
@@ -146,7 +196,7 @@ let editedSwimIndex = null;
 window.editSwim = function(index) {
   if (!current) return;
   const swim = current.swims[index];
-  if (!swim) return;
+  if (!swim || swim.repeat) return;
   editedSwimIndex = index;
   editMode = true;
   redrawSwims();
@@ -183,9 +233,24 @@ const redrawSwims = () => {
       const td = tr.insertCell();
       td.colSpan = 6; // span all columns
       td.appendChild(addSwimComponent);
+    } else if (s.repeat) {
+      // repeat block: shown as a summary, edited in the workout file
+      const steps = expandSwims([s]);
+      tr.insertCell().textContent = i + 1;
+      tr.insertCell().textContent = `${s.repeat}×` + (s.pace_step ? ` (${s.pace_step > 0 ? '+' : ''}${s.pace_step}s)` : '');
+      tr.insertCell().textContent = secsToMMSS(steps.reduce((t, x) => t + x.dur, 0));
+      tr.insertCell().textContent = `${steps.reduce((t, x) => t + calcDistance(x), 0)}m`;
+      tr.insertCell().textContent = `${s.note || 'repeat'}: ${s.swims.length} step(s)`;
+      const act = tr.insertCell();
+      act.innerHTML = editMode
+        ? `<button class="swim-btn" onclick="moveSwim(${i},-1)">↑</button>
+           <button class="swim-btn" onclick="moveSwim(${i},1)">↓</button>
+           <button class="swim-btn" onclick="delSwim(${i})">✖</button>`
+        : '';
     } else {
       tr.insertCell().textContent = i + 1;
-      tr.insertCell().textContent = s.speed ? secsToMMSS(s.speed) : 'rest';
+      tr.insertCell().textContent = !s.speed ? 'rest'
+        : secsToMMSS(s.speed) + (s.speed_end ? `→${secsToMMSS(s.speed_end)}` : '');
       tr.insertCell().textContent = secsToMMSS(s.dur);
       tr.insertCell().textContent = `${calcDistance(s)}m`;
       tr.insertCell().textContent = s.note || '';
@@ -293,6 +358,7 @@ const saveWorkout = async () => {
   fillForm();
   redrawSwims();
   updateButtons();
+  armWorkout();
 };
 
 const deleteWorkout = async () => {
@@ -328,13 +394,15 @@ let statusTimer = null;
 async function startServerSide() {
   if (!current) return;
 
-  // build URL with workout ID in the query parameter
-  const url = `/api/run?id=${encodeURIComponent(current.id)}`;
+  // armed: only the start command is left to send; otherwise load & run
+  const url = `/api/run?id=${encodeURIComponent(current.id)}${machineQuery}`;
+  const goUrl = `/api/go?${machineQuery.slice(1)}`;
 
-  // fire the POST with no body and check response
   try {
-    const res = await fetch(url, { method: 'POST' });
-    if (res.ok) {
+    let r = armedId === current.id && !dirty ? await control('go', {}, goUrl) : null;
+    armedId = null;
+    if (!r?.ok) r = await control('run', { workout: current.id }, url);
+    if (r.ok) {
       // disable the “Start” button, enable “Pause”
       document.getElementById('startSrv').disabled = true;
       pauseBtn.hidden = false;
@@ -343,15 +411,9 @@ async function startServerSide() {
 
       // store workouts and redirect into the runner page
       sessionStorage.setItem('currentWorkouts', JSON.stringify(DB.workouts));
-      window.location.href = `/run.html?id=${encodeURIComponent(current.id)}`;
+      window.location.href = `/run.html?id=${encodeURIComponent(current.id)}${machineQuery}`;
     } else {
-      let errorMsg = '';
-      try {
-        errorMsg = (await res.text()) || res.statusText;
-      } catch (e) {
-        errorMsg = res.statusText;
-      }
-      alert('Failed to start: ' + errorMsg);
+      alert('Failed to start: ' + r.error);
     }
   } catch (err) {
     alert('Failed to start: ' + err);
@@ -364,7 +426,7 @@ async function pollStatus() {
 
   pauseBtn.textContent = st.paused ? '▶ Resume' : '⏸ Pause';
 
-  const swim = current.swims[st.idx] || {};
+  const swim = expandSwims(current.swims)[st.idx] || {};
   $('srvStatus').textContent =
     `${st.paused ? 'Paused – ' : ''}`
     + `Swim #${st.idx + 1} (${swim.note || (swim.speed ? 'swim' : 'rest')}) `
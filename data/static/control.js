@@ -0,0 +1,45 @@
+/* Control channel: run/arm/go/pause/resume/stop/adjust over one WebSocket
+   (/ws) instead of an HTTP request per tap. Each request carries an id and
+   is answered on the socket; requests still unanswered when the socket
+   drops are sent again with the same id after it reconnects, and the
+   controller answers a repeated id without running it twice.
+
+   Control.ready()           true while the socket is open
+   Control.send(op, args)    -> Promise of {id, ok, error?, dup?}
+                             ({ok: false, error: 'timeout'} after 3 s) */
+const Control = (() => {
+  const session = Math.random().toString(36).slice(2, 8);
+  const pending = new Map(); // id -> { msg, done }
+  let ws = null, open = false, seq = 0;
+
+  function connect() {
+    ws = new WebSocket(`ws://${location.host}/ws`);
+    ws.onopen = () => {
+      open = true;
+      for (const p of pending.values()) ws.send(JSON.stringify(p.msg));
+    };
+    ws.onmessage = (e) => {
+      if (typeof e.data !== 'string') return;
+      const reply = JSON.parse(e.data);
+      pending.get(reply.id)?.done(reply);
+    };
+    ws.onclose = () => {
+      open = false;
+      setTimeout(connect, 1000);
+    };
+  }
+
+  function send(op, args = {}, timeoutMs = 3000) {
+    const id = `${session}-${++seq}`;
+    const msg = { id, op, ...args };
+    return new Promise((resolve) => {
+      const timer = setTimeout(() => done({ id, ok: false, error: 'timeout' }), timeoutMs);
+      const done = (reply) => { clearTimeout(timer); pending.delete(id); resolve(reply); };
+      pending.set(id, { msg, done });
+      if (open) ws.send(JSON.stringify(msg));
+    });
+  }
+
+  connect();
+  return { ready: () => open, send };
+})();
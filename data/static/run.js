@@ -5,54 +5,97 @@ const returnBtn = $("returnBtn");
 // Parse ?id=workoutId from URL
 const params = new URLSearchParams(location.search);
 const workoutId = params.get("id");
+// Machine (lane): ?m=N; its events are "plan"/"progress" (0) or "plan<N>"/"progress<N>"
+const machineIdx = Number(params.get("m")) || 0;
+const machineQuery = machineIdx ? `?m=${machineIdx}` : "";
 
 const es = new EventSource("/events");
+const lane = machineIdx ? String(machineIdx) : "";
 
-es.addEventListener("status", (e) => {
-  const st = JSON.parse(e.data);
+// Repeat blocks ({repeat, pace_step, swims}) played out as plain steps,
+// in the order the controller plays them
+const expandSwims = (swims, out = [], shift = 0) => {
+  for (const s of swims || []) {
+    if (s.repeat) for (let r = 0; r < s.repeat; r++) expandSwims(s.swims, out, shift + r * (s.pace_step || 0));
+    else out.push(s.speed ? { ...s, speed: s.speed + shift, ...(s.speed_end && { speed_end: s.speed_end + shift }) } : s);
+  }
+  return out;
+};
+
+// "plan" arrives once (on connect and when a workout is loaded), "progress"
+// only when something changes; the clock is run forward here in between
+let plan = { title: "", steps: [] };
+let st = null, stAt = 0;
+
+es.addEventListener(`plan${lane}`, (e) => {
+  const w = JSON.parse(e.data);
+  plan = { title: w.title || "", steps: expandSwims(w.swims) };
+  render();
+});
+
+es.addEventListener(`progress${lane}`, (e) => {
+  st = JSON.parse(e.data);
+  stAt = performance.now();
+  render();
+});
+
+setInterval(() => { if (st && st.running && !st.paused) render(); }, 250);
 
+const fmtMMSS = (p) => `${Math.floor(p / 60)}:${(p % 60).toString().padStart(2, "0")}`;
+
+function render() {
+  if (!st) return;
   pauseBtn.textContent = st.paused ? "▶ Resume" : "⏸ Pause";
   pauseBtn.setAttribute("aria-pressed", st.paused ? "true" : "false");
 
-  document.title = st.workout_title || "Workout Runner";
+  document.title = plan.title || "Workout Runner";
 
+  const current = st.running ? plan.steps[st.step] : null;
+  const elapsedMs = st.elapsed_ms + (st.running && !st.paused ? performance.now() - stAt : 0);
   let timeLeftMSecs = 0;
-  if (st.remaining_swims && st.remaining_swims.length > 0) {
-    const currentSwim = st.remaining_swims[0];
-    timeLeftMSecs = Math.max(0, currentSwim.durSec*1000 - Math.floor(st.elapsed_ms));
+  if (current) {
+    timeLeftMSecs = Math.max(0, current.dur * 1000 - Math.floor(elapsedMs));
   }
   let timeLeftSecs = Math.ceil(timeLeftMSecs / 1000);
   const mins = Math.floor(timeLeftSecs / 60).toString().padStart(2, '0');
   const secs = (timeLeftSecs % 60).toString().padStart(2, '0');
   $("runTime").textContent = `${mins}:${secs}`;
 
-  if (st.remaining_swims && st.remaining_swims.length > 0) {
-    const pace = st.remaining_swims[0].pace100s || 0;
-    
+  if (current) {
+    // the commanded pace follows a ramp step; fall back to the step's pace
+    const pace = current.speed ? st.pace100s || current.speed : 0;
+
     if (pace === 0) {
       $("runPace").style.display = "none";
       $("runDist").style.display = "none";
-      $("runNote").textContent = st.current_step_note || "Rest";
+      $("runNote").textContent = current.note || "Rest";
     } else {
       $("runPace").style.display = "";
       $("runDist").style.display = "";
-      const paceMin = Math.floor(pace / 60);
-      const paceSec = pace % 60;
-      $("runPace").textContent = `Pace: ${paceMin}:${paceSec.toString().padStart(2, "0")} /100m`;
-      
-      $("runNote").textContent = st.current_step_note || "Swim";
+      $("runPace").textContent = `Pace: ${fmtMMSS(pace)} /100m`;
+
+      $("runNote").textContent = current.note || "Swim";
       const distLeft = Math.round((timeLeftMSecs / 10) / pace);
       $("runDist").textContent = distLeft + " m";
-      // Show pace as mm:ss/100m
     }
   } else {
     $("runDist").textContent = "";
     $("runPace").textContent = "";
   }
 
+  // What the machine reports (pace and current -> target speed)
+  const m = st.machine;
+  if (m && (m.cur_speed || m.tgt_speed)) {
+    $("runMachine").textContent =
+      `Machine: ${fmtMMSS(m.pace100s || 0)} /100m · speed ${m.cur_speed}→${m.tgt_speed}`;
+  } else {
+    $("runMachine").textContent = "";
+  }
+
   updateTimeBigMode();
 
-  if (st.remaining_swims && st.remaining_swims.length > 1) {
+  const upcoming = current ? plan.steps.slice(st.step + 1, st.step + 1 + 20) : [];
+  if (upcoming.length) {
     let tableHtml = `<table id="queueTable" aria-label="Upcoming swim steps">
       <thead>
         <tr>
@@ -62,15 +105,11 @@ es.addEventListener("status", (e) => {
           <th>Note</th>
         </tr>
       </thead><tbody>`;
-    st.remaining_swims.slice(1).forEach((s) => {
-      const isRest = s.pace100s === 0;
-      const distance = isRest ? "Rest" : `${Math.round(s.durSec * 100 / s.pace100s)}m`;
-      const paceMin = Math.floor((s.pace100s || 0) / 60);
-      const paceSec = (s.pace100s || 0) % 60;
-      const pace = isRest ? "—" : `${paceMin}:${paceSec.toString().padStart(2, "0")}`;
-      const totalMin = Math.floor(s.durSec / 60);
-      const totalSec = s.durSec % 60;
-      const totalTime = `${totalMin}:${totalSec.toString().padStart(2, "0")}`;
+    upcoming.forEach((s) => {
+      const isRest = !s.speed;
+      const distance = isRest ? "Rest" : `${Math.round(s.dur * 100 / s.speed)}m`;
+      const pace = isRest ? "—" : fmtMMSS(s.speed) + (s.speed_end ? `→${fmtMMSS(s.speed_end)}` : "");
+      const totalTime = fmtMMSS(s.dur);
       const note = s.note || "";
 
       tableHtml += `<tr>
@@ -80,6 +119,8 @@ es.addEventListener("status", (e) => {
         <td>${note}</td>
       </tr>`;
     });
+    const more = plan.steps.length - (st.step + 1 + upcoming.length);
+    if (more > 0) tableHtml += `<tr><td colspan="4"><em>+${more} more</em></td></tr>`;
 
     tableHtml += "</tbody></table>";
     $("queueList").innerHTML = tableHtml;
@@ -98,20 +139,24 @@ es.addEventListener("status", (e) => {
   if (st.paused) {
     returnBtn.style.display = "block";
   }
-});
+}
 
 pauseBtn.onclick = async () => {
-  await fetch("/api/pause", { method: "POST" });
+  // over the control socket: pause/resume what is on screen, so a double
+  // tap does not undo itself
+  if (Control.ready()) await Control.send(st?.paused ? "resume" : "pause", { m: machineIdx });
+  else await fetch(`/api/pause${machineQuery}`, { method: "POST" });
   // SSE updates status, so no UI update needed here
 };
 
 returnBtn.onclick = async () => {
   try {
-    await fetch('/api/stop', { method: 'POST' });
+    if (Control.ready()) await Control.send("stop", { m: machineIdx });
+    else await fetch(`/api/stop${machineQuery}`, { method: 'POST' });
   } catch (e) {
     console.error('Failed to stop workout:', e);
   }
-  window.location.href = '/';
+  window.location.href = machineIdx ? `/?m=${machineIdx}` : '/';
 };
 function updateTimeBigMode() {
   const isMobileLandscape = window.innerWidth > window.innerHeight;
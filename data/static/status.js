@@ -198,14 +198,7 @@ function parseCommands(csv) {
 
 const commandMap = parseCommands(commandsCsv);
 
-// Helper functions to parse hex string to byte array and parse messages
-function hexToBytes(hex) {
-  const bytes = new Uint8Array(hex.length / 2);
-  for (let i = 0; i < bytes.length; i++) {
-    bytes[i] = parseInt(hex.substr(i * 2, 2), 16);
-  }
-  return bytes;
-}
+// Helper functions to parse messages
 
 function leUint16(buf, off) {
   return buf[off] | (buf[off + 1] << 8);
@@ -253,33 +246,41 @@ function parse111(buf) {
   };
 }
 
-// Connect to /network SSE endpoint
-const networkSse = new EventSource('/events');
+// Packets arrive on the WebSocket as raw binary frames (44-byte commands,
+// 111-byte status packets) once subscribed to the "packets" topic
+function connectPackets() {
+  const ws = new WebSocket(`ws://${location.host}/ws`);
+  ws.binaryType = 'arraybuffer';
+
+  ws.onopen = function() {
+    console.log('WebSocket connection opened');
+    ws.send(JSON.stringify({ sub: 'packets' }));
+  };
 
-networkSse.onopen = function() {
-  console.log('SSE connection opened');
-};
+  ws.onclose = function() {
+    setTimeout(connectPackets, 2000); // reconnect
+  };
 
-networkSse.onerror = function(e) {
-  console.error('SSE error:', e);
-};
+  ws.onerror = function(e) {
+    console.error('WebSocket error:', e);
+  };
 
-networkSse.addEventListener('network', function(event) {
-  try {
-    const data = JSON.parse(event.data);
-    if (data.packet) {
-      const buf = hexToBytes(data.packet);
-      let msg = null;
-      if (buf.length === 44) {
-        msg = parse44(buf);
-      } else if (buf.length === 111) {
-        msg = parse111(buf);
-      }
-      if (msg) {
-        add(msg);
-      }
+  ws.onmessage = function(event) {
+    if (typeof event.data === 'string') {
+      const reply = JSON.parse(event.data);
+      if (reply.error) console.error('WebSocket:', reply.error);
+      return;
     }
-  } catch (e) {
-    console.error('Failed to parse network SSE data:', e);
-  }
-});
+    const buf = new Uint8Array(event.data);
+    let msg = null;
+    if (buf.length === 44) {
+      msg = parse44(buf);
+    } else if (buf.length === 111) {
+      msg = parse111(buf);
+    }
+    if (msg) {
+      add(msg);
+    }
+  };
+}
+connectPackets();
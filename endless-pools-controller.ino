@@ -94,7 +94,7 @@ void loop()
 #ifdef WORKOUTMANAGER
   WorkoutManager::tick();    // 1 Hz countdown
 #endif
-  SwimMachine::tick();       // drive swim-machine protocol
+  // swim-machine protocol runs in its own task (see SwimMachine::begin)
 #endif
   static uint32_t lastMemLogMs = 0;
   uint32_t now = millis();
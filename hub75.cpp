@@ -1,9 +1,9 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
-#include <LittleFS.h>
 #include <ESP32-HUB75-MatrixPanel-I2S-DMA.h>
 #include <Fonts/TomThumb.h>
 #include "hub75.h"
+#include "settings_file.h"
 
 /*************** HUB75 Panel Config ***************/
 static const int PANEL_WIDTH  = 64;
@@ -44,42 +44,24 @@ static uint8_t percent_to_brightness8(uint8_t p) {
 }
 
 static void settings_load() {
-  if (!LittleFS.exists("/settings.json")) return;
-  File f = LittleFS.open("/settings.json", "r");
-  if (!f) return;
-  StaticJsonDocument<256> d;
-  if (deserializeJson(d, f) == DeserializationError::Ok) {
-    int b = d["brightness"] | -1;
-    if (b >= 0 && b <= 100) {
-      s_brightness_percent = (uint8_t)b;
-    }
-    long ss = d["screensaver_sec"] | -1;
-    if (ss >= 0 && ss <= 86400) {
-      s_screensaver_sec = (uint16_t)ss;
-    }
+  SettingsFile::Doc d; // shares the file with the lane map
+  if (!SettingsFile::read(d)) return;
+  int b = d["brightness"] | -1;
+  if (b >= 0 && b <= 100) {
+    s_brightness_percent = (uint8_t)b;
+  }
+  long ss = d["screensaver_sec"] | -1;
+  if (ss >= 0 && ss <= 86400) {
+    s_screensaver_sec = (uint16_t)ss;
   }
-  f.close();
 }
 
 static void settings_store() {
   // Preserve other keys in settings.json, only update the keys we own here
-  StaticJsonDocument<512> d;
-  if (LittleFS.exists("/settings.json")) {
-    File rf = LittleFS.open("/settings.json", "r");
-    if (rf) {
-      DeserializationError err = deserializeJson(d, rf);
-      rf.close();
-      if (err) {
-        d.clear();
-      }
-    }
-  }
-  d["brightness"] = s_brightness_percent;
-  d["screensaver_sec"] = s_screensaver_sec;
-  File wf = LittleFS.open("/settings.json", "w");
-  if (!wf) return;
-  serializeJson(d, wf);
-  wf.close();
+  SettingsFile::update([](SettingsFile::Doc &d) {
+    d["brightness"] = s_brightness_percent;
+    d["screensaver_sec"] = s_screensaver_sec;
+  });
 }
 
 // Power the panel off (clear it) / back on. Drawing functions skip output while
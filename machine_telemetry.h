@@ -0,0 +1,61 @@
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+#include <string.h>
+
+/* Read-only view over a 111-byte machine status packet.
+   Decodes fields in place from the receive buffer; the view must not outlive it.
+   Offsets follow the "111-byte message" table in README.md. */
+class MachineTelemetry {
+public:
+  static constexpr size_t kSize = 111;
+
+  explicit MachineTelemetry(const uint8_t* pkt) : m_p(pkt) {}
+
+  uint8_t  msgId()           const { return m_p[2]; }  // echoed idx2
+  uint8_t  state()           const { return m_p[3]; }  // status code (commands.csv)
+  uint8_t  currentSpeed()    const { return m_p[4]; }
+  uint8_t  targetSpeed()     const { return m_p[5]; }
+  uint16_t pace100s()        const { return u16(7); }  // seconds per 100 m
+  uint16_t remainingSec()    const { return u16(11); }
+  float    runtimeSec()      const { return f32(23); }
+  float    totalRuntimeSec() const { return f32(27); }
+  uint32_t timestamp()       const { return u32(71); } // machine clock, s since epoch
+
+private:
+  uint16_t u16(size_t o) const { return (uint16_t)(m_p[o] | (m_p[o + 1] << 8)); }
+  uint32_t u32(size_t o) const { uint32_t v; memcpy(&v, m_p + o, 4); return v; } // little-endian host
+  float    f32(size_t o) const { float v; memcpy(&v, m_p + o, 4); return v; }
+
+  const uint8_t* m_p;
+};
+
+/* Single-writer, many-reader "latest value" slot (seqlock).
+   The writer never blocks; readers retry while a store is in progress. */
+template <typename T>
+class LatestSlot {
+public:
+  void store(const T& v) {
+    uint32_t s = m_seq.load(std::memory_order_relaxed);
+    m_seq.store(s + 1, std::memory_order_relaxed); // odd: write in progress
+    std::atomic_thread_fence(std::memory_order_release);
+    m_val = v;
+    m_seq.store(s + 2, std::memory_order_release);
+  }
+
+  T load() const {
+    T v;
+    uint32_t s0, s1;
+    do {
+      s0 = m_seq.load(std::memory_order_acquire);
+      v = m_val;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      s1 = m_seq.load(std::memory_order_relaxed);
+    } while ((s0 & 1) || s0 != s1);
+    return v;
+  }
+
+private:
+  std::atomic<uint32_t> m_seq{0};
+  T m_val{};
+};
@@ -0,0 +1,208 @@
+#include "packet_capture.h"
+#include "esp_heap_caps.h"
+#include "esp_timer.h"
+#include <sys/time.h>
+#include <string.h>
+
+#define CAPTURE_RECORDS_PSRAM 4096 // ~0.5 MB
+#define CAPTURE_RECORDS_INTERNAL 128
+
+namespace
+{
+  struct Record
+  {
+    int64_t us;       // esp_timer time of capture
+    uint32_t src, dst; // IPv4, network byte order as held by IPAddress
+    uint16_t srcPort, dstPort;
+    uint16_t origLen;
+    uint8_t len;      // bytes stored (<= kSnapLen)
+    uint8_t dir;
+    uint8_t data[PacketCapture::kSnapLen];
+  };
+
+  Record *ring = nullptr;
+  size_t ringSize = 0;
+  uint32_t written = 0; // total records ever written; slot = seq % ringSize
+  portMUX_TYPE ringMux = portMUX_INITIALIZER_UNLOCKED;
+
+  // pcap stores wall-clock time; until SNTP has set the clock this stays 0
+  // and timestamps count from boot
+  int64_t epochOffsetUs()
+  {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (tv.tv_sec < 1600000000)
+      return 0;
+    return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec - esp_timer_get_time();
+  }
+
+  void put16be(uint8_t *p, uint16_t v)
+  {
+    p[0] = v >> 8;
+    p[1] = v & 0xFF;
+  }
+
+  // classic little-endian pcap header, microsecond timestamps, LINKTYPE_RAW
+  size_t renderFileHeader(uint8_t *p)
+  {
+    const uint32_t magic = 0xA1B2C3D4, snap = 28 + PacketCapture::kSnapLen, link = 101;
+    const uint16_t major = 2, minor = 4;
+    memset(p, 0, 24);
+    memcpy(p, &magic, 4);
+    memcpy(p + 4, &major, 2);
+    memcpy(p + 6, &minor, 2);
+    memcpy(p + 16, &snap, 4);
+    memcpy(p + 20, &link, 4);
+    return 24;
+  }
+
+  // pcap record header + IPv4 + UDP + payload
+  size_t renderRecord(const Record &r, int64_t offsetUs, uint8_t *p)
+  {
+    int64_t t = r.us + offsetUs;
+    uint32_t sec = (uint32_t)(t / 1000000), usec = (uint32_t)(t % 1000000);
+    uint32_t incl = 28 + r.len, orig = 28 + r.origLen;
+    memcpy(p, &sec, 4);
+    memcpy(p + 4, &usec, 4);
+    memcpy(p + 8, &incl, 4);
+    memcpy(p + 12, &orig, 4);
+
+    uint8_t *ip = p + 16;
+    memset(ip, 0, 28);
+    ip[0] = 0x45; // IPv4, 20-byte header
+    put16be(ip + 2, (uint16_t)orig);
+    ip[8] = 64;   // TTL
+    ip[9] = 17;   // UDP
+    memcpy(ip + 12, &r.src, 4);
+    memcpy(ip + 16, &r.dst, 4);
+    uint32_t sum = 0;
+    for (int i = 0; i < 20; i += 2)
+      sum += (ip[i] << 8) | ip[i + 1];
+    while (sum >> 16)
+      sum = (sum & 0xFFFF) + (sum >> 16);
+    put16be(ip + 10, (uint16_t)~sum);
+
+    uint8_t *udp = ip + 20;
+    put16be(udp, r.srcPort);
+    put16be(udp + 2, r.dstPort);
+    put16be(udp + 4, (uint16_t)(8 + r.origLen));
+    // UDP checksum 0 = not computed
+
+    memcpy(udp + 8, r.data, r.len);
+    return 16 + incl;
+  }
+}
+
+void PacketCapture::begin()
+{
+  if (ring)
+    return;
+  ringSize = CAPTURE_RECORDS_PSRAM;
+  ring = (Record *)heap_caps_malloc(ringSize * sizeof(Record), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+  if (!ring)
+  {
+    ringSize = CAPTURE_RECORDS_INTERNAL;
+    ring = (Record *)heap_caps_malloc(ringSize * sizeof(Record), MALLOC_CAP_8BIT);
+  }
+  if (!ring)
+    ringSize = 0;
+  Serial.printf("PacketCapture: %u records\n", (unsigned)ringSize);
+}
+
+void PacketCapture::record(Direction dir, const IPAddress &src, uint16_t srcPort,
+                           const IPAddress &dst, uint16_t dstPort, const uint8_t *data, size_t len)
+{
+  if (!ring)
+    return;
+  int64_t now = esp_timer_get_time();
+  size_t n = len < kSnapLen ? len : kSnapLen;
+
+  portENTER_CRITICAL(&ringMux);
+  Record &r = ring[written % ringSize];
+  r.us = now;
+  r.src = (uint32_t)src;
+  r.dst = (uint32_t)dst;
+  r.srcPort = srcPort;
+  r.dstPort = dstPort;
+  r.origLen = len > 0xFFFF ? 0xFFFF : (uint16_t)len;
+  r.len = (uint8_t)n;
+  r.dir = dir;
+  memcpy(r.data, data, n);
+  written++;
+  portEXIT_CRITICAL(&ringMux);
+}
+
+size_t PacketCapture::capacity()
+{
+  return ringSize;
+}
+
+uint32_t PacketCapture::count()
+{
+  return written;
+}
+
+void PacketCapture::clear()
+{
+  portENTER_CRITICAL(&ringMux);
+  written = 0;
+  portEXIT_CRITICAL(&ringMux);
+}
+
+void PacketCapture::startExport(Cursor &c)
+{
+  portENTER_CRITICAL(&ringMux);
+  c.end = written;
+  c.next = written > ringSize ? written - ringSize : 0;
+  portEXIT_CRITICAL(&ringMux);
+  c.headerSent = false;
+  c.offsetUs = epochOffsetUs();
+  c.stageLen = c.stageOff = 0;
+}
+
+size_t PacketCapture::read(Cursor &c, uint8_t *buf, size_t maxLen)
+{
+  size_t out = 0;
+  while (out < maxLen)
+  {
+    if (c.stageOff == c.stageLen)
+    { // render the next piece into the stage
+      c.stageOff = 0;
+      if (!c.headerSent)
+      {
+        c.stageLen = renderFileHeader(c.stage);
+        c.headerSent = true;
+      }
+      else
+      {
+        Record r;
+        bool have = false;
+        portENTER_CRITICAL(&ringMux);
+        if (c.next > written) // cleared while streaming
+          c.next = c.end;
+        else if (written - c.next > ringSize) // overwritten while streaming
+          c.next = written - ringSize;
+        if (c.next < c.end && c.next < written)
+        {
+          r = ring[c.next % ringSize];
+          have = true;
+        }
+        portEXIT_CRITICAL(&ringMux);
+        if (!have)
+        {
+          c.stageLen = 0;
+          break;
+        }
+        c.next++;
+        c.stageLen = renderRecord(r, c.offsetUs, c.stage);
+      }
+    }
+    size_t n = c.stageLen - c.stageOff;
+    if (n > maxLen - out)
+      n = maxLen - out;
+    memcpy(buf + out, c.stage + c.stageOff, n);
+    c.stageOff += n;
+    out += n;
+  }
+  return out;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <Arduino.h>
+
+/* On-device capture of the swim-machine traffic (sent 44-byte commands and
+   received status packets). A fixed ring of records, allocated once in PSRAM
+   when present, overwritten oldest-first. Read back as a pcap file
+   (LINKTYPE_RAW: each record gets a synthesized IPv4/UDP header) a piece at a
+   time, so the file is never built in RAM. */
+namespace PacketCapture
+{
+  constexpr size_t kSnapLen = 111; // largest packet we care about (status)
+
+  enum Direction : uint8_t
+  {
+    Rx = 0,
+    Tx = 1
+  };
+
+  /** Allocate the ring; call once from setup(). Without it record() is a no-op. */
+  void begin();
+
+  /** Append one datagram (payload beyond kSnapLen is cut). Allocation-free. */
+  void record(Direction dir, const IPAddress &src, uint16_t srcPort,
+              const IPAddress &dst, uint16_t dstPort, const uint8_t *data, size_t len);
+
+  size_t capacity(); // records the ring holds (0 before begin())
+  uint32_t count();  // records written since boot (wraps the ring)
+  void clear();
+
+  /** pcap export of the records present when the cursor was started. */
+  struct Cursor
+  {
+    uint32_t next = 0;      // next record sequence number
+    uint32_t end = 0;       // one past the last record to export
+    bool headerSent = false;
+    int64_t offsetUs = 0;   // esp_timer -> wall clock
+    uint8_t stage[16 + 28 + kSnapLen]; // one rendered record (or the file header)
+    size_t stageLen = 0;
+    size_t stageOff = 0;
+  };
+
+  void startExport(Cursor &c);
+
+  /** Fill buf with up to maxLen bytes of the pcap stream; 0 when done. */
+  size_t read(Cursor &c, uint8_t *buf, size_t maxLen);
+}
@@ -0,0 +1,37 @@
+#include "progress_json.h"
+#include <ArduinoJson.h>
+
+size_t ProgressJson::write(const SwimMachine::SwimStatus &st, char *out, size_t len)
+{
+  StaticJsonDocument<768> doc;
+  doc["running"] = st.active;
+  doc["paused"] = st.paused;
+  doc["armed"] = st.armed;
+  doc["step"] = st.idx;
+  doc["steps"] = st.steps;
+  doc["elapsed_ms"] = st.elapsedMs;
+  doc["workout_ms"] = st.workoutMs;
+  doc["paused_ms"] = st.pausedMs;
+  doc["pace100s"] = st.pace100s;
+  doc["pace_offset"] = st.paceOffset;
+
+  JsonObject link = doc.createNestedObject("link");
+  link["state"] = st.found ? "up" : (st.everFound ? "lost" : "searching");
+  if (st.everFound)
+    link["age_ms"] = st.linkAgeMs;
+
+  // What the machine itself reports (from its latest status packet)
+  if (st.machine.valid)
+  {
+    JsonObject m = doc.createNestedObject("machine");
+    m["state"] = st.machine.state;
+    m["cur_speed"] = st.machine.curSpeed;
+    m["tgt_speed"] = st.machine.tgtSpeed;
+    m["pace100s"] = st.machine.pace100s;
+    m["remaining_sec"] = st.machine.remainingSec;
+    m["runtime_sec"] = st.machine.runtimeSec;
+    m["total_runtime_sec"] = st.machine.totalRuntimeSec;
+    m["age_ms"] = SwimClock::millis() - st.machine.receivedMs;
+  }
+  return serializeJson(doc, out, len);
+}
@@ -0,0 +1,14 @@
+#pragma once
+#include "swim_machine.h"
+
+/* The "progress" event of one lane: the playback state and what the
+   machine last reported, with no workout text (that goes out once, in
+   "plan"). Written into the caller's buffer from a fixed-size document, so
+   a push takes nothing from the heap. */
+namespace ProgressJson
+{
+  constexpr size_t kMax = 512; // an event fits in this
+
+  /** Serialize st into out (NUL-terminated); the length written. */
+  size_t write(const SwimMachine::SwimStatus &st, char *out, size_t len);
+}
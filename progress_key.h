@@ -0,0 +1,55 @@
+#pragma once
+#include "swim_machine.h"
+
+// What a "progress" event reports besides the clocks. A new event goes out
+// when any of it changes; elapsed/workout time alone does not count, the
+// clients run those forward themselves.
+struct ProgressKey
+{
+  bool running, paused, armed, machineValid;
+  int32_t step;
+  uint16_t pace100s;
+  uint8_t link; // 0 searching, 1 up, 2 lost
+  uint8_t state, curSpeed, tgtSpeed;
+  uint16_t machinePace;
+  int16_t paceOffset;
+
+  bool operator==(const ProgressKey &o) const
+  {
+    return running == o.running && paused == o.paused && armed == o.armed &&
+           machineValid == o.machineValid && step == o.step && pace100s == o.pace100s &&
+           link == o.link && state == o.state && curSpeed == o.curSpeed &&
+           tgtSpeed == o.tgtSpeed && machinePace == o.machinePace &&
+           paceOffset == o.paceOffset;
+  }
+
+  static ProgressKey of(const SwimMachine::SwimStatus &st)
+  {
+    return ProgressKey{st.active, st.paused, st.armed, st.machine.valid, st.idx, st.pace100s,
+                       (uint8_t)(st.found ? 1 : st.everFound ? 2 : 0),
+                       st.machine.state, st.machine.curSpeed, st.machine.tgtSpeed, st.machine.pace100s,
+                       st.paceOffset};
+  }
+};
+
+// Decides when one lane's "progress" event is due: on a change, when forced
+// (run/pause/stop), and every resyncMs while nothing changes
+class ProgressGate
+{
+public:
+  static const uint32_t kResyncMs = 15000;
+
+  bool due(const SwimMachine::SwimStatus &st, uint32_t nowMs, bool force = false)
+  {
+    ProgressKey k = ProgressKey::of(st);
+    if (!force && k == m_last && nowMs - m_sentMs < kResyncMs) // unsigned: survives the millis() wrap
+      return false;
+    m_last = k;
+    m_sentMs = nowMs;
+    return true;
+  }
+
+private:
+  ProgressKey m_last = {};
+  uint32_t m_sentMs = 0;
+};
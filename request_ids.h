@@ -0,0 +1,48 @@
+#pragma once
+#include <Arduino.h>
+#include <string.h>
+
+/* The answers to the last N control requests, by request id. A request
+   resent after a reconnect is answered from its first result instead of
+   running twice. Ids longer than IdLen - 1 must be rejected by the caller. */
+template <size_t N, size_t IdLen>
+class RecentRequests
+{
+public:
+  // true when id was seen; error gets its first answer (nullptr = ok)
+  bool seen(const char *id, const char *&error)
+  {
+    bool found = false;
+    portENTER_CRITICAL(&m_mux);
+    for (const Entry &r : m_r)
+      if (r.id[0] && strcmp(r.id, id) == 0)
+      {
+        error = r.error;
+        found = true;
+        break;
+      }
+    portEXIT_CRITICAL(&m_mux);
+    return found;
+  }
+
+  // error must be a string literal (it is kept, not copied)
+  void remember(const char *id, const char *error)
+  {
+    portENTER_CRITICAL(&m_mux);
+    Entry &r = m_r[m_next];
+    m_next = (m_next + 1) % N;
+    strlcpy(r.id, id, sizeof r.id);
+    r.error = error;
+    portEXIT_CRITICAL(&m_mux);
+  }
+
+private:
+  struct Entry
+  {
+    char id[IdLen];
+    const char *error; // nullptr = ok
+  };
+  Entry m_r[N] = {};
+  size_t m_next = 0;
+  portMUX_TYPE m_mux = portMUX_INITIALIZER_UNLOCKED;
+};
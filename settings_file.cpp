@@ -0,0 +1,53 @@
+#include "settings_file.h"
+#include <LittleFS.h>
+
+namespace SettingsFile
+{
+  static const char *const kPath = "/settings.json";
+
+  static SemaphoreHandle_t mutex()
+  {
+    static SemaphoreHandle_t s = xSemaphoreCreateMutex();
+    return s;
+  }
+
+  struct Lock
+  {
+    Lock() { xSemaphoreTake(mutex(), portMAX_DELAY); }
+    ~Lock() { xSemaphoreGive(mutex()); }
+  };
+
+  static bool readLocked(Doc &d)
+  {
+    d.clear();
+    File f = LittleFS.open(kPath, "r");
+    if (!f)
+      return false;
+    bool ok = deserializeJson(d, f) == DeserializationError::Ok;
+    f.close();
+    if (!ok)
+      d.clear();
+    return ok;
+  }
+
+  bool read(Doc &d)
+  {
+    Lock lock;
+    return LittleFS.exists(kPath) && readLocked(d);
+  }
+
+  bool update(void (*edit)(Doc &d))
+  {
+    Lock lock;
+    Doc d;
+    if (LittleFS.exists(kPath))
+      readLocked(d);
+    edit(d);
+    File f = LittleFS.open(kPath, "w");
+    if (!f)
+      return false;
+    serializeJson(d, f);
+    f.close();
+    return true;
+  }
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/* /settings.json, shared by the modules that keep a setting in it (the
+   HUB75 brightness and screen saver, the lane map). Every read and every
+   read-modify-write goes through here under one mutex, so two writers
+   cannot interleave and lose each other's keys, and a reader never sees a
+   half-written file. */
+
+namespace SettingsFile
+{
+  using Doc = StaticJsonDocument<512>;
+
+  /** The whole file; false (and d empty) when missing or not valid JSON. */
+  bool read(Doc &d);
+
+  /** Read the file, let edit() set its own keys, write it back; the keys
+      edit() does not touch are kept. */
+  bool update(void (*edit)(Doc &d));
+}
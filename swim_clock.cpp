@@ -0,0 +1,61 @@
+#include "swim_clock.h"
+#include "esp_timer.h"
+
+namespace
+{
+  int64_t timerMicros() { return esp_timer_get_time(); }
+
+  SwimClock::Source source = timerMicros;
+#ifdef SWIM_CLOCK_WARP
+  // written under the protocol lock; a reader racing setWarp() may see
+  // one mixed sample, which the callers' monotonic checks absorb
+  volatile uint16_t factor = 1;
+  volatile int64_t srcBase = 0; // source time at the last setWarp()
+  volatile int64_t outBase = 0; // workout time at the last setWarp()
+#endif
+}
+
+int64_t SwimClock::micros64()
+{
+#ifdef SWIM_CLOCK_WARP
+  int64_t s = source();
+  return outBase + (s - srcBase) * factor;
+#else
+  return source();
+#endif
+}
+
+uint32_t SwimClock::millis()
+{
+  return (uint32_t)(micros64() / 1000);
+}
+
+void SwimClock::setSource(Source src)
+{
+  source = src ? src : timerMicros;
+#ifdef SWIM_CLOCK_WARP
+  srcBase = source();
+  outBase = srcBase;
+#endif
+}
+
+#ifdef SWIM_CLOCK_WARP
+void SwimClock::setWarp(uint16_t f)
+{
+  if (!f)
+    f = 1;
+  int64_t s = source();
+  outBase = outBase + (s - srcBase) * factor;
+  srcBase = s;
+  factor = f;
+}
+#endif
+
+uint16_t SwimClock::warp()
+{
+#ifdef SWIM_CLOCK_WARP
+  return factor;
+#else
+  return 1;
+#endif
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <Arduino.h>
+
+/* Clock for workout timing (segment boundaries, ramp learning, status
+   elapsed time, packet timestamps). Network timing (RTT, retransmission,
+   link timeout) stays on the real clock.
+
+   64-bit microseconds from esp_timer: monotonic and, unlike millis(),
+   it does not wrap (292k years), so schedules can be compared directly.
+   A different source can be injected, and with SWIM_CLOCK_WARP defined
+   the clock can run a whole number of times faster than real time, so a
+   long workout can be played against the emulator
+   (viewer/emulator.js --warp) in minutes. */
+
+// #define SWIM_CLOCK_WARP
+
+namespace SwimClock
+{
+  using Source = int64_t (*)(); // microseconds, monotonic
+
+  /** Workout time in microseconds. */
+  int64_t micros64();
+
+  /** Workout time in ms, truncated to 32 bits (wraps like millis()). */
+  uint32_t millis();
+
+  /** Replace the time source (nullptr: back to esp_timer). */
+  void setSource(Source src);
+
+#ifdef SWIM_CLOCK_WARP
+  /** Run `factor` times faster than the source (1 = real time). Continuous across changes. */
+  void setWarp(uint16_t factor);
+#endif
+  uint16_t warp();
+}
@@ -1,129 +1,488 @@
 #include "swim_machine.h"
 #include "UDPEventSender.h"
+#include "crc32.h"
+#include "command_queue.h"
+#include "machine_telemetry.h"
+#include "packet_capture.h"
+#include "swim_clock.h"
 #include <vector>
 
-/* ------------ internal state ----------------------------------- */
-namespace
-{
-  std::vector<SwimMachine::Segment> workout;
-  bool motorOn = false;
-  bool machineFound = false;
-
-  // Function pointer to push network event
-  void (*push_network_event_func)(const uint8_t *data, size_t len) = nullptr;
-
-  struct
-  {
-    int32_t idx = -1;      // current segment
-    uint32_t segStart = 0; // ms at seg start
-    bool active = false;
-    bool paused = false;
-  } sim;
-}
-
 /* ------------ multicast/control via UDPEventSender -------------- */
 
 const IPAddress multicastAddr(239, 255, 0, 1);
 const uint16_t multicastPort = 45654;
 
-static IPAddress peer_ip(255, 255, 255, 255);
+static const IPAddress broadcastAddr(255, 255, 255, 255);
 static uint16_t PEER_PORT = 9750;
+static const uint16_t CTRL_LOCAL_PORT = 40000;
 
-// Two UDPEventSender instances:
+// Two UDPEventSender instances, shared by all machines:
 // - mcast: joined to multicast group for incoming status/acks
-// - ctrl:  unicast/broadcast for control commands to the swim machine
+// - ctrl:  unicast/broadcast for control commands to the swim machines
 static UDPEventSender mcast;
 static UDPEventSender ctrl;
 
-/* ------------ helpers: CRC-32 & monotonic tick ------------------ */
-static uint32_t crc32(const uint8_t *d, size_t n)
+// Function pointer to push network event
+static void (*push_network_event_func)(const uint8_t *data, size_t len) = nullptr;
+
+// Drop status packets whose header or CRC (bytes 107-110) does not check out.
+// Comment out to accept every 111-byte datagram as before.
+#define VERIFY_STATUS_CRC
+
+// Socket-level counters (not attributable to a machine)
+static struct
+{
+  uint32_t badLength;
+  uint32_t badCrc;
+  uint32_t noSlot;
+} rxStats = {};
+
+/* ------------ protocol task ------------------------------------- */
+// The protocol runs in its own task: it wakes when a command is queued
+// and polls the sockets every PROTOCOL_POLL_MS, so an ack is answered
+// with the next command within a few ms instead of the next 250 ms tick.
+#define PROTOCOL_POLL_MS 5
+#define PROTOCOL_TASK_STACK 4096
+#define PROTOCOL_TASK_PRIO 2
+#define PROTOCOL_TASK_CORE 1
+
+static TaskHandle_t protocolTaskHandle = nullptr;
+// recursive: stop() runs inside tick(). Created at static init, not in
+// begin(): the web server starts first and its handlers take it too.
+static SemaphoreHandle_t protocolLock = xSemaphoreCreateRecursiveMutex();
+
+namespace
+{
+  // Serialises the HTTP handlers, loop() and the protocol task
+  struct ProtocolGuard
+  {
+    ProtocolGuard() { xSemaphoreTakeRecursive(protocolLock, portMAX_DELAY); }
+    ~ProtocolGuard() { xSemaphoreGiveRecursive(protocolLock); }
+  };
+}
+
+static void wakeProtocol()
+{
+  if (protocolTaskHandle)
+    xTaskNotifyGive(protocolTaskHandle);
+}
+
+/* ------------ helpers: packet check & monotonic tick ------------ */
+// our address on the active interface, for the capture's IP headers
+static IPAddress localAddr()
+{
+  IPAddress ip = ETH.localIP();
+  return ip != IPAddress(0, 0, 0, 0) ? ip : WiFi.localIP();
+}
+
+static bool statusPacketValid(const uint8_t *d, size_t len)
 {
-  uint32_t c = 0xFFFFFFFF;
-  while (n--)
+  if (len != 111)
   {
-    c ^= *d++;
-    for (int k = 0; k < 8; ++k)
-      c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : (c >> 1);
+    rxStats.badLength++;
+    return false;
+  }
+#ifdef VERIFY_STATUS_CRC
+  if (d[0] != 0x0A || d[1] != 0xF0 || !Crc32::checkTrailer(d, len))
+  {
+    rxStats.badCrc++;
+    return false;
   }
-  return ~c;
+#endif
+  return true;
 }
 static uint32_t monoTick()
-{ // never repeats
-  static uint32_t last = 0, now;
-  now = millis();
+{ // never repeats (within the 32-bit field); compared in 64 bits so the
+  // millis() wrap after ~49 days does not pin it to last + 1
+  static int64_t last = 0;
+  int64_t now = SwimClock::micros64() / 1000;
   if (now <= last)
     now = last + 1;
   last = now;
-  return last;
+  return (uint32_t)last;
 }
 
-/* ------------ send queue and flow control ----------------------- */
-static uint16_t messagequeue[16];
-static uint16_t *nextmessagetosend = messagequeue;
-static uint16_t *nextmessage = messagequeue;
+/* ------------ round-trip time & retransmission ------------------ */
+// Jacobson/Karels estimator as in TCP (RFC 6298): RTO = SRTT + 4*RTTVAR,
+// sampled only from commands acked without a retransmission (Karn), doubled
+// on every retransmission up to RTO_MAX_MS.
+#define RTO_INITIAL_MS 600 // ~ the old "two status packets without echo"
+#define RTO_MIN_MS 300     // status packets arrive every ~250 ms
+#define RTO_MAX_MS 4000
 
-static uint8_t lastSentIdx2 = 0xC5; // so first increment is 0x64
-static uint8_t idx2Counter = 0xC5;  // so first increment is 0x64
-static bool readyToSendNext = true;
-static bool resendLastPacket = false;
-static uint8_t lastReceivedCommand = 0x00; // last command byte received from machine (data[3] of 111-byte packet)
+static const uint8_t trackedOpcodes[SwimMachine::kTrackedCommands] = {0x1F, 0x21, 0x24, 0x25};
 
-static void queuePkt(uint16_t command, uint16_t param = 0)
+static uint32_t clampRto(uint32_t us)
 {
-  *nextmessage = command;
-  nextmessage++;
-  *nextmessage = param;
-  nextmessage++;
-  if (nextmessage - messagequeue >= (int)(sizeof(messagequeue) / sizeof(*messagequeue)))
-    nextmessage = messagequeue;
+  if (us < RTO_MIN_MS * 1000UL)
+    return RTO_MIN_MS * 1000UL;
+  if (us > RTO_MAX_MS * 1000UL)
+    return RTO_MAX_MS * 1000UL;
+  return us;
 }
 
-static void confirmPacket(uint8_t idx2, uint8_t cmdByte)
+/* ------------ ramp model & lookahead ---------------------------- */
+// The machine needs time to get the water to a new speed: command round
+// trip plus a ramp roughly proportional to the speed change. Both are
+// learned from the status packets, and the commands for the next segment
+// are sent that much before its boundary so the water is at the new speed
+// when the segment starts. Boundaries are planned from the workout start
+// (not from when tick() noticed them), so no error accumulates.
+#define LEAD_DEFAULT_MS 1000 // used until a ramp has been measured (old fixed lag)
+#define LEAD_MAX_MS 10000
+#define RAMP_MIN_DELTA 2     // ignore tiny speed changes when learning
+
+// Ramp steps (a pace that changes over the step) are played as a stream of
+// pace commands. The next one goes out only once the previous one has been
+// acknowledged and at most every RTO (smoothed ack latency plus margin),
+// never faster than RAMP_STREAM_MIN_MS; it carries the pace planned for
+// when it will reach the machine, so when acks are slow intermediate
+// values are skipped instead of queueing up behind.
+#define RAMP_STREAM_MIN_MS 1000
+
+// The segment report keeps one entry per step up to this many (a long
+// repeat set would otherwise cost memory per step again), plus the stop
+#define REPORT_MAX_STEPS 64
+
+static uint16_t ewma(uint16_t avg, uint32_t sample)
 {
-  // Update global last received command byte from machine status packet
-  lastReceivedCommand = cmdByte;
-  if (readyToSendNext)
-    return;
-  static uint8_t lastReceivedIdx2 = 0;
-  static int consecutiveMisses = 0;
+  if (sample > 0xFFFF)
+    sample = 0xFFFF;
+  return avg ? (uint16_t)((avg * 3 + sample) / 4) : (uint16_t)sample;
+}
+
+/* ------------ liveness ------------------------------------------- */
+// A machine is considered gone after LINK_TIMEOUT_MS without a status
+// packet. Until then commands go unicast to the address its status packets
+// come from (unless setPeerIP() pinned one); when it goes quiet a lone
+// machine falls back to broadcast and is rediscovered from its next packet.
+#define LINK_TIMEOUT_MS 5000
+
+/* =================================================================
+ *        O N E   M A C H I N E   ( P E R   S O U R C E   I P )
+ * ================================================================= */
+namespace
+{
+  struct Machine
+  {
+    /* identity & link */
+    IPAddress ip;           // source address of its status packets
+    bool claimed = false;   // slot bound to a machine (heard or pinned)
+    bool peerPinned = false; // set by setPeerIP()
+    bool found = false;
+    bool everFound = false;
+    uint32_t lastHeardMs = 0;
+
+    /* workout playback */
+    WorkoutProgram::Program workout;
+    WorkoutProgram::Cursor cur;   // current step while active
+    uint32_t steps = 0;           // steps the program expands to (set by start/arm)
+    bool motorOn = false;
+    uint16_t lastPace = 0;
+    // times in SwimClock µs; boundaries are planned, not observed
+    struct
+    {
+      int32_t idx = -1;        // current segment (cur.index)
+      int64_t segStartUs = 0;  // planned start of idx, shifted by pauses (may lie ahead during the first ramp)
+      int64_t pausedAtUs = 0;  // when the current pause began
+      int64_t pausedTotalUs = 0; // time spent paused in this workout
+      bool active = false;
+      bool paused = false;
+      bool nextIssued = false; // commands for idx+1 already sent ahead of the boundary
+    } sim;
+
+    /* send queue and flow control: the first inFlightCount queue entries
+       are on the wire, inFlight[i] tracks txQueue.at(i) */
+    CommandQueue txQueue;
+    struct InFlight
+    {
+      uint8_t idx2;
+      uint8_t retries;
+      uint32_t firstSentUs; // first transmission
+      uint32_t lastTxUs;    // latest (re)transmission
+    } inFlight[SwimMachine::kMaxSendWindow];
+    uint8_t inFlightCount = 0;
+    uint8_t window = 1;          // commands allowed on the wire at once
+    uint8_t windowTimeouts = 0;  // retransmissions while pipelining
+    uint8_t idx2Counter = 0xC5;  // so first increment is 0x64
+    bool resendDue = false;      // the oldest in-flight command ran out of RTO
+    bool urgentPending = false;      // fast-path stop not on the wire yet
+    uint32_t urgentRequestUs = 0;    // micros() of the stop()/pause() call
+    uint8_t lastReceivedCommand = 0x00; // last command byte received from machine (data[3] of 111-byte packet)
 
-  // Track if we received the expected idx2 value
-  if (idx2 == lastSentIdx2)
+    /* round-trip time */
+    int32_t srttUs = -1;      // < 0: no sample yet
+    int32_t rttvarUs = 0;
+    uint32_t rtoUs = RTO_INITIAL_MS * 1000UL;
+
+    /* ramp model */
+    struct
+    {
+      uint16_t upMsPerUnit = 0;   // 0 = not learned yet
+      uint16_t downMsPerUnit = 0;
+      uint32_t speedPaceK = 0;    // speed * pace100s at steady state (speed ~ 1/pace)
+      bool ramping = false;
+      uint8_t from = 0, to = 0;
+      int64_t startUs = 0;
+      int64_t boundaryUs = 0;     // planned boundary the current ramp should meet
+      bool boundaryPending = false;
+    } ramp;
+
+    SwimMachine::ProtocolStats stats = {};
+
+    uint32_t paceStreamUs = 0;    // micros() of the last streamed ramp pace
+    int16_t paceOffset = 0;       // swimmer's adjustment to every swim pace (s/100 m, - = faster)
+
+    bool motorWait = false;       // start() sent, motor not turning yet
+    bool armed = false;           // duration and first pace already sent by arm()
+    uint16_t armedPace = 0;       // the pace arm() sent (0 = first step is rest only)
+    uint32_t motorWaitUs = 0;
+
+    /* per-segment timing report of the current/last workout */
+    std::vector<SwimMachine::SegmentReport> report; // one per segment (up to REPORT_MAX_STEPS) + the final stop
+    int32_t reportIdx = -1; // entry of the segment whose commands are going out
+    int64_t workoutStartUs = 0;
+    LatestSlot<SwimMachine::Telemetry> telemetry; // written by the protocol task only
+
+    IPAddress target() const;
+
+    void queuePkt(uint8_t command, uint16_t param = 0, bool coalesce = false);
+    SwimMachine::CommandStats *commandStats(uint8_t opcode);
+    void sampleRtt(int32_t r);
+    void recordAck(const InFlight &f, uint8_t opcode, bool echoed, uint32_t now);
+    void checkRetransmit();
+    void confirmPacket(uint8_t idx2, uint8_t cmdByte, uint16_t machinePace);
+    void fallBackToStopAndWait(const char *why);
+
+    void setDuration(uint16_t s) { queuePkt(0x25, s, true); }
+    void setPace(uint16_t p);
+    void sendStart() { queuePkt(0x1F); }
+    void sendStop() { queuePkt(0x21); }
+    void motorStart();
+    void motorStop();
+    void urgentStop(uint32_t requestUs);
+
+    void learnRamp(const SwimMachine::Telemetry &t, int64_t nowUs);
+    uint8_t speedForPace(uint16_t pace100s) const;
+    uint32_t transitUs() const;
+    uint32_t leadMs(uint16_t fromPace, uint16_t toPace) const;
+    void issueSegment(const WorkoutProgram::Cursor &c, uint16_t fromPace, int64_t boundaryUs);
+    int32_t reportSlot(int32_t i) const;
+    uint16_t plannedPace(int64_t nowUs) const;
+    uint16_t adjusted(uint16_t pace100s) const;
+    void setPaceOffset(int16_t offset);
+    bool commandQueued(uint8_t opcode) const;
+    void streamRampPace(int64_t nowUs);
+
+    uint8_t nextIdx2();
+    void transmit(uint8_t slot, bool resend);
+    void sendPkt();
+    void checkLink();
+    void onStatus(const MachineTelemetry &pkt, const IPAddress &remote);
+    void forget();
+
+    uint32_t activeSec();
+    uint16_t firstPace() const;
+    bool canArm(const WorkoutProgram::Program &p) const;
+    void load(const WorkoutProgram::Program &p);
+    bool arm();
+    bool start();
+    void pause(uint32_t requestUs);
+    void stop();
+    void abort(uint32_t requestUs);
+    void tick();
+  };
+
+  Machine machines[SwimMachine::kMaxMachines];
+}
+
+static size_t claimedCount()
+{
+  size_t n = 0;
+  for (auto &m : machines)
+    if (m.claimed)
+      n++;
+  return n;
+}
+
+// Status packets are attributed by source address, so a pool keeps its slot
+// (its ?m= lane) for as long as it is heard; bindMachine() restores the
+// address of each slot after a reboot. With a single bound slot that is lost
+// and idle, an unknown address is that pool back from a new address (DHCP
+// renew, or a stored address it no longer has) and takes the slot over.
+// Otherwise an unknown address takes a free slot, and only when there is
+// none a lost one that is idle: a second pool coming up while lane 0 has a
+// dropout must not get lane 0's workout or commands.
+static bool idleLost(const Machine &m)
+{
+  return !m.found && !m.peerPinned && !m.sim.active && !m.armed;
+}
+
+static Machine *machineFor(const IPAddress &remote)
+{
+  for (auto &m : machines)
+    if (m.claimed && m.ip == remote)
+      return &m;
+  if (claimedCount() == 1)
+    for (auto &m : machines)
+      if (m.claimed && idleLost(m))
+        return &m;
+  for (auto &m : machines)
+    if (!m.claimed)
+      return &m;
+  for (auto &m : machines)
+    if (idleLost(m))
+      return &m;
+  return nullptr;
+}
+
+/* ------------ send queue and flow control ----------------------- */
+IPAddress Machine::target() const
+{
+  // unicast once known; a lone unpinned machine that went quiet is searched
+  // for by broadcast (never with several, that would reach the other pools)
+  if (!claimed || (!found && !peerPinned && claimedCount() <= 1))
+    return broadcastAddr;
+  return ip;
+}
+
+// coalesce: a still-pending command with the same opcode takes the new
+// parameter instead of queueing another (set-value commands only)
+void Machine::queuePkt(uint8_t command, uint16_t param, bool coalesce)
+{
+  uint8_t locked = inFlightCount; // on the wire awaiting their ack
+  if (!txQueue.push(command, param, coalesce, locked))
   {
-    consecutiveMisses = 0;
-    lastReceivedIdx2 = idx2;
-    readyToSendNext = true;
-    resendLastPacket = false;
-    nextmessagetosend += 2;
-    if (nextmessagetosend - messagequeue >= (int)(sizeof(messagequeue) / sizeof(*messagequeue)))
-      nextmessagetosend = messagequeue;
+    Serial.printf("SwimMachine: command queue full, ");
+    if (command != 0x21)
+    {
+      Serial.printf("dropping 0x%02X\n", command);
+      return;
+    }
+    // a stop must never be lost: everything pending before it is obsolete
+    Serial.printf("flushing pending commands for stop\n");
+    txQueue.dropPending(locked);
+    txQueue.push(command, param, false, locked);
+  }
+  wakeProtocol();
+}
+
+SwimMachine::CommandStats *Machine::commandStats(uint8_t opcode)
+{
+  for (size_t i = 0; i < SwimMachine::kTrackedCommands; ++i)
+    if (trackedOpcodes[i] == opcode)
+      return &stats.commands[i];
+  return nullptr;
+}
+
+void Machine::sampleRtt(int32_t r)
+{
+  if (srttUs < 0)
+  {
+    srttUs = r;
+    rttvarUs = r / 2;
   }
   else
   {
-    consecutiveMisses++;
-    if (consecutiveMisses >= 2)
+    int32_t err = r - srttUs;
+    rttvarUs += ((err < 0 ? -err : err) - rttvarUs) / 4;
+    srttUs += err / 8;
+  }
+  rtoUs = clampRto(srttUs + 4 * rttvarUs);
+}
+
+// echoed: the status packet carried this command's idx2 (not a later one)
+void Machine::recordAck(const InFlight &f, uint8_t opcode, bool echoed, uint32_t now)
+{
+  uint32_t ms = (now - f.firstSentUs) / 1000;
+  size_t b = 0;
+  while (b < SwimMachine::kAckHistBuckets - 1 && ms > SwimMachine::kAckHistBoundsMs[b])
+    b++;
+  stats.ackHist[b]++;
+  stats.ackCount++;
+  stats.ackLastMs = ms;
+  if (ms > stats.ackMaxMs)
+    stats.ackMaxMs = ms;
+
+  if (SwimMachine::CommandStats *cs = commandStats(opcode))
+  {
+    cs->acked++;
+    cs->lastAckMs = ms;
+  }
+  if (echoed && f.retries == 0)
+    sampleRtt((int32_t)(now - f.lastTxUs));
+}
+
+// Arm a resend of the oldest in-flight command once its RTO has run out
+void Machine::checkRetransmit()
+{
+  if (!inFlightCount || resendDue)
+    return;
+  if (micros() - inFlight[0].lastTxUs >= rtoUs)
+    resendDue = true;
+}
+
+void Machine::fallBackToStopAndWait(const char *why)
+{
+  if (window == 1)
+    return;
+  Serial.printf("SwimMachine: %s, send window %u -> 1\n", why, window);
+  window = 1;
+  stats.windowFallbacks++;
+}
+
+// The machine echoes only the idx2 of the latest command it took. With
+// several commands in flight an echo acknowledges that one and, in order,
+// every command sent before it. A pipelined pace that the echo skipped is
+// checked against the pace the machine reports; a mismatch means the
+// machine dropped it, so it is sent again and pipelining is switched off.
+void Machine::confirmPacket(uint8_t idx2, uint8_t cmdByte, uint16_t machinePace)
+{
+  // Update last received command byte from machine status packet
+  lastReceivedCommand = cmdByte;
+
+  int p = -1;
+  for (int i = 0; i < inFlightCount; ++i)
+    if (inFlight[i].idx2 == idx2)
+      p = i;
+  if (p < 0)
+    return;
+
+  uint32_t now = micros();
+  int lastPaceSlot = -1;
+  uint16_t paceParam = 0;
+  for (int i = 0; i <= p; ++i)
+  {
+    const CommandQueue::Command c = txQueue.front();
+    if (c.opcode == 0x24)
     {
-      // Resend the last packet
-      resendLastPacket = true;
-      consecutiveMisses = 0;
+      lastPaceSlot = i;
+      paceParam = c.param;
     }
+    recordAck(inFlight[i], c.opcode, i == p, now);
+    txQueue.pop();
+  }
+  inFlightCount -= p + 1;
+  memmove(inFlight, inFlight + p + 1, inFlightCount * sizeof(InFlight));
+  resendDue = false;
+
+  if (lastPaceSlot >= 0 && lastPaceSlot < p && machinePace != paceParam)
+  {
+    fallBackToStopAndWait("pipelined pace not taken");
+    lastPace = 0;
+    setPace(paceParam);
   }
 }
 
 /* ------------ high-level opcodes ------------------------------- */
-void setDuration(uint16_t s) { queuePkt(0x25, s); }
-
-void setPace(uint16_t p)
+void Machine::setPace(uint16_t p)
 {
-  static uint16_t lastpace = 0;
-  if (lastpace != p)
-    queuePkt(0x24, p);
-  lastpace = p;
+  if (lastPace != p)
+    queuePkt(0x24, p, true);
+  lastPace = p;
 }
-void sendStart() { queuePkt(0x1F); }
-void sendStop() { queuePkt(0x21); }
 
-void motorStart()
+void Machine::motorStart()
 {
   if (!motorOn)
   {
@@ -131,7 +490,7 @@ void motorStart()
     motorOn = true;
   }
 }
-void motorStop()
+void Machine::motorStop()
 {
   if (motorOn)
   {
@@ -140,42 +499,232 @@ void motorStop()
   }
 }
 
-/* ------------ raw packet emitter ------------------------------- */
-static void sendPkt()
+/* ------------ ramp model & lookahead ---------------------------- */
+// Fed with every status packet from the protocol task
+void Machine::learnRamp(const SwimMachine::Telemetry &t, int64_t nowUs)
 {
-  if (nextmessagetosend == nextmessage)
-    return;
+  if (t.curSpeed && t.curSpeed == t.tgtSpeed && t.pace100s)
+  {
+    uint32_t k = (uint32_t)t.curSpeed * t.pace100s;
+    ramp.speedPaceK = ramp.speedPaceK ? (ramp.speedPaceK * 7 + k) / 8 : k;
+  }
 
-  // do not send message when machine's last received command indicates turning off or slowing down
-  if (lastReceivedCommand == 0x4E ||
-      lastReceivedCommand == 0x0E ||
-      lastReceivedCommand == 0x4A ||
-      lastReceivedCommand == 0x0A)
+  if (!ramp.ramping)
+  {
+    if (t.curSpeed != t.tgtSpeed)
+    {
+      ramp.ramping = true;
+      ramp.from = t.curSpeed;
+      ramp.to = t.tgtSpeed;
+      ramp.startUs = nowUs;
+    }
     return;
-
-  // Only send if ready or if a resend is required
-  if (!readyToSendNext && !resendLastPacket)
+  }
+  if (t.tgtSpeed != ramp.to)
+  { // retargeted mid-ramp: measure from here
+    ramp.from = t.curSpeed;
+    ramp.to = t.tgtSpeed;
+    ramp.startUs = nowUs;
+    return;
+  }
+  if (t.curSpeed != t.tgtSpeed)
     return;
 
-  uint16_t command = *nextmessagetosend;
-  uint16_t param = *(nextmessagetosend + 1);
+  ramp.ramping = false;
+  int delta = (int)ramp.to - (int)ramp.from;
+  uint32_t perUnit = (uint32_t)((nowUs - ramp.startUs) / 1000) / (uint32_t)(delta < 0 ? -delta : delta > 0 ? delta : 1);
+  if (delta >= RAMP_MIN_DELTA)
+    ramp.upMsPerUnit = ewma(ramp.upMsPerUnit, perUnit);
+  else if (delta <= -RAMP_MIN_DELTA)
+    ramp.downMsPerUnit = ewma(ramp.downMsPerUnit, perUnit);
 
-  uint8_t idx2;
-  if (resendLastPacket)
+  if (ramp.boundaryPending)
   {
-    // For resend, use the last sent idx2
-    idx2 = lastSentIdx2;
+    ramp.boundaryPending = false;
+    stats.boundaryErrLastMs = (int32_t)((nowUs - ramp.boundaryUs) / 1000);
+    uint32_t a = stats.boundaryErrLastMs < 0 ? -stats.boundaryErrLastMs : stats.boundaryErrLastMs;
+    if (a > stats.boundaryErrMaxAbsMs)
+      stats.boundaryErrMaxAbsMs = a;
+    if (reportIdx >= 0 && reportIdx < (int32_t)report.size())
+      report[reportIdx].atSpeedMs = (int32_t)((nowUs - workoutStartUs) / 1000);
+  }
+}
+
+uint8_t Machine::speedForPace(uint16_t pace100s) const
+{
+  if (!pace100s || !ramp.speedPaceK)
+    return 0;
+  uint32_t v = ramp.speedPaceK / pace100s;
+  return v > 255 ? 255 : (uint8_t)v;
+}
+
+// Time a command takes to reach the machine: about half the smoothed round
+// trip, since the echo that closes it waits for the next status packet
+uint32_t Machine::transitUs() const
+{
+  return srttUs < 0 ? 0 : srttUs / 2;
+}
+
+// Lead time needed to go from one pace into another (0: standing still,
+// resting or end of workout)
+uint32_t Machine::leadMs(uint16_t p0, uint16_t p1) const
+{
+  if (p0 == p1)
+    return 0;
+
+  int delta = (int)speedForPace(p1) - (int)speedForPace(p0);
+  uint16_t perUnit = delta >= 0 ? ramp.upMsPerUnit : ramp.downMsPerUnit;
+  if (!ramp.speedPaceK || !perUnit)
+    return LEAD_DEFAULT_MS;
+
+  uint32_t ms = transitUs() / 1000 + (uint32_t)(delta < 0 ? -delta : delta) * perUnit;
+  return ms > LEAD_MAX_MS ? LEAD_MAX_MS : ms;
+}
+
+// Report entry of segment i (i == steps: the final stop), -1 if past the cap
+int32_t Machine::reportSlot(int32_t i) const
+{
+  if (report.empty() || i < 0)
+    return -1;
+  if (i == (int32_t)steps)
+    return (int32_t)report.size() - 1;
+  return i < (int32_t)report.size() - 1 ? i : -1;
+}
+
+// Send the commands that make the step at c happen (c.done: finish)
+void Machine::issueSegment(const WorkoutProgram::Cursor &c, uint16_t fromPace, int64_t boundaryUs)
+{
+  if (c.done || c.pace100s == 0)
+  { // rest or end
+    motorStop();
+    // set future pace for faster transition
+    WorkoutProgram::Cursor n = c;
+    WorkoutProgram::next(workout, n);
+    if (!n.done && n.pace100s)
+      setPace(adjusted(n.pace100s));
   }
   else
   {
-    // For new packet, increment idx2Counter and wrap in [0x64, 0xC6]
-    idx2Counter++;
-    if (idx2Counter > 0xC6)
-      idx2Counter = 0x64;
-    if (idx2Counter < 0x64)
-      idx2Counter = 0x64;
-    idx2 = idx2Counter;
+    setPace(adjusted(c.pace100s));
+    motorStart();
+  }
+  ramp.boundaryUs = boundaryUs;
+  ramp.boundaryPending = true;
+  stats.leadLastMs = leadMs(fromPace, c.done ? 0 : c.pace100s);
+  reportIdx = reportSlot(c.index);
+  if (reportIdx >= 0)
+  {
+    report[reportIdx].plannedMs = (uint32_t)((boundaryUs - workoutStartUs) / 1000);
+    report[reportIdx].issuedMs = (uint32_t)((SwimClock::micros64() - workoutStartUs) / 1000);
+  }
+}
+
+// Pace the current step calls for at nowUs (workout clock)
+uint16_t Machine::plannedPace(int64_t nowUs) const
+{
+  int64_t el = nowUs - sim.segStartUs;
+  return adjusted(WorkoutProgram::paceAt(cur, el < 0 ? 0 : (uint32_t)(el / 1000)));
+}
+
+// A planned swim pace with the swimmer's offset applied (rests stay 0)
+uint16_t Machine::adjusted(uint16_t p) const
+{
+  if (!p)
+    return 0;
+  int32_t v = (int32_t)p + paceOffset;
+  return v < 1 ? 1 : v > 0xFFFF ? 0xFFFF : (uint16_t)v;
+}
+
+// Faster/slower for the rest of the workout; takes effect on the step the
+// machine is on now (or the one already sent ahead of its boundary)
+void Machine::setPaceOffset(int16_t offset)
+{
+  paceOffset = offset;
+  if (!sim.active || sim.paused)
+    return;
+  if (sim.nextIssued)
+  {
+    WorkoutProgram::Cursor n = cur;
+    WorkoutProgram::next(workout, n);
+    if (!n.done && n.pace100s)
+      setPace(adjusted(n.pace100s));
+  }
+  else if (cur.pace100s)
+    setPace(plannedPace(SwimClock::micros64()));
+}
+
+bool Machine::commandQueued(uint8_t opcode) const
+{
+  for (size_t i = 0; i < txQueue.size(); ++i)
+    if (txQueue.at(i).opcode == opcode)
+      return true;
+  return false;
+}
+
+void Machine::streamRampPace(int64_t nowUs)
+{
+  uint32_t intervalUs = rtoUs > RAMP_STREAM_MIN_MS * 1000UL ? rtoUs : RAMP_STREAM_MIN_MS * 1000UL;
+  stats.rampStreamIntervalMs = intervalUs / 1000;
+  if (micros() - paceStreamUs < intervalUs || commandQueued(0x24))
+    return; // previous pace still unacknowledged: wait, then jump
+  // aim at when the command lands (warped like the workout clock)
+  int64_t aheadUs = (int64_t)transitUs() * SwimClock::warp();
+  uint16_t p = plannedPace(nowUs + aheadUs);
+  if (p == lastPace)
+    return;
+  uint16_t jump = p > lastPace ? p - lastPace : lastPace - p;
+  if (lastPace && jump > 1)
+    stats.rampPaceSkipped += jump - 1;
+  stats.rampPaceSent++;
+  setPace(p);
+  paceStreamUs = micros();
+}
+
+// Commands that survive a pause or stop: a duration (the workout resumes
+// with it) and stops. Paces and starts are obsolete once the motor stops.
+static bool keptByStop(uint8_t opcode)
+{
+  return opcode != 0x24 && opcode != 0x1F;
+}
+
+// Fast path for stop/pause from the web handlers: the stop goes in front of
+// every pending command (and the one awaiting its ack) and is sent right
+// here, from the caller's task, instead of waiting for the protocol task.
+void Machine::urgentStop(uint32_t requestUs)
+{
+  lastPace = 0; // a pending pace may be discarded; do not dedupe against it
+  if (!motorOn)
+  {
+    txQueue.dropPending(inFlightCount, keptByStop);
+    return;
   }
+  motorOn = false;
+  txQueue.preempt(0x21, 0, keptByStop);
+  inFlightCount = 0;
+  resendDue = false;
+  urgentPending = true;
+  urgentRequestUs = requestUs;
+  sendPkt();
+}
+
+/* ------------ raw packet emitter ------------------------------- */
+uint8_t Machine::nextIdx2()
+{
+  // increment idx2Counter and wrap in [0x64, 0xC6]
+  idx2Counter++;
+  if (idx2Counter > 0xC6)
+    idx2Counter = 0x64;
+  if (idx2Counter < 0x64)
+    idx2Counter = 0x64;
+  return idx2Counter;
+}
+
+// Put txQueue.at(slot) on the wire with idx2 inFlight[slot].idx2
+void Machine::transmit(uint8_t slot, bool resend)
+{
+  InFlight &f = inFlight[slot];
+  uint8_t command = txQueue.at(slot).opcode;
+  uint16_t param = txQueue.at(slot).param;
 
   // Prepare packet
   uint8_t b[44];
@@ -184,204 +733,648 @@ static void sendPkt()
   b[1] = 0xF0;
   b[36] = 0x97; // footer
   b[37] = 0x01;
-  b[2] = idx2;
+  b[2] = f.idx2;
   b[3] = command & 0xFF;
   b[4] = param & 0xFF;
   b[5] = param >> 8;
   uint32_t t = monoTick();
   memcpy(b + 32, &t, 4);
-  uint32_t c = crc32(b, 40);
+  uint32_t c = Crc32::compute(b, 40);
   memcpy(b + 40, &c, 4);
 
-  // Send via UDPEventSender (control socket)
-  (void)ctrl.sendBytes(b, sizeof b);
+  // Send via UDPEventSender (shared control socket)
+  IPAddress dst = target();
+  (void)ctrl.sendBytesTo(dst, PEER_PORT, b, sizeof b);
+  PacketCapture::record(PacketCapture::Tx, localAddr(), CTRL_LOCAL_PORT, dst, PEER_PORT, b, sizeof b);
 
   if (push_network_event_func)
     push_network_event_func(b, sizeof b);
 
   // Update state
-  lastSentIdx2 = idx2;
-  readyToSendNext = false;
-  resendLastPacket = false;
+  SwimMachine::CommandStats *cs = commandStats(command);
+  SwimMachine::SegmentReport *sr =
+      (reportIdx >= 0 && reportIdx < (int32_t)report.size()) ? &report[reportIdx] : nullptr;
+  f.lastTxUs = micros();
+  if (resend)
+  {
+    f.retries++;
+    stats.retransmits++;
+    rtoUs = clampRto(rtoUs * 2); // back off until a clean sample arrives
+    if (cs)
+      cs->retransmits++;
+    if (sr)
+      sr->retransmits++;
+  }
+  else
+  {
+    f.firstSentUs = f.lastTxUs;
+    f.retries = 0;
+    if (cs)
+      cs->sent++;
+    if (sr)
+      sr->commands++;
+    if (urgentPending)
+    {
+      urgentPending = false;
+      stats.urgentCount++;
+      stats.urgentLastUs = f.lastTxUs - urgentRequestUs;
+      if (stats.urgentLastUs > stats.urgentMaxUs)
+        stats.urgentMaxUs = stats.urgentLastUs;
+    }
+  }
 }
 
-/* =================================================================
- *                    P U B L I C   A P I
- * ================================================================= */
-void SwimMachine::begin()
+void Machine::sendPkt()
 {
+  if (txQueue.empty())
+    return;
 
+  // do not send message when machine's last received command indicates turning off or slowing down
+  // (a fast-path stop goes anyway)
+  if (!urgentPending &&
+      (lastReceivedCommand == 0x4E ||
+       lastReceivedCommand == 0x0E ||
+       lastReceivedCommand == 0x4A ||
+       lastReceivedCommand == 0x0A))
+    return;
 
-  // Join multicast group to receive status/acks
-  mcast.onReceive([](const uint8_t *data, size_t len, const IPAddress &remote, uint16_t rport) {
-    // Process only expected 111-byte packets
-    if (len == 111)
-    {
-      confirmPacket(data[2], data[3]);
+  // Selective resend: only the oldest unacknowledged command; an echo of it
+  // also covers whatever followed it
+  if (resendDue)
+  {
+    resendDue = false;
+    transmit(0, true);
+    if (window > 1 && ++windowTimeouts >= 2)
+      fallBackToStopAndWait("timeouts while pipelining");
+    return;
+  }
 
-      if (push_network_event_func)
-        push_network_event_func(data, len);
+  // New commands, as far as the window allows
+  while (inFlightCount < window && inFlightCount < txQueue.size())
+  {
+    inFlight[inFlightCount].idx2 = nextIdx2();
+    transmit(inFlightCount, false);
+    inFlightCount++;
+    if (inFlightCount > stats.inFlightMax)
+      stats.inFlightMax = inFlightCount;
+  }
+}
 
-      if (!machineFound)
-      {
-        lastSentIdx2 = data[2] + 1;
-        Serial.printf("Swim machine found at IP: %s\n", remote.toString().c_str());
-        machineFound = true;
-      }
-    }
-  });
+void Machine::checkLink()
+{
+  if (!found || millis() - lastHeardMs < LINK_TIMEOUT_MS)
+    return;
+  Serial.printf("Swim machine %s silent for %u ms, rediscovering\n",
+                ip.toString().c_str(), (unsigned)(millis() - lastHeardMs));
+  found = false;
+}
 
-  // Initialize sockets (rebinding handled by connection changes)
-  mcast.begin(multicastAddr, multicastPort, 45654); // bind to group port
-  ctrl.begin(peer_ip, PEER_PORT, 40000);            // distinct local port to avoid conflict
+void Machine::onStatus(const MachineTelemetry &pkt, const IPAddress &remote)
+{
+  if (claimed && !peerPinned && ip != remote)
+    forget(); // another machine takes over this idle slot
+  stats.rxPackets++;
+  confirmPacket(pkt.msgId(), pkt.state(), pkt.pace100s());
+
+  SwimMachine::Telemetry t;
+  t.valid = true;
+  t.state = pkt.state();
+  t.curSpeed = pkt.currentSpeed();
+  t.tgtSpeed = pkt.targetSpeed();
+  t.pace100s = pkt.pace100s();
+  t.remainingSec = pkt.remainingSec();
+  t.runtimeSec = pkt.runtimeSec();
+  t.totalRuntimeSec = pkt.totalRuntimeSec();
+  int64_t nowUs = SwimClock::micros64();
+  t.receivedMs = (uint32_t)(nowUs / 1000);
+  telemetry.store(t);
+  learnRamp(t, nowUs);
+  if (motorWait && t.curSpeed > 0)
+  {
+    motorWait = false;
+    stats.timeToMotorLastMs = (micros() - motorWaitUs) / 1000;
+  }
+
+  lastHeardMs = millis();
+  if (!found)
+  {
+    // continue the machine's sequence so a stale echo cannot ack a new command
+    if (!inFlightCount)
+      idx2Counter = pkt.msgId();
+    Serial.printf("Swim machine found at IP: %s\n", remote.toString().c_str());
+    found = true;
+    everFound = true;
+  }
+  if (!peerPinned && (!claimed || ip != remote))
+  {
+    Serial.printf("Swim machine: sending commands unicast to %s\n", remote.toString().c_str());
+    ip = remote;
+  }
+  claimed = true;
 }
 
-/* Set network event callback */
-void SwimMachine::setPushNetworkEvent(void (*push_network_event)(const uint8_t *data, size_t len))
+// Drop what was learned about the previous machine in this slot: commands
+// still queued for it, its round trip and ramp model
+void Machine::forget()
 {
-  push_network_event_func = push_network_event;
+  txQueue.dropPending(0);
+  inFlightCount = 0;
+  resendDue = false;
+  urgentPending = false;
+  motorOn = false;
+  lastPace = 0;
+  srttUs = -1;
+  rttvarUs = 0;
+  rtoUs = RTO_INITIAL_MS * 1000UL;
+  ramp = {};
 }
 
-/* deep-copy caller’s data so it can go out of scope */
-void SwimMachine::loadWorkout(const std::vector<SwimMachine::Segment> &segs)
+/* ------------ playback ------------------------------------------ */
+// Swimming time of the loaded workout (what the machine's duration covers);
+// also counts its steps
+uint32_t Machine::activeSec()
 {
-  workout.clear();
-  workout.insert(workout.end(), segs.begin(), segs.end()); // append the rest
+  uint32_t tot = 0; // 32 bit: a long workout must not wrap past the limit
+  WorkoutProgram::totals(workout, steps, tot);
+  return tot;
+}
+
+// The pace the first issueSegment() sets: the first step's, or the next one's after a rest
+uint16_t Machine::firstPace() const
+{
+  WorkoutProgram::Cursor c = WorkoutProgram::first(workout);
+  if (!c.done && !c.pace100s)
+    WorkoutProgram::next(workout, c);
+  return c.done ? 0 : c.pace100s;
+}
+
+// Whether arm() would stage program p now: not while the machine is
+// running, whether by us or from the pool side, and not an empty or too
+// long workout
+bool Machine::canArm(const WorkoutProgram::Program &p) const
+{
+  if (sim.active)
+    return false;
+  SwimMachine::Telemetry t = telemetry.load();
+  if (t.valid && t.curSpeed > 0)
+    return false; // running under pool-side control: staging would change its speed
+  uint32_t n = 0, tot = 0;
+  WorkoutProgram::totals(p, n, tot);
+  return n && tot <= 90 * 60 - 10;
+}
+
+void Machine::load(const WorkoutProgram::Program &p)
+{
+  workout = p; // the program, not the expanded steps
+  steps = 0;
   sim.idx = -1;
   sim.active = false;
   sim.paused = false;
+  armed = false;
 }
 
-/* --------------------------------------------------------------- */
-bool SwimMachine::start()
+// Stage the machine for start(): duration and first pace go out now, so
+// start() only has to send the start command.
+bool Machine::arm()
+{
+  if (!canArm(workout))
+    return false;
+  uint32_t tot = activeSec();
+  setDuration(tot + 10);
+  armedPace = firstPace();
+  if (armedPace)
+  {
+    lastPace = 0; // send it even if the machine had it before
+    setPace(armedPace);
+  }
+  armed = true;
+  return true;
+}
+
+bool Machine::start()
 {
-  if (workout.empty())
+  uint32_t tot = activeSec();
+  if (!steps)
   {
     return false;
   }
 
-  /* send TOTAL ACTIVE duration once */
-  uint16_t tot = 0;
-  for (auto &s : workout)
-    if (s.pace100s)
-      tot += s.durSec;
+  // armed: trust the staged values unless the machine reports another pace
+  // (rebooted, or changed at the pool side since)
+  SwimMachine::Telemetry t = telemetry.load();
+  if (armed && t.valid && armedPace && t.pace100s != armedPace)
+  {
+    armed = false;
+    lastPace = 0;
+  }
 
-  if (tot > 90 * 60 - 10)
+  /* send TOTAL ACTIVE duration once */
+  if (!armed)
   {
-    return false; // too long workout.
+    if (tot > 90 * 60 - 10)
+    {
+      return false; // too long workout.
+    }
+    setDuration(tot + 10);
   }
-  setDuration(tot + 10);
+  armed = false;
 
-  sim.idx = -1; // will advance on first tick()
-  sim.segStart = millis();
+  // the first segment starts once the water has had time to get going
+  int64_t now = SwimClock::micros64();
+  workoutStartUs = now;
+  report.assign((steps < REPORT_MAX_STEPS ? steps : REPORT_MAX_STEPS) + 1, SwimMachine::SegmentReport{0, 0, -1, 0, 0});
+  reportIdx = -1;
+  paceOffset = 0;
+  cur = WorkoutProgram::first(workout);
+  sim.idx = cur.index;
+  sim.segStartUs = now + (int64_t)leadMs(0, cur.pace100s) * 1000;
+  sim.pausedTotalUs = 0;
   sim.active = true;
   sim.paused = false;
+  sim.nextIssued = false;
+  issueSegment(cur, 0, sim.segStartUs);
+  motorWait = cur.pace100s != 0;
+  motorWaitUs = micros();
   return true;
 }
 
 /* toggle pause */
-void SwimMachine::pause()
+void Machine::pause(uint32_t requestUs)
 {
   if (!sim.active)
     return;
   sim.paused = !sim.paused;
   if (sim.paused)
   {
-    motorStop();
-    /* pause: keep elapsed time intact */
-    sim.segStart = millis() - sim.segStart;
+    urgentStop(requestUs);
+    sim.pausedAtUs = SwimClock::micros64();
   }
   else
   {
-    /* resume: keep elapsed time intact */
-    sim.segStart = millis() - sim.segStart;
-    if (workout[sim.idx].pace100s)
+    /* resume: the segment (and every later boundary) moves by the pause */
+    int64_t pausedUs = SwimClock::micros64() - sim.pausedAtUs;
+    sim.segStartUs += pausedUs;
+    sim.pausedTotalUs += pausedUs;
+    // undo anything sent early for the next segment; re-armed by tick()
+    sim.nextIssued = false;
+    if (cur.pace100s)
+    {
+      setPace(plannedPace(SwimClock::micros64()));
       motorStart();
+    }
   }
 }
 
-/* force stop */
-void SwimMachine::stop()
+/* end of workout */
+void Machine::stop()
 {
+  armed = false;
   sim.active = false;
   sim.paused = false;
   sim.idx = -1;
   motorStop();
 }
 
-/* --------------------------------------------------------------- */
-void SwimMachine::tick()
+/* force stop (user request) */
+void Machine::abort(uint32_t requestUs)
 {
-  static uint32_t prev =0;
-  uint32_t now = millis();
-  if(now > 250 && now<prev+250)
-    return;
-  prev = now;
-
-  // Process UDP (receives multicast acks and keeps sockets rebound)
-  mcast.loop();
-  ctrl.loop();
-
-  // Attempt send if ready
-  sendPkt();
+  armed = false;
+  sim.active = false;
+  sim.paused = false;
+  sim.idx = -1;
+  urgentStop(requestUs);
+}
 
+void Machine::tick()
+{
   if (!sim.active || sim.paused)
     return;
 
+  int64_t now = SwimClock::micros64();
+  int64_t segEnd = sim.segStartUs + (int64_t)cur.durSec * 1000000;
+  WorkoutProgram::Cursor nxt = cur;
+  WorkoutProgram::next(workout, nxt);
+  uint16_t nxtPace = nxt.done ? 0 : nxt.pace100s;
+  uint16_t endPace = cur.paceEnd100s ? cur.paceEnd100s : cur.pace100s;
+
+  /* ramp step: follow the planned pace until the next step takes over */
+  if (cur.paceEnd100s && !sim.nextIssued && now >= sim.segStartUs)
+    streamRampPace(now);
 
-  /* start next segment if idx == -1 OR segment finished */
-  if (sim.idx == -1 ||
-      now - sim.segStart >= workout[sim.idx].durSec * 1000UL)
+  /* send the next segment's commands early enough to meet the boundary */
+  if (!sim.nextIssued)
   {
-    sim.idx++;
-    if (sim.idx >= (int)workout.size())
+    int64_t lead = (int64_t)leadMs(endPace, nxtPace) * 1000;
+    int64_t maxLead = (int64_t)cur.durSec * 500000; // never more than half the segment
+    if (lead > maxLead)
+      lead = maxLead;
+    if (now + lead >= segEnd)
+    {
+      issueSegment(nxt, endPace, segEnd);
+      sim.nextIssued = true;
+    }
+  }
+
+  /* advance on the planned boundary */
+  if (now >= segEnd)
+  {
+    uint16_t fromPace = endPace;
+    cur = nxt;
+    sim.idx = cur.index;
+    sim.segStartUs = segEnd;
+    if (cur.done)
     {
       stop();
       return;
     }
+    if (!sim.nextIssued)
+      issueSegment(cur, fromPace, segEnd);
+    sim.nextIssued = false;
+  }
+}
 
-    Segment s = workout[sim.idx];
-    sim.segStart = now;
-
-    if (s.pace100s == 0)
-    { // rest
-      motorStop();
-      // set future pace for faster transition
-      if (sim.idx + 1 < (int)workout.size() && workout[sim.idx + 1].pace100s)
-      {
-        setPace(workout[sim.idx + 1].pace100s);
-      }
-    }
-    else
+/* ------------ protocol task ------------------------------------- */
+static void protocolTask(void *)
+{
+  for (;;)
+  {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PROTOCOL_POLL_MS));
+    ProtocolGuard g;
+
+    // Process UDP (receives multicast acks and keeps sockets rebound)
+    mcast.loop();
+    ctrl.loop();
+
+    for (auto &m : machines)
     {
-      setPace(s.pace100s);
-      motorStart();
+      if (!m.claimed)
+        continue;
+      m.checkLink();
+      // Attempt send if ready (or if the in-flight command timed out)
+      m.checkRetransmit();
+      m.sendPkt();
     }
+
+    // Segment timing
+    SwimMachine::tick();
   }
 }
 
+static Machine &machineAt(size_t m)
+{
+  return machines[m < SwimMachine::kMaxMachines ? m : 0];
+}
+
+/* =================================================================
+ *                    P U B L I C   A P I
+ * ================================================================= */
+void SwimMachine::begin()
+{
+  PacketCapture::begin();
+
+  // Join multicast group to receive status/acks from every machine
+  mcast.onReceive([](const uint8_t *data, size_t len, const IPAddress &remote, uint16_t rport) {
+    // capture before validation, malformed packets are the interesting ones
+    PacketCapture::record(PacketCapture::Rx, remote, rport, multicastAddr, multicastPort, data, len);
+    // Process only well-formed 111-byte status packets
+    if (!statusPacketValid(data, len))
+      return;
+    Machine *m = machineFor(remote);
+    if (!m)
+    {
+      rxStats.noSlot++;
+      return;
+    }
+    m->onStatus(MachineTelemetry(data), remote);
+
+    if (push_network_event_func)
+      push_network_event_func(data, len);
+  });
+
+  // Initialize sockets (rebinding handled by connection changes)
+  mcast.begin(multicastAddr, multicastPort, 45654); // bind to group port
+  ctrl.begin(broadcastAddr, PEER_PORT, CTRL_LOCAL_PORT); // distinct local port to avoid conflict
+
+  xTaskCreatePinnedToCore(protocolTask, "swimproto", PROTOCOL_TASK_STACK, nullptr,
+                          PROTOCOL_TASK_PRIO, &protocolTaskHandle, PROTOCOL_TASK_CORE);
+}
+
+/* Set network event callback */
+void SwimMachine::setPushNetworkEvent(void (*push_network_event)(const uint8_t *data, size_t len))
+{
+  push_network_event_func = push_network_event;
+}
+
+/* deep-copy caller’s data so it can go out of scope */
+void SwimMachine::loadWorkout(const std::vector<SwimMachine::Segment> &segs, size_t m)
+{
+  ProtocolGuard g;
+  machineAt(m).load(segs);
+}
+
+bool SwimMachine::arm(size_t m)
+{
+  ProtocolGuard g;
+  return machineAt(m).arm();
+}
+
+bool SwimMachine::arm(const std::vector<SwimMachine::Segment> &segs, size_t m)
+{
+  ProtocolGuard g;
+  Machine &mc = machineAt(m);
+  if (!mc.canArm(segs))
+    return false; // the loaded program stays
+  mc.load(segs);
+  return mc.arm();
+}
+
+bool SwimMachine::isArmed(size_t m)
+{
+  ProtocolGuard g;
+  return machineAt(m).armed;
+}
+
 /* --------------------------------------------------------------- */
+bool SwimMachine::start(size_t m)
+{
+  ProtocolGuard g;
+  return machineAt(m).start();
+}
 
-SwimMachine::SwimStatus SwimMachine::getStatus()
+void SwimMachine::pause(size_t m)
 {
+  uint32_t t0 = micros(); // latency includes waiting for the protocol lock
+  ProtocolGuard g;
+  machineAt(m).pause(t0);
+}
+
+void SwimMachine::setPaused(bool paused, size_t m)
+{
+  uint32_t t0 = micros();
+  ProtocolGuard g;
+  Machine &mc = machineAt(m);
+  if (mc.sim.active && mc.sim.paused != paused)
+    mc.pause(t0);
+}
+
+void SwimMachine::setPaceOffset(int16_t offset, size_t m)
+{
+  ProtocolGuard g;
+  machineAt(m).setPaceOffset(offset);
+}
+
+void SwimMachine::stop(size_t m)
+{
+  uint32_t t0 = micros();
+  ProtocolGuard g;
+  machineAt(m).abort(t0);
+}
+
+/* --------------------------------------------------------------- */
+void SwimMachine::tick()
+{
+  ProtocolGuard g;
+  for (auto &m : machines)
+    m.tick();
+}
+
+/* --------------------------------------------------------------- */
+
+size_t SwimMachine::machineCount()
+{
+  ProtocolGuard g;
+  size_t n = 0;
+  for (size_t i = 0; i < kMaxMachines; ++i)
+    if (machines[i].claimed)
+      n = i + 1;
+  return n ? n : 1; // slot 0 always exists
+}
+
+SwimMachine::SwimStatus SwimMachine::getStatus(size_t m)
+{
+  ProtocolGuard g;
+  const Machine &mc = machineAt(m);
   SwimMachine::SwimStatus st;
-  st.active = sim.active;
-  st.found = machineFound;
-  st.paused = sim.paused;
-  st.idx = sim.idx;
-  const uint32_t lag = 1000;
-  st.elapsedMs = (sim.paused ? sim.segStart - lag : (millis() - sim.segStart - lag));
+  st.active = mc.sim.active;
+  st.found = mc.found;
+  st.everFound = mc.everFound;
+  st.linkAgeMs = mc.everFound ? millis() - mc.lastHeardMs : 0;
+  st.peer = mc.target();
+  st.paused = mc.sim.paused;
+  st.armed = mc.armed;
+  st.idx = mc.sim.idx;
+  st.at = mc.cur;
+  st.steps = mc.steps;
+  st.pace100s = mc.sim.active && mc.motorOn ? mc.lastPace : 0;
+  st.paceOffset = mc.paceOffset;
+  // segStartUs is the planned start, so no fixed lag; it lies ahead while
+  // the first segment ramps up
+  int64_t now = SwimClock::micros64();
+  int64_t el = (mc.sim.paused ? mc.sim.pausedAtUs : now) - mc.sim.segStartUs;
+  st.elapsedMs = el < 0 ? 0 : (uint32_t)(el / 1000);
+  int64_t pausedUs = mc.sim.pausedTotalUs + (mc.sim.paused ? now - mc.sim.pausedAtUs : 0);
+  int64_t workoutUs = mc.sim.active ? now - mc.workoutStartUs - pausedUs : 0;
+  st.workoutMs = workoutUs < 0 ? 0 : (uint32_t)(workoutUs / 1000);
+  st.pausedMs = (uint32_t)(pausedUs / 1000);
+  st.machine = mc.telemetry.load();
   return st;
 }
 
-bool SwimMachine::isMachineFound()
+SwimMachine::Telemetry SwimMachine::getTelemetry(size_t m)
+{
+  return machineAt(m).telemetry.load();
+}
+
+bool SwimMachine::motorRunning(size_t m)
+{
+  SwimMachine::Telemetry t = machineAt(m).telemetry.load();
+  return t.valid && t.curSpeed > 0;
+}
+
+SwimMachine::ProtocolStats SwimMachine::getProtocolStats(size_t m)
+{
+  ProtocolGuard g;
+  const Machine &mc = machineAt(m);
+  SwimMachine::ProtocolStats ps = mc.stats;
+  ps.rxBadLength = rxStats.badLength;
+  ps.rxBadCrc = rxStats.badCrc;
+  ps.rxNoSlot = rxStats.noSlot;
+  const UDPEventSender::Stats &us = mcast.stats();
+  ps.rxMaxBatch = us.maxBatch;
+  ps.rxBudgetHits = us.budgetHits;
+  ps.rxTruncated = us.truncated;
+  const CommandQueue::Stats &qs = mc.txQueue.stats();
+  ps.txQueued = mc.txQueue.size();
+  ps.txHighWater = qs.highWater;
+  ps.txCoalesced = qs.coalesced;
+  ps.txOverflows = qs.overflows;
+  ps.txPreempted = qs.preempted;
+  ps.sendWindow = mc.window;
+  ps.srttMs = mc.srttUs < 0 ? 0 : mc.srttUs / 1000;
+  ps.rttvarMs = mc.rttvarUs / 1000;
+  ps.rtoMs = mc.rtoUs / 1000;
+  ps.rampUpMsPerUnit = mc.ramp.upMsPerUnit;
+  ps.rampDownMsPerUnit = mc.ramp.downMsPerUnit;
+  ps.speedPaceK = mc.ramp.speedPaceK;
+  for (size_t i = 0; i < kTrackedCommands; ++i)
+    ps.commands[i].opcode = trackedOpcodes[i];
+  return ps;
+}
+
+std::vector<SwimMachine::SegmentReport> SwimMachine::getSegmentReport(size_t m)
+{
+  ProtocolGuard g;
+  return machineAt(m).report;
+}
+
+#ifdef SWIM_CLOCK_WARP
+void SwimMachine::setClockWarp(uint16_t factor)
+{
+  ProtocolGuard g;
+  SwimClock::setWarp(factor);
+}
+#endif
+
+void SwimMachine::setSendWindow(uint8_t n, size_t m)
+{
+  ProtocolGuard g;
+  Machine &mc = machineAt(m);
+  mc.window = n < 1 ? 1 : n > kMaxSendWindow ? kMaxSendWindow : n;
+  mc.windowTimeouts = 0;
+}
+
+void SwimMachine::bindMachine(IPAddress ip, size_t m)
+{
+  ProtocolGuard g;
+  if (m >= kMaxMachines || ip == IPAddress(0, 0, 0, 0))
+    return;
+  for (auto &mc : machines)
+    if (mc.claimed && mc.ip == ip)
+      return; // already has a slot
+  Machine &mc = machines[m];
+  if (mc.claimed)
+    return;
+  mc.ip = ip;
+  mc.claimed = true;
+}
+
+IPAddress SwimMachine::machineIP(size_t m)
+{
+  ProtocolGuard g;
+  const Machine &mc = machineAt(m);
+  return mc.claimed ? mc.ip : IPAddress(0, 0, 0, 0);
+}
+
+bool SwimMachine::isMachineFound(size_t m)
 {
-  return machineFound;
+  return machineAt(m).found;
 }
 
-void SwimMachine::setPeerIP(IPAddress ip)
+void SwimMachine::setPeerIP(IPAddress ip, size_t m)
 {
-  peer_ip = ip;
-  // Reconfigure control sender to new peer (keep distinct local port)
-  ctrl.begin(peer_ip, PEER_PORT, 40000);
+  ProtocolGuard g;
+  Machine &mc = machineAt(m);
+  mc.ip = ip;
+  mc.claimed = true;
+  mc.peerPinned = true;
 }
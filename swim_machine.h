@@ -1,38 +1,157 @@
 #pragma once
 #include <Arduino.h>
 #include <vector>
+#include "swim_clock.h"
+#include "workout_program.h"
 
 namespace SwimMachine
 {
+  // One controller can drive several pools. Each machine is identified by
+  // the source address of its status packets and gets its own slot (lane)
+  // with its own command queue, idx2 sequence and workout playback. The
+  // per-machine calls below take the slot index; 0 is the default pool.
+  constexpr size_t kMaxMachines = 4;
 
-  /* -------- one swim block --------------------------------------- */
-  struct Segment
+  /* -------- the workout: steps and repeat blocks ---------------- */
+  // pre-order program, see workout_program.h; played step by step with a
+  // WorkoutProgram::Cursor, never expanded
+  using Segment = WorkoutProgram::Node;
+
+  /* -------- what the machine reports (latest status packet) ------ */
+  struct Telemetry
   {
-    uint16_t pace100s; // seconds / 100 m; 0 = rest
-    uint16_t durSec;   // seconds
+    bool valid;             // false until the first status packet
+    uint8_t state;          // status code, see commands.csv
+    uint8_t curSpeed;
+    uint8_t tgtSpeed;
+    uint16_t pace100s;
+    uint16_t remainingSec;
+    float runtimeSec;
+    float totalRuntimeSec;
+    uint32_t receivedMs;    // SwimClock::millis() when the packet arrived
   };
 
   /* -------- status snapshot -------------------------------------- */
     struct SwimStatus
     {
       bool active;        // workout started & not finished
-      bool found;
+      bool found;         // machine heard within the link timeout
+      bool everFound;     // heard at least once since boot
+      uint32_t linkAgeMs; // ms since the last status packet
+      IPAddress peer;     // where commands go (broadcast until learned)
       bool paused;        // true while paused
-      int32_t idx;        // current segment, −1 = none
+      bool armed;         // arm()ed, start() sends only the start command
+      int32_t idx;        // current step of the expanded workout, −1 = none
+      WorkoutProgram::Cursor at; // where playback is in the program (valid while active)
+      uint32_t steps;     // steps the workout expands to
+      uint16_t pace100s;  // pace last commanded (follows a ramp step), 0 = motor off
+      int16_t paceOffset; // see setPaceOffset()
       uint32_t elapsedMs; // ms elapsed inside current segment
+      uint32_t workoutMs; // ms since start() without pauses
+      uint32_t pausedMs;  // ms spent paused since start()
+      Telemetry machine;  // latest machine-reported state
     };
 
+  /* -------- protocol counters ------------------------------------ */
+  // command-to-ack latency histogram: bucket i counts acks <= kAckHistBoundsMs[i],
+  // the last bucket everything slower
+  constexpr size_t kAckHistBuckets = 10;
+  constexpr uint32_t kAckHistBoundsMs[kAckHistBuckets - 1] = {2, 5, 10, 20, 50, 100, 250, 500, 1000};
+
+  // commands that may be on the wire at once (see setSendWindow)
+  constexpr uint8_t kMaxSendWindow = 4;
+
+  // per-opcode counters for the commands we send (start, stop, pace, duration)
+  constexpr size_t kTrackedCommands = 4;
+  struct CommandStats
+  {
+    uint8_t opcode;
+    uint32_t sent;        // first transmissions
+    uint32_t acked;
+    uint32_t retransmits;
+    uint32_t lastAckMs;   // first transmission to idx2 echo, incl. retransmits
+  };
+
+  struct ProtocolStats
+  {
+    uint32_t rxPackets;   // status packets accepted
+    uint32_t rxBadLength; // datagrams that are not 111 bytes
+    uint32_t rxBadCrc;    // 111-byte datagrams failing header/CRC check
+    uint32_t rxNoSlot;    // status packets from machines beyond kMaxMachines
+    uint32_t rxMaxBatch;  // most datagrams drained from the socket in one poll
+    uint32_t rxBudgetHits; // polls that hit the receive budget (socket backlog)
+    uint32_t rxTruncated; // oversized datagrams
+    uint32_t txQueued;    // commands waiting in the send queue (incl. in flight)
+    uint32_t txHighWater; // deepest the send queue has been
+    uint32_t txCoalesced; // pace/duration updates merged into a pending command
+    uint32_t txOverflows; // commands rejected by a full queue
+    uint32_t sendWindow;   // current window (drops to 1 when pipelining fails)
+    uint32_t windowFallbacks;
+    uint32_t inFlightMax;  // most commands on the wire at once
+    uint32_t timeToMotorLastMs; // start() to the first status packet with the motor turning
+    uint32_t txPreempted; // stops that jumped the queue (pending commands discarded)
+    uint32_t urgentCount;  // stop/pause requests sent on the fast path
+    uint32_t urgentLastUs; // stop()/pause() call to stop packet on the wire
+    uint32_t urgentMaxUs;
+    uint32_t ackCount;    // commands acknowledged (idx2 echoed)
+    uint32_t ackLastMs;   // latency of the most recent ack
+    uint32_t ackMaxMs;
+    uint32_t ackHist[kAckHistBuckets];
+    uint32_t srttMs;      // smoothed round-trip time (0 until the first sample)
+    uint32_t rttvarMs;
+    uint32_t rtoMs;       // current retransmission timeout (incl. backoff)
+    uint32_t retransmits;
+    CommandStats commands[kTrackedCommands];
+    uint16_t rampUpMsPerUnit;   // learned ramp time per speed unit (0 = not yet)
+    uint16_t rampDownMsPerUnit;
+    uint32_t speedPaceK;        // learned speed * pace100s
+    uint32_t rampPaceSent;      // pace commands streamed for ramp steps
+    uint32_t rampPaceSkipped;   // 1 s/100 m steps jumped over to keep up
+    uint32_t rampStreamIntervalMs; // current minimum spacing of streamed paces
+    uint32_t leadLastMs;        // how early the last segment change was sent
+    int32_t boundaryErrLastMs;  // water at speed minus planned boundary (+ = late)
+    uint32_t boundaryErrMaxAbsMs;
+  };
+
+  /* -------- per-segment timing of the current/last workout ------ */
+  // times in ms after start() on the workout clock (SwimClock); one entry
+  // per step (the first 64 of a long workout), then the final stop
+  struct SegmentReport
+  {
+    uint32_t plannedMs;   // planned boundary
+    uint32_t issuedMs;    // when its commands were queued (ahead by the lead)
+    int32_t atSpeedMs;    // machine reported the new speed, -1 = not seen
+    uint16_t commands;    // commands sent for it (first transmissions)
+    uint16_t retransmits;
+  };
+
   /* -------- public API ------------------------------------------- */
-  void begin(); // call in setup()
+  void begin(); // call in setup(); starts the protocol task
   void setPushNetworkEvent(void (*push_network_event)(const uint8_t *data, size_t len)); // set network event callback
-  void loadWorkout(const std::vector<Segment> &); // copy full list
-  bool start();                                   // begin playback
-  void pause();                                   // toggle pause/resume
-  void stop();                                    // abort workout
-  void tick();                                    // call in loop()
-  void setPeerIP(IPAddress ip);
-  bool isMachineFound();
-
-  SwimStatus getStatus(); // query live state
+  void loadWorkout(const std::vector<Segment> &, size_t m = 0); // copy the program
+  bool arm(size_t m = 0);                                     // pre-send duration and first pace (refused while the motor runs)
+  bool arm(const std::vector<Segment> &, size_t m = 0);      // load and arm at once; a refusal leaves the loaded program
+  bool isArmed(size_t m = 0);
+  bool start(size_t m = 0);                                   // begin playback (just the start command once armed)
+  void pause(size_t m = 0);                                   // toggle pause/resume; pausing stops the motor at once
+  void setPaused(bool paused, size_t m = 0);                  // pause/resume without toggling (repeat-safe)
+  void setPaceOffset(int16_t offset, size_t m = 0);           // s/100 m added to every swim pace until the next start()
+  void stop(size_t m = 0);                                    // abort workout; the stop goes out before returning
+  void tick();                                    // segment timing (all machines); driven by the protocol task
+  void setPeerIP(IPAddress ip, size_t m = 0); // pin the command target (disables peer learning)
+  void bindMachine(IPAddress ip, size_t m);   // reserve slot m for the machine at ip (restored lane map)
+  IPAddress machineIP(size_t m = 0);          // address slot m is bound to, 0.0.0.0 = free
+  void setSendWindow(uint8_t n, size_t m = 0); // 1 = stop-and-wait (default), up to kMaxSendWindow
+  bool isMachineFound(size_t m = 0);
+  size_t machineCount(); // slots in use (at least 1)
+
+  SwimStatus getStatus(size_t m = 0); // query live state
+  ProtocolStats getProtocolStats(size_t m = 0);
+  Telemetry getTelemetry(size_t m = 0); // lock-free; safe from any task
+  bool motorRunning(size_t m = 0);      // latest status packet shows the water moving; lock-free
+  std::vector<SegmentReport> getSegmentReport(size_t m = 0);
+#ifdef SWIM_CLOCK_WARP
+  void setClockWarp(uint16_t factor); // run workout timing factor x faster
+#endif
 
 } // namespace SwimMachine
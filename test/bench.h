@@ -0,0 +1,34 @@
+#pragma once
+#include <stdint.h>
+#include <chrono>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/* Timing for the host benchmarks. Host numbers only compare versions of
+   the same code; they say nothing absolute about the ESP32. */
+namespace bench
+{
+  inline uint64_t nowNs()
+  {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+  }
+
+  /** CPU cycle counter, 0 where there is none. */
+  inline uint64_t cycles()
+  {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+  }
+
+  /** Keep the compiler from dropping a computed value. */
+  template <typename T>
+  inline void keep(const T &v)
+  {
+    asm volatile("" : : "g"(v) : "memory");
+  }
+}
@@ -0,0 +1,114 @@
+#include "bench.h"
+#include "sim_machine.h"
+#include "swim_machine.h"
+#include <memory>
+
+// Protocol task cost with n simulated machines, each playing a workout on
+// its own lane (machines beyond kMaxMachines are heard but get no slot)
+static int scaling(size_t n)
+{
+  const uint32_t kMinutes = 30;
+  SwimMachine::begin();
+  std::vector<std::unique_ptr<SimMachine>> pools;
+  for (size_t i = 0; i < n; ++i)
+  {
+    SimMachine::Config c;
+    c.phaseMs = 1 + (uint32_t)(i * 250 / n); // spread over the status period
+    pools.emplace_back(new SimMachine(IPAddress(192, 168, 1, 50 + i), c));
+  }
+  SimMachine::run(2000);
+
+  size_t lanes = SwimMachine::machineCount();
+  std::vector<SwimMachine::Segment> w = {{0, 0, 10, 2, 0, 0}, {90, 30, 0, 0, 0, 0}, {110, 30, 0, 0, 0, 0}};
+  for (size_t m = 0; m < lanes; ++m)
+  {
+    SwimMachine::loadWorkout(w, m);
+    SwimMachine::start(m);
+    SimMachine::run(1000 / lanes); // staggered starts
+  }
+
+  uint64_t taskNs = 0, passes = 0;
+  for (uint32_t ms = 0; ms < kMinutes * 60000; ++ms)
+  {
+    host::advanceUs(1000);
+    SimMachine::pollAll();
+    if ((host::nowUs() / 1000) % 5)
+      continue;
+    uint64_t t0 = bench::nowNs();
+    host::runTasks();
+    taskNs += bench::nowNs() - t0;
+    passes++;
+  }
+
+  uint32_t rx = 0, acks = 0, retransmits = 0;
+  for (size_t m = 0; m < lanes; ++m)
+  {
+    SwimMachine::ProtocolStats ps = SwimMachine::getProtocolStats(m);
+    rx += ps.rxPackets;
+    acks += ps.ackCount;
+    retransmits += ps.retransmits;
+  }
+  uint32_t noSlot = SwimMachine::getProtocolStats(0).rxNoSlot;
+  printf("%8zu %6zu %10.0f %14.1f %10u %8u %6u %8u\n", n, lanes, (double)taskNs / passes,
+         (double)taskNs / 1000 / (kMinutes * 60), (unsigned)rx, (unsigned)noSlot, (unsigned)acks, (unsigned)retransmits);
+  return 0;
+}
+
+// Cost of one status packet on the shared socket with status packets
+// from `sources` machines: a full receive batch per pass, minus the cost
+// of an empty pass
+static int perPacket(size_t sources)
+{
+  const int kPasses = 20000;
+  SwimMachine::begin();
+  std::vector<std::unique_ptr<SimMachine>> pools;
+  for (size_t i = 0; i < sources; ++i)
+  {
+    pools.emplace_back(new SimMachine(IPAddress(192, 168, 1, 50 + i)));
+    pools.back()->setOnline(false); // packets are injected below
+  }
+  auto inject = [&](size_t i) {
+    const SimMachine &p = *pools[i % sources];
+    hostnet::inject({p.ip(), 45654, IPAddress(239, 255, 0, 1), 45654, p.statusPacket()});
+  };
+  for (size_t i = 0; i < sources; ++i)
+  { // claim the slots
+    inject(i);
+    host::runTasks();
+  }
+
+  uint64_t emptyNs = 0, fullNs = 0;
+  size_t next = 0;
+  for (int r = 0; r < kPasses; ++r)
+  {
+    host::advanceUs(5000);
+    uint64_t t0 = bench::nowNs();
+    host::runTasks();
+    emptyNs += bench::nowNs() - t0;
+
+    host::advanceUs(5000);
+    for (int k = 0; k < 16; ++k)
+      inject(next++);
+    t0 = bench::nowNs();
+    host::runTasks();
+    fullNs += bench::nowNs() - t0;
+  }
+  printf("%8zu %12.0f\n", sources, (double)(fullNs - emptyNs) / (16.0 * kPasses));
+  return 0;
+}
+
+int main()
+{
+  printf("protocol task, 30 simulated minutes, 5 ms poll:\n");
+  printf("%8s %6s %10s %14s %10s %8s %6s %8s\n", "machines", "lanes", "ns/pass", "us CPU per s", "status rx", "no slot", "acks", "resends");
+  const size_t counts[] = {0, 1, 2, 3, 4, 8}; // 0: the bare pass and task switch
+  for (size_t n : counts)
+    host::isolated([n] { return scaling(n); });
+
+  printf("\nstatus packet on the shared socket (16 per pass):\n");
+  printf("%8s %12s\n", "sources", "ns/packet");
+  const size_t sources[] = {1, 2, 4, 8};
+  for (size_t n : sources)
+    host::isolated([n] { return perPacket(n); });
+  return 0;
+}
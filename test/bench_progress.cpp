@@ -0,0 +1,263 @@
+#include "progress_json.h"
+#include "progress_key.h"
+#include "sim_machine.h"
+#include "workout_storage.h"
+#include <ArduinoJson.h>
+#include <new>
+#include <sys/mman.h>
+
+// "progress" events per minute from the WorkoutManager's 250 ms tick, by
+// what the lane is doing, against the simulated machine, and what building
+// them costs: bytes of JSON and heap allocations per minute. The status
+// event this replaced went out on every tick: 240 a minute whatever
+// happened. Both payloads come from the firmware's own code: the new one
+// from ProgressGate and ProgressJson::write(), as WorkoutManager pushes it,
+// the old one from oldStatus() below, push_status_() as it was before.
+
+enum Phase
+{
+  kIdle,
+  kSteady,
+  kRamp,
+  kRest,
+  kPaused,
+  kPhases
+};
+static const char *const kPhaseName[kPhases] = {"idle", "swim, steady", "swim, ramp", "rest", "paused"};
+
+struct Cost
+{
+  uint64_t bytes, allocs, allocBytes;
+};
+
+struct Counts
+{
+  uint32_t ticks[kPhases], events[kPhases];
+  Cost progress, status; // the new event, the old one
+};
+static Counts *counts = (Counts *)mmap(nullptr, sizeof(Counts), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+// Every heap allocation while one of the payloads is built: operator new,
+// and malloc (ArduinoJson's DynamicJsonDocument calls it directly)
+static Cost *s_counting = nullptr;
+
+static void counted(size_t n)
+{
+  if (s_counting)
+  {
+    s_counting->allocs++;
+    s_counting->allocBytes += n;
+  }
+}
+
+extern "C" void *__libc_malloc(size_t);
+extern "C" void *__libc_calloc(size_t, size_t);
+extern "C" void *__libc_realloc(void *, size_t);
+extern "C" void __libc_free(void *);
+
+extern "C" void *malloc(size_t n)
+{
+  counted(n);
+  return __libc_malloc(n);
+}
+extern "C" void *calloc(size_t k, size_t n)
+{
+  counted(k * n);
+  return __libc_calloc(k, n);
+}
+extern "C" void *realloc(void *p, size_t n)
+{
+  counted(n);
+  return __libc_realloc(p, n);
+}
+void *operator new(size_t n)
+{
+  if (void *p = malloc(n ? n : 1))
+    return p;
+  throw std::bad_alloc();
+}
+void *operator new[](size_t n) { return operator new(n); }
+void operator delete(void *p) noexcept { __libc_free(p); }
+void operator delete[](void *p) noexcept { __libc_free(p); }
+void operator delete(void *p, size_t) noexcept { __libc_free(p); }
+void operator delete[](void *p, size_t) noexcept { __libc_free(p); }
+
+// The workout played: swims, rests and a build, with notes as people
+// write them
+static Workout bench_workout()
+{
+  Workout w;
+  w.id = "1750000000000";
+  w.name = "Threshold pyramid";
+  w.steps = {
+      {110, 120, "warm up, easy"},
+      {85, 60, "fast, hold form"},
+      {0, 30, "rest"},
+      {110, 180, "build to 90", 90},
+      {0, 30, "rest"},
+      {100, 240, "steady, paused for a minute in the middle"},
+  };
+  return w;
+}
+static const Workout kWorkout = bench_workout();
+static const WorkoutProgram::Program kProgram = WorkoutStorage::program(kWorkout);
+
+// WorkoutManager::push_status_() before the plan/progress split (49096be^),
+// the web part of it: the whole document, with the title, notes and next
+// steps, serialized to a String on every tick
+static const size_t kStatusSteps = 8;
+static String oldStatus(const SwimMachine::SwimStatus &st, const Workout &current, const WorkoutProgram::Program &prog)
+{
+  const size_t base = 2048;
+  const size_t per = 64 + WorkoutStorage::kMaxNoteLen;
+  DynamicJsonDocument doc(base + kStatusSteps * per);
+  doc["running"] = st.active;
+  doc["paused"] = st.paused;
+  doc["armed"] = st.armed;
+  doc["current_step"] = st.idx;
+  doc["elapsed_ms"] = st.elapsedMs;
+  doc["workout_ms"] = st.workoutMs;
+  doc["paused_ms"] = st.pausedMs;
+  doc["pace100s"] = st.pace100s;
+  doc["workout_title"] = current.name;
+
+  bool playing = st.active && !st.at.done && st.at.node < current.steps.size();
+  if (playing)
+    doc["current_step_note"] = current.steps[st.at.node].note;
+
+  JsonObject link = doc.createNestedObject("link");
+  link["state"] = st.found ? "up" : (st.everFound ? "lost" : "searching");
+  if (st.everFound)
+    link["age_ms"] = st.linkAgeMs;
+  link["peer"] = st.peer.toString();
+
+  if (st.machine.valid)
+  {
+    JsonObject m = doc.createNestedObject("machine");
+    m["state"] = st.machine.state;
+    m["cur_speed"] = st.machine.curSpeed;
+    m["tgt_speed"] = st.machine.tgtSpeed;
+    m["pace100s"] = st.machine.pace100s;
+    m["remaining_sec"] = st.machine.remainingSec;
+    m["runtime_sec"] = st.machine.runtimeSec;
+    m["total_runtime_sec"] = st.machine.totalRuntimeSec;
+    m["age_ms"] = SwimClock::millis() - st.machine.receivedMs;
+  }
+
+  JsonArray remaining = doc.createNestedArray("remaining_swims");
+  if (playing)
+  {
+    doc["remaining_steps"] = st.steps - st.at.index;
+    WorkoutProgram::Cursor c = st.at;
+    for (size_t n = 0; n < kStatusSteps && !c.done; ++n, WorkoutProgram::next(prog, c))
+    {
+      JsonObject swim = remaining.createNestedObject();
+      swim["pace100s"] = c.pace100s;
+      if (c.paceEnd100s)
+        swim["pace_end"] = c.paceEnd100s;
+      swim["durSec"] = c.durSec;
+      swim["note"] = current.steps[c.node].note;
+    }
+  }
+
+  String out;
+  serializeJson(doc, out);
+  return out;
+}
+
+static int session(double loss)
+{
+  *counts = {};
+  SwimMachine::begin();
+  SimMachine::Config c;
+  c.loss = loss;
+  SimMachine pool(IPAddress(192, 168, 1, 50), c);
+  ProgressGate gate;
+
+  auto tick = [&](bool force) {
+    SimMachine::run(250);
+    SwimMachine::SwimStatus st = SwimMachine::getStatus();
+    Phase p = kIdle;
+    if (st.paused)
+      p = kPaused;
+    else if (st.active && !st.at.done && st.at.node < kWorkout.steps.size())
+    {
+      const SwimStep &s = kWorkout.steps[st.at.node];
+      p = s.pace100s == 0 ? kRest : s.paceEnd100s ? kRamp : kSteady;
+    }
+    counts->ticks[p]++;
+
+    s_counting = &counts->status;
+    String status = oldStatus(st, kWorkout, kProgram);
+    s_counting = nullptr;
+    counts->status.bytes += status.length();
+
+    if (gate.due(st, millis(), force))
+    {
+      counts->events[p]++;
+      s_counting = &counts->progress;
+      char out[ProgressJson::kMax];
+      size_t n = ProgressJson::write(st, out, sizeof out);
+      s_counting = nullptr;
+      counts->progress.bytes += n;
+    }
+  };
+  auto ticks = [&](uint32_t ms) {
+    for (uint32_t t = 0; t < ms; t += 250)
+      tick(false);
+  };
+
+  ticks(120000); // machine heard, nothing running
+  SwimMachine::loadWorkout(kProgram);
+  SwimMachine::start();
+  tick(true); // run() pushes at once
+  bool pausedOnce = false;
+  while (SwimMachine::getStatus().active)
+  {
+    SwimMachine::SwimStatus st = SwimMachine::getStatus();
+    if (!pausedOnce && st.at.node == 5 && st.elapsedMs >= 120000)
+    {
+      pausedOnce = true;
+      SwimMachine::setPaused(true);
+      tick(true);
+      ticks(60000);
+      SwimMachine::setPaused(false);
+      tick(true);
+    }
+    tick(false);
+  }
+  ticks(120000);
+  return 0;
+}
+
+int main()
+{
+  printf("progress events per minute (the old status event: 240):\n");
+  printf("%-14s %6s %10s %10s\n", "", "loss", "minutes", "per min");
+  for (double loss : {0.0, 0.05})
+  {
+    host::isolated([&] { return session(loss); });
+    uint32_t ticks = 0, events = 0;
+    for (int p = 0; p < kPhases; ++p)
+    {
+      ticks += counts->ticks[p];
+      events += counts->events[p];
+      if (counts->ticks[p])
+        printf("%-14s %5.0f%% %10.1f %10.1f\n", kPhaseName[p], loss * 100, counts->ticks[p] / 240.0,
+               counts->events[p] * 240.0 / counts->ticks[p]);
+    }
+    printf("%-14s %5.0f%% %10.1f %10.1f\n", "all", loss * 100, ticks / 240.0, events * 240.0 / ticks);
+
+    // per minute over the whole session, and per event
+    double minutes = ticks / 240.0;
+    printf("%-14s %6s %10s %10s %10s %10s %12s\n", "", "", "events", "bytes", "per event", "allocs",
+           "alloc bytes");
+    auto row = [&](const char *name, const Cost &c, uint32_t n) {
+      printf("%-14s %5.0f%% %10.1f %10.0f %10.0f %10.1f %12.0f\n", name, loss * 100, n / minutes, c.bytes / minutes,
+             (double)c.bytes / n, c.allocs / minutes, c.allocBytes / minutes);
+    };
+    row("old status", counts->status, ticks);
+    row("progress", counts->progress, events);
+  }
+  return 0;
+}
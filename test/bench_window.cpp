@@ -0,0 +1,62 @@
+#include "sim_machine.h"
+#include "swim_machine.h"
+#include <sys/mman.h>
+
+// filled in by the isolated runs (shared with the forked children)
+struct Result
+{
+  uint32_t ms;
+  bool fallback;
+};
+static Result *result = (Result *)mmap(nullptr, sizeof(Result), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+
+// start() to the first status packet showing the motor turning, for each
+// send window, over 25 phases of the machine's 250 ms status period (the
+// round trip is one status period, so where start() lands in it matters)
+static int timeToMotor(uint8_t window, bool armed, double loss)
+{
+  const int kPhases = 25;
+  uint32_t sum = 0, worst = 0, fallbacks = 0;
+  for (int i = 0; i < kPhases; ++i)
+  {
+    host::isolated([&] {
+      SwimMachine::begin();
+      SimMachine::Config c;
+      c.phaseMs = 1 + i * 10;
+      c.loss = loss;
+      c.seed = 1 + i;
+      SimMachine pool(IPAddress(192, 168, 1, 50), c);
+      SimMachine::run(3000);
+      SwimMachine::setSendWindow(window);
+      SwimMachine::loadWorkout({{100, 60, 0, 0, 0, 0}});
+      if (armed)
+      {
+        SwimMachine::arm();
+        SimMachine::run(3000);
+      }
+      SwimMachine::start();
+      SimMachine::run(5000);
+      SwimMachine::ProtocolStats ps = SwimMachine::getProtocolStats();
+      *result = {ps.timeToMotorLastMs, ps.windowFallbacks > 0};
+      return 0;
+    });
+    sum += result->ms;
+    worst = std::max(worst, result->ms);
+    fallbacks += result->fallback;
+  }
+  printf("%6u %6s %5.0f%% %10u %10u %10u\n", window, armed ? "yes" : "no", loss * 100, sum / kPhases, worst, fallbacks);
+  return 0;
+}
+
+int main()
+{
+  printf("time to motor:\n");
+  printf("%6s %6s %6s %10s %10s %10s\n", "window", "armed", "loss", "avg ms", "max ms", "fallbacks");
+  for (double loss : {0.0, 0.05})
+  {
+    for (uint8_t w = 1; w <= SwimMachine::kMaxSendWindow; ++w)
+      timeToMotor(w, false, loss);
+    timeToMotor(1, true, loss);
+  }
+  return 0;
+}
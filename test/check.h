@@ -0,0 +1,39 @@
+#pragma once
+#include <stdio.h>
+
+/* Minimal checks for the host tests. A failed check prints its location and
+   the test carries on; check::report() gives the exit code. */
+namespace check
+{
+  inline int checks = 0;
+  inline int failures = 0;
+
+  inline bool fail(const char *file, int line, const char *expr)
+  {
+    printf("%s:%d: FAILED %s\n", file, line, expr);
+    failures++;
+    return false;
+  }
+
+  inline bool fail(const char *file, int line, const char *expr, long long a, long long b)
+  {
+    printf("%s:%d: FAILED %s (%lld vs %lld)\n", file, line, expr, a, b);
+    failures++;
+    return false;
+  }
+
+  /** Summary line; 0 if every check passed. */
+  inline int report(const char *name)
+  {
+    printf("%s: %d checks, %d failed\n", name, checks, failures);
+    return failures ? 1 : 0;
+  }
+}
+
+#define CHECK(c) \
+  (check::checks++, (c) ? true : check::fail(__FILE__, __LINE__, #c))
+
+#define CHECK_EQ(a, b)                                                                  \
+  (check::checks++, (a) == (b) ? true                                                   \
+                               : check::fail(__FILE__, __LINE__, #a " == " #b,          \
+                                             (long long)(a), (long long)(b)))
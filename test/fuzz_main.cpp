@@ -0,0 +1,72 @@
+/* main() for the fuzz targets where libFuzzer is not available (g++): runs
+   LLVMFuzzerTestOneInput, the libFuzzer entry point, once on every file
+   given or found in a given directory, like LLVM's
+   StandaloneFuzzTargetMain. Built with the sanitizers, that replays the
+   seed corpus and any crash-* file libFuzzer wrote elsewhere. It does not
+   search for new inputs: fuzzing needs clang (see the Makefile).
+
+     fuzz_x [-flag=value ...] [file|dir ...]
+
+   libFuzzer's flags are accepted and ignored, so both builds take the
+   same command line. With no inputs found the empty input runs once. */
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+static size_t inputs = 0;
+
+static void run(const std::string &path)
+{
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+  {
+    fprintf(stderr, "fuzz: cannot read %s\n", path.c_str());
+    exit(2);
+  }
+  if (S_ISDIR(st.st_mode))
+  {
+    DIR *d = opendir(path.c_str());
+    while (dirent *e = d ? readdir(d) : nullptr)
+      if (e->d_name[0] != '.')
+        run(path + "/" + e->d_name);
+    if (d)
+      closedir(d);
+    return;
+  }
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+  {
+    fprintf(stderr, "fuzz: cannot read %s\n", path.c_str());
+    exit(2);
+  }
+  std::vector<uint8_t> in;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof buf, f)) > 0)
+    in.insert(in.end(), buf, buf + n);
+  fclose(f);
+  LLVMFuzzerTestOneInput(in.data(), in.size());
+  inputs++;
+}
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; ++i)
+    if (argv[i][0] != '-')
+      run(argv[i]);
+  if (!inputs)
+  {
+    LLVMFuzzerTestOneInput(nullptr, 0);
+    inputs++;
+  }
+  const char *name = strrchr(argv[0], '/') ? strrchr(argv[0], '/') + 1 : argv[0];
+  printf("%s: %zu inputs replayed\n", name, inputs);
+  return 0;
+}
@@ -0,0 +1,68 @@
+#include "workout_program.h"
+#include <algorithm>
+
+using namespace WorkoutProgram;
+
+/* The program walker on arbitrary entries: each 12 input bytes are one
+   Node, up to 64 of them. WorkoutStorage only ever hands over validated
+   programs, but the cursor promises to skip what it cannot play (empty or
+   too deeply nested blocks, bodies running past the end) rather than
+   leave the program. Checks what playback relies on: the cursor stays on
+   a swim or rest entry, within the nesting limit, counts its steps one by
+   one, agrees with totals(), and ramps stay between their two paces. */
+
+static const uint32_t kMaxSteps = 2000; // as WorkoutStorage::kMaxExpanded
+
+static void check(bool ok)
+{
+  if (!ok)
+    abort();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  Program p;
+  for (size_t i = 0; i + 12 <= size && p.size() < 64; i += 12)
+  {
+    Node n;
+    memcpy(&n.pace100s, data + i, 2);
+    memcpy(&n.durSec, data + i + 2, 2);
+    memcpy(&n.repeat, data + i + 4, 2);
+    memcpy(&n.body, data + i + 6, 2);
+    memcpy(&n.paceStep, data + i + 8, 2);
+    memcpy(&n.paceEnd100s, data + i + 10, 2);
+    p.push_back(n);
+  }
+
+  uint32_t steps, activeSec;
+  bool whole = totals(p, steps, activeSec, kMaxSteps);
+
+  uint32_t walked = 0, active = 0;
+  for (Cursor c = first(p); !c.done; next(p, c))
+  {
+    check(c.index == (int32_t)walked);
+    check(c.node < p.size() && !p[c.node].repeat);
+    check(c.depth <= kMaxDepth);
+    check(!c.pace100s == !p[c.node].pace100s);
+    check(c.durSec == p[c.node].durSec);
+    if (c.pace100s)
+      active += c.durSec;
+
+    uint16_t lo = std::min(c.pace100s, c.paceEnd100s ? c.paceEnd100s : c.pace100s);
+    uint16_t hi = std::max(c.pace100s, c.paceEnd100s);
+    for (uint32_t ms : {0u, 1u, c.durSec * 500u, c.durSec * 1000u - 1, c.durSec * 1000u, 0xFFFFFFFFu})
+    {
+      uint16_t pace = paceAt(c, ms);
+      check(pace >= lo && pace <= hi);
+    }
+    if (++walked > kMaxSteps)
+      break;
+  }
+  check(whole == (walked <= kMaxSteps));
+  if (whole)
+  {
+    check(steps == walked);
+    check(activeSec == active);
+  }
+  return 0;
+}
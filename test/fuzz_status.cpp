@@ -0,0 +1,109 @@
+#include "host.h"
+#include "swim_machine.h"
+#include "crc32.h"
+#include <WiFiUdp.h>
+
+/* The receive path as any host on the LAN can reach it: datagrams of any
+   length and content on the status group and on the control port,
+   interleaved with the clock running and the web UI's calls. The input is
+   a script; each record is an opcode byte and its arguments:
+
+     op & 7 = 0..2  datagram: source (1 byte), length (1 byte; 2 with
+                    op & 0x80), payload. With op & 0x40 a 111-byte payload
+                    gets a valid header and CRC so it gets past the checks.
+                    With op & 0x20 it goes to the control port.
+     3              clock forward (1 byte x 4 ms), protocol task pass
+     4              load a one-step workout (machine, pace, duration)
+     5              start/arm/stop/pause (machine, which)
+     6              protocol task pass
+     7              clock forward past the link timeout (1 byte x 100 ms)
+
+   The firmware's state carries over between inputs, as it would on the
+   controller. */
+
+static uint8_t take(const uint8_t *&p, const uint8_t *end) { return p < end ? *p++ : 0; }
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  static bool started = [] {
+    SwimMachine::begin();
+    return true;
+  }();
+  (void)started;
+
+  const uint8_t *p = data, *end = data + size;
+  while (p < end)
+  {
+    uint8_t op = take(p, end);
+    switch (op & 7)
+    {
+    case 0:
+    case 1:
+    case 2:
+    {
+      IPAddress src(192, 168, 1, 50 + (take(p, end) & 7));
+      size_t len = take(p, end);
+      if (op & 0x80)
+        len |= (size_t)take(p, end) << 8;
+      std::vector<uint8_t> d(len);
+      size_t n = std::min(len, (size_t)(end - p));
+      std::copy(p, p + n, d.begin());
+      p += n;
+      if (len == 111 && (op & 0x40))
+      {
+        d[0] = 0x0A;
+        d[1] = 0xF0;
+        uint32_t c = Crc32::compute(d.data(), 107);
+        memcpy(&d[107], &c, 4);
+      }
+      uint16_t port = op & 0x20 ? 40000 : 45654;
+      hostnet::inject({src, 45654, op & 0x20 ? IPAddress(192, 168, 1, 2) : IPAddress(239, 255, 0, 1), port, d});
+      break;
+    }
+    case 3:
+      host::advanceUs((take(p, end) + 1) * 4000LL);
+      host::runTasks();
+      break;
+    case 4:
+    {
+      size_t m = take(p, end) % SwimMachine::kMaxMachines;
+      uint16_t pace = take(p, end);
+      uint16_t dur = take(p, end);
+      SwimMachine::loadWorkout({{pace, dur, 0, 0, 0, 0}}, m);
+      break;
+    }
+    case 5:
+    {
+      size_t m = take(p, end) % SwimMachine::kMaxMachines;
+      switch (take(p, end) & 3)
+      {
+      case 0:
+        SwimMachine::start(m);
+        break;
+      case 1:
+        SwimMachine::arm(m);
+        break;
+      case 2:
+        SwimMachine::stop(m);
+        break;
+      case 3:
+        SwimMachine::pause(m);
+        break;
+      }
+      break;
+    }
+    case 6:
+      host::runTasks();
+      break;
+    case 7:
+      host::advanceUs(take(p, end) * 100000LL);
+      host::runTasks();
+      break;
+    }
+  }
+  host::runTasks();
+
+  if (SwimMachine::machineCount() > SwimMachine::kMaxMachines)
+    abort();
+  return 0;
+}
@@ -0,0 +1,46 @@
+#include "workout_storage.h"
+
+/* WorkoutStorage's JSON codec on any bytes, as an upload reaches it
+   (POST /api/workouts). from_json() must reject what it cannot take and
+   leave the workout as it was. Whatever it accepts must survive the round
+   trip the controller makes when it saves and loads a workout: to_json()
+   writes it, from_json() reads back the same workout, and writing that
+   again gives the same text. Seeded with data/workouts. */
+
+static void check(bool ok)
+{
+  if (!ok)
+    abort();
+}
+
+static bool same(const Workout &a, const Workout &b)
+{
+  if (!(a.id == b.id) || !(a.name == b.name) || a.steps.size() != b.steps.size())
+    return false;
+  for (size_t i = 0; i < a.steps.size(); ++i)
+  {
+    const SwimStep &x = a.steps[i], &y = b.steps[i];
+    if (x.pace100s != y.pace100s || x.durSec != y.durSec || !(x.note == y.note) || x.paceEnd100s != y.paceEnd100s ||
+        x.repeat != y.repeat || x.body != y.body || x.paceStep != y.paceStep)
+      return false;
+  }
+  return true;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  Workout w;
+  w.name = "untouched";
+  if (!WorkoutStorage::from_json(data, size, w))
+  {
+    check(w.name == "untouched" && w.steps.empty());
+    return 0;
+  }
+  String j = WorkoutStorage::to_json(w);
+  check(j.length() > 0);
+  Workout back;
+  check(WorkoutStorage::from_json((const uint8_t *)j.c_str(), j.length(), back));
+  check(same(w, back));
+  check(WorkoutStorage::to_json(back) == j);
+  return 0;
+}
@@ -0,0 +1,181 @@
+#include "host.h"
+#include "esp_timer.h"
+#include <stdarg.h>
+#include <sys/wait.h>
+#include <ucontext.h>
+#include <unistd.h>
+#include <vector>
+
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+HostSerial Serial;
+bool host::verbose = false;
+
+/* ------------ clock --------------------------------------------- */
+namespace
+{
+  int64_t clockUs = 0;
+}
+
+int64_t host::nowUs() { return clockUs; }
+void host::setNowUs(int64_t us) { clockUs = us; }
+void host::advanceUs(int64_t us) { clockUs += us; }
+
+int64_t esp_timer_get_time() { return clockUs; }
+// both derive from esp_timer on the ESP32
+uint32_t millis() { return (uint32_t)(clockUs / 1000); }
+uint32_t micros() { return (uint32_t)clockUs; }
+
+int HostSerial::printf(const char *fmt, ...)
+{
+  if (!host::verbose)
+    return 0;
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  return n;
+}
+
+size_t HostSerial::println(const char *s)
+{
+  return host::verbose ? fprintf(stderr, "%s\n", s) : 0;
+}
+
+/* ------------ FreeRTOS ------------------------------------------ */
+// A task is a coroutine on its own stack. runTasks() switches into each one;
+// ulTaskNotifyTake() switches back. Nothing runs concurrently, so the
+// semaphores only have to count recursion.
+namespace
+{
+  struct Task
+  {
+    void (*fn)(void *);
+    void *arg;
+    ucontext_t ctx;
+    std::vector<uint8_t> stack;
+    void *fakeStack; // AddressSanitizer's, while switched out
+  };
+
+  std::vector<Task *> tasks;
+  Task *running = nullptr;
+  ucontext_t mainCtx;
+  const size_t kTaskStack = 256 * 1024; // generous: the host's frames are bigger
+
+  // AddressSanitizer has to be told about every stack switch
+  void *mainFakeStack = nullptr;
+  const void *mainBottom = nullptr;
+  size_t mainSize = 0;
+
+#ifdef __SANITIZE_ADDRESS__
+  void switchStarting(void **save, const void *bottom, size_t size) { __sanitizer_start_switch_fiber(save, bottom, size); }
+  void switchDone(void *restore, const void **fromBottom, size_t *fromSize) { __sanitizer_finish_switch_fiber(restore, fromBottom, fromSize); }
+#else
+  void switchStarting(void **, const void *, size_t) {}
+  void switchDone(void *, const void **, size_t *) {}
+#endif
+
+  void taskEntry()
+  {
+    switchDone(nullptr, &mainBottom, &mainSize);
+    running->fn(running->arg);
+    fprintf(stderr, "host: a task returned\n");
+    abort(); // FreeRTOS tasks never return
+  }
+
+  // back to runTasks() from inside a task
+  void yieldToMain()
+  {
+    Task *t = running;
+    running = nullptr;
+    switchStarting(&t->fakeStack, mainBottom, mainSize);
+    swapcontext(&t->ctx, &mainCtx);
+    switchDone(t->fakeStack, &mainBottom, &mainSize);
+  }
+
+  struct Recursive
+  {
+    int depth = 0;
+  };
+}
+
+void host::runTasks()
+{
+  for (size_t i = 0; i < tasks.size(); ++i)
+  {
+    running = tasks[i];
+    switchStarting(&mainFakeStack, running->stack.data(), running->stack.size());
+    swapcontext(&mainCtx, &running->ctx);
+    switchDone(mainFakeStack, nullptr, nullptr);
+  }
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *, uint32_t, void *arg,
+                                   UBaseType_t, TaskHandle_t *handle, BaseType_t)
+{
+  Task *t = new Task{fn, arg, {}, std::vector<uint8_t>(kTaskStack), nullptr};
+  getcontext(&t->ctx);
+  t->ctx.uc_stack.ss_sp = t->stack.data();
+  t->ctx.uc_stack.ss_size = t->stack.size();
+  t->ctx.uc_link = nullptr;
+  makecontext(&t->ctx, taskEntry, 0);
+  tasks.push_back(t);
+  if (handle)
+    *handle = t;
+  return pdPASS;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t)
+{
+  if (running)
+    yieldToMain();
+  return 0;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t)
+{
+  return pdPASS; // the next runTasks() is the wake-up
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex()
+{
+  return new Recursive;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t s, TickType_t)
+{
+  static_cast<Recursive *>(s)->depth++;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t s)
+{
+  Recursive *r = static_cast<Recursive *>(s);
+  if (r->depth <= 0)
+  {
+    fprintf(stderr, "host: semaphore given more often than taken\n");
+    abort();
+  }
+  r->depth--;
+  return pdTRUE;
+}
+
+/* ------------ isolation ----------------------------------------- */
+int host::isolated(const std::function<int()> &fn)
+{
+  fflush(stdout);
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid == 0)
+  {
+    int rc = fn();
+    fflush(stdout);
+    _exit(rc);
+  }
+  int status = 0;
+  if (pid < 0 || waitpid(pid, &status, 0) != pid)
+    return 1;
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
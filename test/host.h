@@ -0,0 +1,25 @@
+#pragma once
+#include <Arduino.h>
+#include <functional>
+
+/* Control over the host stand-ins in stubs/: the clock behind millis(),
+   micros() and esp_timer_get_time(), and the FreeRTOS tasks. */
+namespace host
+{
+  /** Time since "boot" in µs; only moves when a test moves it. */
+  int64_t nowUs();
+  void setNowUs(int64_t us);
+  void advanceUs(int64_t us);
+
+  /** Let every task started with xTaskCreatePinnedToCore() run until it
+      next waits in ulTaskNotifyTake(): one pass of its loop. */
+  void runTasks();
+
+  /** Serial output goes to stderr when set (default: dropped). */
+  extern bool verbose;
+
+  /** Run fn in a forked child, so it starts from the firmware's initial
+      state (its file-scope singletons) whatever ran before; fn's return
+      value, or 1 if the child crashed. */
+  int isolated(const std::function<int()> &fn);
+}
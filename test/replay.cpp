@@ -0,0 +1,153 @@
+/* Host replay of a recorded swim-protocol session (see replay.h).
+
+     replay <trace> [--echo] [--workout pace:dur,...] [--start ms] [--out log.json]
+
+   <trace>     a pcap from GET /api/capture.pcap, or one hex packet per line
+   --echo      acknowledge commands like the machine (latest idx2 into byte 2)
+   --workout   steps to play (s/100 m : seconds, pace 0 = rest); start()
+               is called just before the first recorded command, or at
+   --start     ms into the trace
+   --out       write the command log as JSON, for diffing two versions
+
+   The trace plays on the host clock, as fast as the host runs it. When
+   the trace holds the commands the controller sent at the time, they are
+   compared with the ones sent now. */
+#include "replay.h"
+#include <string>
+
+static const char *name(uint8_t opcode)
+{
+  switch (opcode)
+  {
+  case 0x1F:
+    return "start";
+  case 0x21:
+    return "stop";
+  case 0x24:
+    return "pace";
+  case 0x25:
+    return "duration";
+  }
+  return "unknown";
+}
+
+static void summary(const char *what, const std::vector<replay::Command> &log)
+{
+  size_t resends = 0;
+  for (const replay::Command &c : log)
+    resends += c.resend;
+  printf("%s: %zu commands, %zu retransmits\n", what, log.size(), resends);
+}
+
+static bool parseWorkout(const char *s, std::vector<SwimMachine::Segment> &out)
+{
+  while (*s)
+  {
+    char *end;
+    unsigned long pace = strtoul(s, &end, 10);
+    if (*end != ':')
+      return false;
+    unsigned long dur = strtoul(end + 1, &end, 10);
+    if (pace > 3600 || dur == 0 || dur > 5400 || (*end && *end != ','))
+      return false;
+    out.push_back({(uint16_t)pace, (uint16_t)dur, 0, 0, 0, 0});
+    s = *end ? end + 1 : end;
+  }
+  return !out.empty();
+}
+
+int main(int argc, char **argv)
+{
+  const char *tracePath = nullptr, *outPath = nullptr;
+  replay::Options opt;
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string a = argv[i];
+    if (a == "--echo")
+      opt.echo = true;
+    else if (a == "--workout" && i + 1 < argc)
+    {
+      if (!parseWorkout(argv[++i], opt.workout))
+      {
+        fprintf(stderr, "bad workout '%s' (pace:seconds,...)\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (a == "--start" && i + 1 < argc)
+      opt.startUs = (int64_t)(atof(argv[++i]) * 1000);
+    else if (a == "--out" && i + 1 < argc)
+      outPath = argv[++i];
+    else
+      tracePath = argv[i];
+  }
+  if (!tracePath)
+  {
+    fprintf(stderr, "usage: replay <trace> [--echo] [--workout pace:dur,...] [--start ms] [--out log.json]\n");
+    return 1;
+  }
+
+  std::vector<uint8_t> file;
+  FILE *f = fopen(tracePath, "rb");
+  if (!f)
+  {
+    fprintf(stderr, "cannot open %s\n", tracePath);
+    return 1;
+  }
+  uint8_t buf[4096];
+  for (size_t n; (n = fread(buf, 1, sizeof buf, f)) > 0;)
+    file.insert(file.end(), buf, buf + n);
+  fclose(f);
+
+  std::vector<replay::Packet> trace;
+  size_t status = 0;
+  if (!replay::load(file, trace) || trace.empty())
+  {
+    fprintf(stderr, "no status packets in %s\n", tracePath);
+    return 1;
+  }
+  for (const replay::Packet &p : trace)
+    status += !p.tx;
+  printf("%zu status packets, %.1f s recorded\n", status, (trace.back().us - trace[0].us) / 1e6);
+
+  std::vector<replay::Command> log = replay::run(trace, opt);
+  for (const replay::Command &c : log)
+    printf("%8lld ms  idx2=0x%02x  0x%02x %s %u%s\n", (long long)(c.us / 1000), c.idx2, c.opcode,
+           name(c.opcode), c.param, c.resend ? "  (retransmit)" : "");
+  summary("replayed", log);
+
+  std::vector<replay::Command> rec = replay::recorded(trace);
+  if (!rec.empty())
+  {
+    summary("recorded", rec);
+    size_t i = 0;
+    int64_t worst = 0;
+    for (; i < log.size() && i < rec.size(); ++i)
+    {
+      if (log[i].opcode != rec[i].opcode || log[i].param != rec[i].param)
+        break;
+      worst = std::max(worst, std::abs(log[i].us - rec[i].us));
+    }
+    if (i == log.size() && i == rec.size())
+      printf("same commands as recorded, at most %lld ms apart\n", (long long)(worst / 1000));
+    else
+      printf("first difference at command %zu (same before it, at most %lld ms apart)\n", i, (long long)(worst / 1000));
+  }
+
+  if (outPath)
+  {
+    FILE *o = fopen(outPath, "w");
+    if (!o)
+    {
+      fprintf(stderr, "cannot write %s\n", outPath);
+      return 1;
+    }
+    fprintf(o, "{\"trace\":\"%s\",\"echo\":%s,\"log\":[", tracePath, opt.echo ? "true" : "false");
+    for (size_t i = 0; i < log.size(); ++i)
+      fprintf(o, "%s\n{\"ms\":%.3f,\"idx2\":%u,\"cmd\":%u,\"name\":\"%s\",\"param\":%u,\"retransmit\":%s}", i ? "," : "",
+              log[i].us / 1000.0, log[i].idx2, log[i].opcode, name(log[i].opcode), log[i].param,
+              log[i].resend ? "true" : "false");
+    fprintf(o, "\n]}\n");
+    fclose(o);
+  }
+  return 0;
+}
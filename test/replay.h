@@ -0,0 +1,199 @@
+#pragma once
+#include "crc32.h"
+#include "host.h"
+#include "swim_machine.h"
+#include <WiFiUdp.h>
+#include <string>
+#include <vector>
+
+/* Replays a recorded session through the firmware's protocol code on the
+   host clock: the recorded status packets go back onto the status group
+   at their recorded times, and the commands swim_machine.cpp sends in
+   response are logged with their timing. The host twin of
+   viewer/replay.js, which does the same against a controller on the LAN.
+   Runs once per process (SwimMachine::begin() starts the protocol task). */
+namespace replay
+{
+  struct Packet
+  {
+    int64_t us; // as recorded
+    bool tx;    // a command the controller sent (44 bytes to port 9750)
+    IPAddress src;
+    std::vector<uint8_t> data;
+  };
+
+  struct Command
+  {
+    int64_t us; // after the first packet of the trace
+    uint8_t idx2, opcode;
+    uint16_t param;
+    bool resend; // same idx2 as the command before it
+  };
+
+  struct Options
+  {
+    bool echo = false;     // acknowledge commands like the machine: latest idx2 into byte 2
+    int64_t startUs = -1;  // start() this far into the trace; -1 = just before the first recorded command
+    std::vector<SwimMachine::Segment> workout; // played from startUs (none: no start())
+  };
+
+  inline uint32_t get32(const uint8_t *p, bool le)
+  {
+    return le ? p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24
+              : (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+  }
+
+  /** A pcap from GET /api/capture.pcap (or raw IPv4 / Ethernet), or text
+      with one hex packet per line, optionally after a ms timestamp. Keeps
+      the 111-byte status packets and the 44-byte commands. */
+  inline bool load(const std::vector<uint8_t> &f, std::vector<Packet> &out)
+  {
+    out.clear();
+    bool le = f.size() >= 24 && get32(f.data(), true) == 0xA1B2C3D4;
+    bool be = f.size() >= 24 && get32(f.data(), false) == 0xA1B2C3D4;
+    if (le || be)
+    {
+      uint32_t link = get32(&f[20], le);
+      for (size_t o = 24; o + 16 <= f.size();)
+      {
+        int64_t us = get32(&f[o], le) * 1000000LL + get32(&f[o + 4], le);
+        size_t incl = get32(&f[o + 8], le);
+        if (o + 16 + incl > f.size())
+          break;
+        const uint8_t *ip = &f[o + 16];
+        size_t len = incl;
+        o += 16 + incl;
+        if (link == 1) // Ethernet
+        {
+          if (len < 14)
+            continue;
+          ip += 14;
+          len -= 14;
+        }
+        else if (link != 101 && link != 228)
+          return false;
+        if (len < 28 || (ip[0] >> 4) != 4 || ip[9] != 17 || len < (size_t)(ip[0] & 0x0F) * 4 + 8)
+          continue;
+        size_t hdr = (ip[0] & 0x0F) * 4;
+        const uint8_t *udp = ip + hdr;
+        uint16_t dstPort = udp[2] << 8 | udp[3];
+        std::vector<uint8_t> payload(udp + 8, ip + len);
+        bool tx = dstPort == 9750 && payload.size() == 44;
+        if (!tx && payload.size() != 111)
+          continue;
+        out.push_back({us, tx, IPAddress(ip[12], ip[13], ip[14], ip[15]), payload});
+      }
+      return true;
+    }
+
+    // text: "[ms] hex" per line; untimed lines follow 250 ms apart
+    std::string text(f.begin(), f.end());
+    int64_t us = 0;
+    for (size_t pos = 0; pos < text.size();)
+    {
+      size_t eol = text.find('\n', pos);
+      std::string line = text.substr(pos, eol == std::string::npos ? std::string::npos : eol - pos);
+      pos = eol == std::string::npos ? text.size() : eol + 1;
+      char *rest = nullptr;
+      double ms = strtod(line.c_str(), &rest);
+      bool timed = rest != line.c_str() && *rest == ' ';
+      const char *hex = timed ? rest : line.c_str();
+      std::vector<uint8_t> b;
+      for (const char *p = hex; *p;)
+      {
+        if (isspace((unsigned char)*p))
+        {
+          p++;
+          continue;
+        }
+        if (!isxdigit((unsigned char)p[0]) || !isxdigit((unsigned char)p[1]))
+        {
+          b.clear();
+          break;
+        }
+        char byte[3] = {p[0], p[1], 0};
+        b.push_back((uint8_t)strtoul(byte, nullptr, 16));
+        p += 2;
+      }
+      if (b.size() != 111 && b.size() != 44)
+        continue;
+      us = timed ? (int64_t)(ms * 1000) : us + 250000;
+      out.push_back({us, b.size() == 44, IPAddress(192, 168, 1, 50), b});
+    }
+    return true;
+  }
+
+  /** Play the trace's status packets and return the commands sent. */
+  inline std::vector<Command> run(const std::vector<Packet> &trace, const Options &opt)
+  {
+    std::vector<Command> sent;
+    if (trace.empty())
+      return sent;
+    const int64_t t0 = trace[0].us;
+    const int64_t baseUs = 10000000; // host clock at the first packet
+
+    int64_t startUs = opt.startUs;
+    if (startUs < 0 && !opt.workout.empty())
+      for (const Packet &p : trace)
+        if (p.tx)
+        {
+          startUs = p.us - t0 - 1000;
+          break;
+        }
+
+    host::setNowUs(baseUs - 1000);
+    SwimMachine::begin();
+    hostnet::onSend = [&](const hostnet::Datagram &d) {
+      if (d.dstPort != 9750 || d.data.size() != 44)
+        return;
+      bool resend = !sent.empty() && sent.back().idx2 == d.data[2];
+      sent.push_back({host::nowUs() - baseUs, d.data[2], d.data[3], (uint16_t)(d.data[4] | d.data[5] << 8), resend});
+    };
+
+    bool started = startUs < 0 || opt.workout.empty();
+    auto until = [&](int64_t us) {
+      while (host::nowUs() < baseUs + us)
+      {
+        host::advanceUs(1000);
+        if (!started && host::nowUs() >= baseUs + startUs)
+        {
+          SwimMachine::loadWorkout(opt.workout);
+          SwimMachine::start();
+          started = true;
+        }
+        if ((host::nowUs() / 1000) % 5 == 0)
+          host::runTasks();
+      }
+    };
+
+    for (const Packet &p : trace)
+    {
+      if (p.tx)
+        continue;
+      until(p.us - t0);
+      std::vector<uint8_t> d = p.data;
+      if (opt.echo && !sent.empty())
+      {
+        d[2] = sent.back().idx2;
+        uint32_t c = Crc32::compute(d.data(), 107);
+        memcpy(&d[107], &c, 4);
+      }
+      hostnet::inject({p.src, 45654, IPAddress(239, 255, 0, 1), 45654, d});
+    }
+    until(trace.back().us - t0 + 2000000); // let the last acks arrive
+    return sent;
+  }
+
+  /** The commands of a recorded trace, in the same form. */
+  inline std::vector<Command> recorded(const std::vector<Packet> &trace)
+  {
+    std::vector<Command> out;
+    for (const Packet &p : trace)
+      if (p.tx)
+      {
+        bool resend = !out.empty() && out.back().idx2 == p.data[2];
+        out.push_back({p.us - trace[0].us, p.data[2], p.data[3], (uint16_t)(p.data[4] | p.data[5] << 8), resend});
+      }
+    return out;
+  }
+}
@@ -0,0 +1,242 @@
+#pragma once
+#include "crc32.h"
+#include "host.h"
+#include <WiFiUdp.h>
+#include <math.h>
+#include <random>
+#include <vector>
+
+/* Simulated pool machine on the host network (stubs/WiFiUdp.h), the C++
+   twin of viewer/emulator.js: takes the 44-byte commands sent to its
+   address (or broadcast) on UDP 9750 and multicasts 111-byte status
+   packets with a speed ramp, the duration countdown and the idx2 echo. */
+struct SimMachineConfig
+{
+  uint32_t intervalMs = 250; // status period
+  uint32_t phaseMs = 0;      // first status packet after this
+  double k = 6000;           // speed * pace100s
+  double rampUpMs = 150;     // per speed unit
+  double rampDownMs = 100;
+  double loss = 0;           // drop probability for commands and status packets
+  uint32_t seed = 1;
+};
+
+class SimMachine
+{
+public:
+  using Config = SimMachineConfig;
+
+  // One applied command, on the host clock
+  struct Command
+  {
+    int64_t us;
+    uint8_t idx2, opcode;
+    uint16_t param;
+  };
+
+  // The water reached the target speed
+  struct Reached
+  {
+    int64_t us;
+    uint8_t speed;
+  };
+
+  // One status period
+  struct Sample
+  {
+    int64_t us;
+    double curSpeed;
+    uint8_t tgtSpeed;
+    uint16_t pace100s;
+  };
+
+  SimMachine(IPAddress ip, Config cfg = Config()) : m_ip(ip), m_cfg(cfg), m_rng(cfg.seed)
+  {
+    m_nextStatusUs = host::nowUs() + (int64_t)(cfg.phaseMs ? cfg.phaseMs : cfg.intervalMs) * 1000;
+    all().push_back(this);
+    hostnet::onSend = dispatch;
+  }
+  ~SimMachine()
+  {
+    auto &a = all();
+    for (size_t i = 0; i < a.size(); ++i)
+      if (a[i] == this)
+        a.erase(a.begin() + i--);
+  }
+
+  /** Advance the host clock by ms, 1 ms at a time: the water ramps every
+      ms, status packets go out when due and the firmware's tasks run
+      every pollMs. */
+  static void run(uint32_t ms, uint32_t pollMs = 5)
+  {
+    for (uint32_t i = 0; i < ms; ++i)
+    {
+      host::advanceUs(1000);
+      pollAll();
+      if ((host::nowUs() / 1000) % pollMs == 0)
+        host::runTasks();
+    }
+  }
+
+  /** One ms of every machine, for callers that drive the clock themselves. */
+  static void pollAll()
+  {
+    for (SimMachine *s : all())
+      s->poll();
+  }
+
+  /** Offline: no status packets, commands go unheard (power cut, cable pulled). */
+  void setOnline(bool on) { m_online = on; }
+
+  IPAddress ip() const { return m_ip; }
+  bool on() const { return m_on; }
+  double curSpeed() const { return m_curSpeed; }
+  uint8_t targetSpeed() const { return m_on && m_pace ? (uint8_t)std::min(255.0, round(m_cfg.k / m_pace)) : 0; }
+  uint16_t pace() const { return m_pace; }
+  uint16_t duration() const { return m_duration; }
+  const std::vector<Command> &commands() const { return m_commands; }
+  const std::vector<Reached> &reached() const { return m_reached; }
+  const std::vector<Sample> &profile() const { return m_profile; }
+  uint32_t received() const { return m_received; } // incl. retransmissions and ignored ones
+
+  /** Packet the machine would send now (exposed for tests that inject their own). */
+  std::vector<uint8_t> statusPacket() const
+  {
+    std::vector<uint8_t> b(111);
+    b[0] = 0x0A;
+    b[1] = 0xF0;
+    b[2] = m_msgId;
+    b[3] = m_state;
+    b[4] = (uint8_t)round(m_curSpeed);
+    b[5] = targetSpeed();
+    put16(&b[7], m_pace);
+    put16(&b[11], (uint16_t)ceil(m_remainingMs / 1000));
+    float f = (float)m_runtimeSec;
+    memcpy(&b[23], &f, 4);
+    f = (float)m_totalRuntimeSec;
+    memcpy(&b[27], &f, 4);
+    uint32_t c = Crc32::compute(b.data(), 107);
+    memcpy(&b[107], &c, 4);
+    return b;
+  }
+
+private:
+  static std::vector<SimMachine *> &all()
+  {
+    static std::vector<SimMachine *> v;
+    return v;
+  }
+
+  static void dispatch(const hostnet::Datagram &d)
+  {
+    if (d.dstPort != 9750)
+      return;
+    for (SimMachine *s : all())
+      if (d.dst == s->m_ip || d.dst == IPAddress(255, 255, 255, 255))
+        s->onCommand(d.data);
+  }
+
+  static void put16(uint8_t *p, uint16_t v)
+  {
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+  }
+
+  bool lost() { return m_cfg.loss > 0 && std::uniform_real_distribution<double>(0, 1)(m_rng) < m_cfg.loss; }
+
+  void onCommand(const std::vector<uint8_t> &msg)
+  {
+    if (!m_online)
+      return;
+    m_received++;
+    if (lost())
+      return;
+    if (msg.size() != 44 || msg[0] != 0x0A || msg[1] != 0xF0 || !Crc32::checkTrailer(msg.data(), 44))
+      return;
+    uint8_t idx2 = msg[2], cmd = msg[3];
+    uint16_t param = (uint16_t)(msg[4] | msg[5] << 8);
+    if (idx2 == m_msgId)
+      return; // retransmission of a command already applied
+    // like the machine, ignore commands while it is winding down
+    if (m_state == 0x4E || m_state == 0x0E || m_state == 0x4A || m_state == 0x0A)
+      return;
+    m_msgId = idx2;
+    m_commands.push_back({host::nowUs(), idx2, cmd, param});
+    switch (cmd)
+    {
+    case 0x1F:
+      if (!m_on)
+      {
+        m_on = true;
+        m_remainingMs = m_duration * 1000.0;
+        m_runtimeSec = 0;
+      }
+      break;
+    case 0x21:
+      m_on = false;
+      break;
+    case 0x24:
+      m_pace = param;
+      break;
+    case 0x25:
+      m_duration = param;
+      m_remainingMs = param * 1000.0;
+      break;
+    }
+  }
+
+  void poll()
+  {
+    step(1);
+    if (host::nowUs() < m_nextStatusUs)
+      return;
+    m_nextStatusUs += (int64_t)m_cfg.intervalMs * 1000;
+    m_profile.push_back({host::nowUs(), m_curSpeed, targetSpeed(), m_pace});
+    if (m_online && !lost())
+      hostnet::inject({m_ip, 45654, IPAddress(239, 255, 0, 1), 45654, statusPacket()});
+  }
+
+  void step(double dtMs)
+  {
+    double tgt = targetSpeed();
+    bool was = m_curSpeed == tgt;
+    if (m_curSpeed < tgt)
+      m_curSpeed = std::min(tgt, m_curSpeed + dtMs / m_cfg.rampUpMs);
+    else if (m_curSpeed > tgt)
+      m_curSpeed = std::max(tgt, m_curSpeed - dtMs / m_cfg.rampDownMs);
+    if (!was && m_curSpeed == tgt)
+      m_reached.push_back({host::nowUs(), (uint8_t)tgt});
+    if (m_on)
+    {
+      m_runtimeSec += dtMs / 1000;
+      m_totalRuntimeSec += dtMs / 1000;
+      m_remainingMs -= dtMs;
+      if (m_duration && m_remainingMs <= 0)
+      { // workout time is up
+        m_remainingMs = 0;
+        m_on = false;
+      }
+    }
+    // status code as the machine reports it (see commands.csv)
+    int cur = (int)round(m_curSpeed);
+    if (m_on)
+      m_state = cur < tgt ? (cur == 0 ? 0x49 : 0x4B) : cur > tgt ? 0x4A : 0x0F;
+    else
+      m_state = cur > 0 ? 0x4E : 0x08;
+  }
+
+  IPAddress m_ip;
+  Config m_cfg;
+  std::mt19937 m_rng;
+  int64_t m_nextStatusUs;
+
+  bool m_online = true;
+  bool m_on = false;
+  uint16_t m_pace = 0, m_duration = 0;
+  double m_remainingMs = 0, m_curSpeed = 0, m_runtimeSec = 0, m_totalRuntimeSec = 0;
+  uint8_t m_msgId = 0, m_state = 0x08;
+  uint32_t m_received = 0;
+  std::vector<Command> m_commands;
+  std::vector<Reached> m_reached;
+  std::vector<Sample> m_profile;
+};
@@ -0,0 +1,117 @@
+/* The protocol side of the firmware against simulated pool machines, as
+   one Linux process to run under perf or valgrind.
+
+     simulate <workout.json> [--machines n] [--loss p] [--window n] [--repeat n]
+
+   --machines  pool machines on the fake network (default 1); the first
+               kMaxMachines get a lane and play the workout, staggered
+   --loss      drop probability for commands and status packets
+   --window    send window (1-4)
+   --repeat    play the workout this many times (default 1)
+
+   This is the code swim_machine.cpp runs on the ESP32: the protocol task,
+   the lookahead scheduler, the command queue and the receive path, with
+   SwimClock on the host clock. The workout is read by WorkoutStorage's
+   from_json(), as the firmware reads it. The web server and panel are not
+   part of it: they need AsyncWebServer and the HUB75 driver, which the host
+   build does not have. Prints host CPU time per simulated hour. */
+#include "sim_machine.h"
+#include "swim_machine.h"
+#include "workout_file.h"
+#include <memory>
+#include <string>
+#include <time.h>
+
+static double cpuSeconds()
+{
+  timespec t;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+  const char *path = nullptr;
+  size_t machines = 1;
+  unsigned repeat = 1, window = 1;
+  SimMachine::Config cfg;
+  for (int i = 1; i < argc; ++i)
+  {
+    std::string a = argv[i];
+    if (a == "--machines" && i + 1 < argc)
+      machines = strtoul(argv[++i], nullptr, 10);
+    else if (a == "--loss" && i + 1 < argc)
+      cfg.loss = atof(argv[++i]);
+    else if (a == "--window" && i + 1 < argc)
+      window = strtoul(argv[++i], nullptr, 10);
+    else if (a == "--repeat" && i + 1 < argc)
+      repeat = strtoul(argv[++i], nullptr, 10);
+    else
+      path = argv[i];
+  }
+  Workout w;
+  std::vector<SwimMachine::Segment> program;
+  if (!path || machines == 0 || window < 1 || window > SwimMachine::kMaxSendWindow)
+  {
+    fprintf(stderr, "usage: simulate <workout.json> [--machines n] [--loss p] [--window n] [--repeat n]\n");
+    return 1;
+  }
+  if (!readWorkout(path, w) || (program = WorkoutStorage::program(w)).empty())
+  {
+    fprintf(stderr, "cannot read a workout from %s\n", path);
+    return 1;
+  }
+
+  SwimMachine::begin();
+  std::vector<std::unique_ptr<SimMachine>> pools;
+  for (size_t i = 0; i < machines; ++i)
+  {
+    SimMachine::Config c = cfg;
+    c.phaseMs = 1 + (uint32_t)(i * 250 / machines); // spread over the status period
+    c.seed = cfg.seed + i;
+    pools.emplace_back(new SimMachine(IPAddress(192, 168, 1, 50 + i), c));
+  }
+  SimMachine::run(3000);
+  size_t lanes = SwimMachine::machineCount();
+  printf("%s: \"%s\", %zu machines, %zu lanes, loss %.0f%%, window %u\n", path, w.name.c_str(), machines, lanes,
+         cfg.loss * 100, window);
+
+  int64_t simFromUs = host::nowUs();
+  double cpuFrom = cpuSeconds();
+  for (unsigned r = 0; r < repeat; ++r)
+  {
+    for (size_t m = 0; m < lanes; ++m)
+    {
+      SwimMachine::setSendWindow(window, m);
+      SwimMachine::loadWorkout(program, m);
+      SwimMachine::start(m);
+      SimMachine::run(1000 / lanes); // staggered starts
+    }
+    for (bool active = true; active;)
+    {
+      SimMachine::run(1000);
+      active = false;
+      for (size_t m = 0; m < lanes; ++m)
+        active |= SwimMachine::getStatus(m).active;
+    }
+    SimMachine::run(2000);
+  }
+  double cpu = cpuSeconds() - cpuFrom;
+  double simHours = (host::nowUs() - simFromUs) / 3.6e9;
+
+  // err: the firmware's own worst boundary error, first ramps (not yet learned) included
+  printf("%4s %8s %8s %8s %10s %10s %10s\n", "lane", "status", "commands", "resends", "ack max ms", "err max ms",
+         "lead ms");
+  for (size_t m = 0; m < lanes; ++m)
+  {
+    SwimMachine::ProtocolStats ps = SwimMachine::getProtocolStats(m);
+    uint32_t sent = 0;
+    for (const SwimMachine::CommandStats &c : ps.commands)
+      sent += c.sent;
+    printf("%4zu %8u %8u %8u %10u %10u %10u\n", m, (unsigned)ps.rxPackets, (unsigned)sent, (unsigned)ps.retransmits,
+           (unsigned)ps.ackMaxMs, (unsigned)ps.boundaryErrMaxAbsMs, (unsigned)ps.leadLastMs);
+  }
+  printf("%.2f simulated hours in %.3f s of CPU: %.1f ms per simulated hour (the simulated machines included)\n",
+         simHours, cpu, cpu * 1000 / simHours);
+  return 0;
+}
@@ -0,0 +1,136 @@
+#pragma once
+/* Host stand-in for the parts of the Arduino core the tested sources use.
+   Only what they need; extend it when a new source is added to the tests.
+   The functions are implemented in host.cpp. */
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+typedef uint8_t byte;
+
+// newlib has it; glibc before 2.38 does not
+inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+  size_t n = strlen(src);
+  if (size)
+  {
+    size_t c = n < size - 1 ? n : size - 1;
+    memcpy(dst, src, c);
+    dst[c] = 0;
+  }
+  return n;
+}
+
+// unsigned long is 32 bits on the ESP32: these wrap like the real ones
+uint32_t millis();
+uint32_t micros();
+
+class String
+{
+public:
+  String() {}
+  String(const char *s) : m_s(s ? s : "") {}
+  String(int v) : m_s(std::to_string(v)) {}
+  String(unsigned v) : m_s(std::to_string(v)) {}
+  String(long v) : m_s(std::to_string(v)) {}
+  String(unsigned long v) : m_s(std::to_string(v)) {}
+  String(long long v) : m_s(std::to_string(v)) {}
+  String(unsigned long long v) : m_s(std::to_string(v)) {}
+
+  const char *c_str() const { return m_s.c_str(); }
+  size_t length() const { return m_s.size(); }
+  char operator[](size_t i) const { return i < m_s.size() ? m_s[i] : 0; }
+  bool concat(const char *s)
+  {
+    m_s += s ? s : "";
+    return true;
+  }
+  String substring(size_t from, size_t to = (size_t)-1) const
+  {
+    return from < m_s.size() ? String(m_s.substr(from, to < from ? 0 : to - from).c_str()) : String();
+  }
+  bool endsWith(const String &o) const
+  {
+    return m_s.size() >= o.m_s.size() && m_s.compare(m_s.size() - o.m_s.size(), o.m_s.size(), o.m_s) == 0;
+  }
+  String operator+(const String &o) const { return String((m_s + o.m_s).c_str()); }
+  friend String operator+(const char *a, const String &b) { return String(a) + b; }
+  bool operator==(const String &o) const { return m_s == o.m_s; }
+  bool operator!=(const String &o) const { return m_s != o.m_s; }
+
+private:
+  std::string m_s;
+};
+
+// what a + on Strings returns in the Arduino core; ArduinoJson adapts both
+class StringSumHelper : public String
+{
+};
+
+class IPAddress
+{
+public:
+  IPAddress() {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : m_b{a, b, c, d} {}
+  IPAddress(uint32_t v) { memcpy(m_b, &v, 4); } // network order in memory, as on the ESP32
+
+  uint8_t operator[](int i) const { return m_b[i]; }
+  operator uint32_t() const
+  {
+    uint32_t v;
+    memcpy(&v, m_b, 4);
+    return v;
+  }
+  bool operator==(const IPAddress &o) const { return memcmp(m_b, o.m_b, 4) == 0; }
+  bool operator!=(const IPAddress &o) const { return !(*this == o); }
+  String toString() const
+  {
+    char s[16];
+    snprintf(s, sizeof s, "%u.%u.%u.%u", m_b[0], m_b[1], m_b[2], m_b[3]);
+    return String(s);
+  }
+
+private:
+  uint8_t m_b[4] = {0, 0, 0, 0};
+};
+
+struct HostSerial
+{
+  int printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+  size_t println(const char *s);
+  size_t println(const String &s) { return println(s.c_str()); }
+};
+extern HostSerial Serial;
+
+/* FreeRTOS, which the ESP32 core includes with Arduino.h. Tasks run as
+   coroutines driven by host::runTasks() (see host.h), so they never run
+   at the same time as the test or each other. */
+typedef void *SemaphoreHandle_t;
+typedef void *TaskHandle_t;
+typedef int BaseType_t;
+typedef unsigned UBaseType_t;
+typedef uint32_t TickType_t;
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define portMAX_DELAY 0xFFFFFFFFu
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex();
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t s, TickType_t wait);
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t s);
+BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name, uint32_t stack, void *arg,
+                                   UBaseType_t prio, TaskHandle_t *handle, BaseType_t core);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t wait);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+typedef struct
+{
+  int unused;
+} portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+inline void portENTER_CRITICAL(portMUX_TYPE *) {}
+inline void portEXIT_CRITICAL(portMUX_TYPE *) {}
@@ -0,0 +1,8 @@
+#pragma once
+#include <Arduino.h>
+
+struct HostETH
+{
+  IPAddress localIP() const { return IPAddress(); } // no cable: WiFi is used
+};
+inline HostETH ETH;
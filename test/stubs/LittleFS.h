@@ -0,0 +1,25 @@
+#pragma once
+#include <Arduino.h>
+
+/* No file system on the host: nothing exists and every open fails. The
+   tests hand workouts to WorkoutStorage::from_json() themselves. */
+class File
+{
+public:
+  explicit operator bool() const { return false; }
+  void close() {}
+  String readString() { return String(); }
+  size_t print(const String &) { return 0; }
+  File openNextFile() { return File(); }
+  const char *name() const { return ""; }
+};
+
+struct HostLittleFS
+{
+  bool begin(bool = false, const char * = "/littlefs", uint8_t = 10, const char * = "spiffs") { return true; }
+  bool exists(const String &) { return false; }
+  bool mkdir(const String &) { return false; }
+  File open(const String &, const char * = "r") { return File(); }
+  bool remove(const String &) { return false; }
+};
+inline HostLittleFS LittleFS;
@@ -0,0 +1,8 @@
+#pragma once
+#include <Arduino.h>
+
+struct HostWiFi
+{
+  IPAddress localIP() const { return IPAddress(192, 168, 1, 2); }
+};
+inline HostWiFi WiFi;
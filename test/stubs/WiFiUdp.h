@@ -0,0 +1,124 @@
+#pragma once
+#include <Arduino.h>
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <vector>
+
+/* Host WiFiUDP on an in-memory network. A socket queues the datagrams
+   addressed to its local port, at most hostnet::queueLimit of them like
+   the lwIP receive mailbox; datagrams beyond that are dropped. Everything
+   a socket sends goes to hostnet::onSend. */
+class WiFiUDP;
+
+namespace hostnet
+{
+  struct Datagram
+  {
+    IPAddress src;
+    uint16_t srcPort;
+    IPAddress dst;
+    uint16_t dstPort;
+    std::vector<uint8_t> data;
+  };
+
+  inline size_t queueLimit = 64;  // per socket
+  inline uint32_t dropped = 0;    // datagrams that found a socket's queue full
+  inline std::function<void(const Datagram &)> onSend;
+  inline std::vector<WiFiUDP *> sockets;
+
+  /** Deliver d to every socket bound to d.dstPort. */
+  void inject(const Datagram &d);
+}
+
+class WiFiUDP
+{
+public:
+  ~WiFiUDP() { stop(); }
+
+  uint8_t begin(uint16_t port)
+  {
+    stop();
+    m_port = port;
+    hostnet::sockets.push_back(this);
+    return 1;
+  }
+  uint8_t beginMulticast(IPAddress, uint16_t port) { return begin(port); }
+  void stop()
+  {
+    auto &s = hostnet::sockets;
+    for (size_t i = 0; i < s.size(); ++i)
+      if (s[i] == this)
+        s.erase(s.begin() + i--);
+    m_rx.clear();
+    m_port = 0;
+  }
+
+  int parsePacket()
+  {
+    m_cur.clear();
+    m_off = 0;
+    if (m_rx.empty())
+      return 0;
+    m_cur = std::move(m_rx.front().data);
+    m_remote = m_rx.front().src;
+    m_remotePort = m_rx.front().srcPort;
+    m_rx.pop_front();
+    return (int)m_cur.size();
+  }
+  int read(uint8_t *buf, size_t len)
+  {
+    size_t n = std::min(len, m_cur.size() - m_off);
+    memcpy(buf, m_cur.data() + m_off, n);
+    m_off += n;
+    return (int)n;
+  }
+  int available() { return (int)(m_cur.size() - m_off); }
+  void flush() { m_off = m_cur.size(); }
+  IPAddress remoteIP() { return m_remote; }
+  uint16_t remotePort() { return m_remotePort; }
+
+  int beginPacket(IPAddress ip, uint16_t port)
+  {
+    m_tx = {IPAddress(192, 168, 1, 2), m_port, ip, port, {}};
+    return 1;
+  }
+  size_t write(const uint8_t *d, size_t len)
+  {
+    m_tx.data.insert(m_tx.data.end(), d, d + len);
+    return len;
+  }
+  int endPacket()
+  {
+    if (hostnet::onSend)
+      hostnet::onSend(m_tx);
+    return 1;
+  }
+
+  // for hostnet::inject()
+  uint16_t localPort() const { return m_port; }
+  void deliver(const hostnet::Datagram &d)
+  {
+    if (m_rx.size() >= hostnet::queueLimit)
+      hostnet::dropped++;
+    else
+      m_rx.push_back(d);
+  }
+  size_t queued() const { return m_rx.size(); }
+
+private:
+  uint16_t m_port = 0;
+  std::deque<hostnet::Datagram> m_rx;
+  std::vector<uint8_t> m_cur;
+  size_t m_off = 0;
+  IPAddress m_remote;
+  uint16_t m_remotePort = 0;
+  hostnet::Datagram m_tx;
+};
+
+inline void hostnet::inject(const Datagram &d)
+{
+  for (WiFiUDP *s : sockets)
+    if (s->localPort() == d.dstPort)
+      s->deliver(d);
+}
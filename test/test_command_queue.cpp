@@ -0,0 +1,211 @@
+#include "check.h"
+#include "command_queue.h"
+#include <deque>
+#include <random>
+
+using Command = CommandQueue::Command;
+
+// What urgentStop() keeps (see swim_machine.cpp): everything but pace and start
+static bool keptByStop(uint8_t op) { return op != 0x24 && op != 0x1F; }
+
+// The queue as a plain deque, following the comments in command_queue.h
+struct Model
+{
+  std::deque<Command> q;
+  CommandQueue::Stats stats = {};
+
+  bool push(uint8_t op, uint16_t param, bool coalesce, uint8_t locked)
+  {
+    if (coalesce)
+      for (size_t i = q.size(); i-- > locked;)
+        if (q[i].opcode == op)
+        {
+          q[i].param = param;
+          stats.coalesced++;
+          return true;
+        }
+    if (q.size() == CommandQueue::kCapacity)
+    {
+      stats.overflows++;
+      return false;
+    }
+    q.push_back({op, param});
+    stats.pushed++;
+    grew();
+    return true;
+  }
+
+  void dropPending(uint8_t locked, CommandQueue::Keep keep)
+  {
+    std::deque<Command> r(q.begin(), q.begin() + std::min<size_t>(locked, q.size()));
+    for (size_t i = r.size(); i < q.size(); ++i)
+      if (keep && keep(q[i].opcode))
+        r.push_back(q[i]);
+    stats.dropped += q.size() - r.size();
+    q = r;
+  }
+
+  void preempt(uint8_t op, uint16_t param, CommandQueue::Keep keep)
+  {
+    std::deque<Command> r{{op, param}};
+    for (const Command &c : q)
+      if (keep && r.size() < CommandQueue::kCapacity && keep(c.opcode))
+        r.push_back(c);
+    stats.dropped += q.size() - (r.size() - 1);
+    stats.preempted++;
+    stats.pushed++;
+    q = r;
+    grew();
+  }
+
+  void grew()
+  {
+    if (q.size() > stats.highWater)
+      stats.highWater = (uint8_t)q.size();
+  }
+};
+
+static bool same(const CommandQueue &q, const Model &m)
+{
+  if (q.size() != m.q.size() || q.empty() != m.q.empty() ||
+      q.full() != (m.q.size() == CommandQueue::kCapacity))
+    return false;
+  for (size_t i = 0; i < q.size(); ++i)
+    if (q.at(i).opcode != m.q[i].opcode || q.at(i).param != m.q[i].param)
+      return false;
+  const auto &a = q.stats(), &b = m.stats;
+  return a.pushed == b.pushed && a.coalesced == b.coalesced && a.overflows == b.overflows &&
+         a.dropped == b.dropped && a.preempted == b.preempted && a.highWater == b.highWater;
+}
+
+// Random commands, sends and acks the way Machine drives the queue: the
+// first `inFlight` entries are on the wire (locked), acks pop them, and
+// stops either preempt or flush the pending entries
+static void randomized(uint32_t seed, int steps)
+{
+  std::mt19937 rng(seed);
+  CommandQueue q;
+  Model m;
+  uint8_t inFlight = 0;
+  uint8_t window = 1 + rng() % 4;
+  const uint8_t ops[] = {0x1F, 0x21, 0x24, 0x25};
+  for (int i = 0; i < steps; ++i)
+  {
+    uint32_t r = rng() % 100;
+    uint8_t op = ops[rng() % 4];
+    uint16_t param = (uint16_t)rng();
+    if (r < 45)
+    { // pace/duration coalesce like setPace()/setDuration()
+      bool coalesce = op == 0x24 || op == 0x25;
+      CHECK_EQ(q.push(op, param, coalesce, inFlight), m.push(op, param, coalesce, inFlight));
+    }
+    else if (r < 65)
+    { // send: fill the window
+      inFlight = (uint8_t)std::min<size_t>(window, q.size());
+    }
+    else if (r < 85)
+    { // ack of the oldest command in flight (or a stale echo)
+      if (inFlight)
+      {
+        q.pop();
+        m.q.pop_front();
+        inFlight--;
+      }
+      else
+      {
+        q.pop(); // must be harmless on an empty queue only
+        if (!m.q.empty())
+          m.q.pop_front();
+      }
+    }
+    else if (r < 90)
+    {
+      CommandQueue::Keep keep = rng() % 2 ? keptByStop : nullptr;
+      q.dropPending(inFlight, keep);
+      m.dropPending(inFlight, keep);
+    }
+    else if (r < 95)
+    { // fast-path stop: ahead of everything, nothing stays in flight
+      CommandQueue::Keep keep = rng() % 2 ? keptByStop : nullptr;
+      q.preempt(0x21, 0, keep);
+      m.preempt(0x21, 0, keep);
+      inFlight = 0;
+    }
+    else
+    {
+      window = 1 + rng() % 4;
+      inFlight = (uint8_t)std::min<size_t>(inFlight, q.size());
+    }
+    if (!CHECK(same(q, m)))
+    {
+      printf("  seed %u, step %d\n", (unsigned)seed, i);
+      return;
+    }
+  }
+}
+
+int main()
+{
+  // directed cases first
+  {
+    CommandQueue q;
+    CHECK(q.push(0x24, 100, true, 0));
+    CHECK(q.push(0x24, 110, true, 1)); // front is on the wire: not rewritten
+    CHECK(q.push(0x24, 120, true, 1)); // pending one takes the newest value
+    CHECK_EQ(q.size(), 2u);
+    CHECK_EQ(q.at(0).param, 100);
+    CHECK_EQ(q.at(1).param, 120);
+    CHECK_EQ(q.stats().coalesced, 1u);
+  }
+  {
+    CommandQueue q;
+    for (int i = 0; i < CommandQueue::kCapacity; ++i)
+      CHECK(q.push(0x24, i, false, 0));
+    CHECK(q.full());
+    CHECK(!q.push(0x21, 0, false, 0)); // a full queue refuses, never overwrites
+    CHECK_EQ(q.at(0).param, 0);
+    CHECK_EQ(q.stats().overflows, 1u);
+    q.preempt(0x21, 0); // the stop still goes first
+    CHECK_EQ(q.size(), 1u);
+    CHECK_EQ(q.front().opcode, 0x21);
+    CHECK_EQ(q.stats().dropped, (uint32_t)CommandQueue::kCapacity);
+  }
+  {
+    // a stop keeps the duration but drops paces and starts
+    CommandQueue q;
+    q.push(0x25, 600, true, 0);
+    q.push(0x24, 100, true, 0);
+    q.push(0x1F, 0, false, 0);
+    q.preempt(0x21, 0, keptByStop);
+    CHECK_EQ(q.size(), 2u);
+    CHECK_EQ(q.at(0).opcode, 0x21);
+    CHECK_EQ(q.at(1).opcode, 0x25);
+    CHECK_EQ(q.at(1).param, 600);
+
+    // a full queue of kept entries loses its newest to make room
+    for (int i = 0; q.size() < CommandQueue::kCapacity; ++i)
+      q.push(0x25, 700 + i, false, 0);
+    q.preempt(0x21, 1, keptByStop);
+    CHECK_EQ(q.size(), (size_t)CommandQueue::kCapacity);
+    CHECK_EQ(q.front().param, 1);
+    CHECK_EQ(q.at(1).opcode, 0x21);
+    CHECK_EQ(q.at(CommandQueue::kCapacity - 1).param, 700 + 12);
+  }
+  {
+    CommandQueue q;
+    q.push(0x24, 1, false, 0);
+    q.push(0x24, 2, false, 0);
+    q.push(0x25, 3, false, 0);
+    q.push(0x24, 4, false, 0);
+    q.dropPending(1, keptByStop); // the one on the wire stays, then the duration
+    CHECK_EQ(q.size(), 2u);
+    CHECK_EQ(q.at(0).param, 1);
+    CHECK_EQ(q.at(1).param, 3);
+  }
+
+  // 200k randomized interleavings against the model
+  for (uint32_t seed = 1; seed <= 20; ++seed)
+    randomized(seed, 10000);
+
+  return check::report("command_queue");
+}
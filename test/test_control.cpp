@@ -0,0 +1,212 @@
+#include "check.h"
+#include "request_ids.h"
+#include "sim_machine.h"
+#include "swim_machine.h"
+#include <algorithm>
+#include <random>
+
+// The controller's side of the /ws control round trip: request ids answered
+// once, repeat-safe ops, and how long pause/resume/adjust take from the call
+// to the command on the wire, to the machine applying it and to its ack.
+// The WebSocket itself (phone to controller) is viewer/ws_loadtest.js.
+
+static int requestIds()
+{
+  RecentRequests<4, 8> r;
+  const char *error = "x";
+  CHECK(!r.seen("1", error));
+  r.remember("1", nullptr);
+  r.remember("2", "not armed");
+  CHECK(r.seen("1", error) && error == nullptr);
+  CHECK(r.seen("2", error) && !strcmp(error, "not armed"));
+  CHECK(!r.seen("3", error));
+  for (const char *id : {"3", "4", "5"})
+    r.remember(id, nullptr);
+  CHECK(!r.seen("1", error)); // the oldest went
+  CHECK(r.seen("2", error) && !strcmp(error, "not armed"));
+  CHECK(r.seen("5", error));
+  r.remember("\"abcdefgh\"", nullptr); // too long: kept cut, never matches the full id
+  CHECK(!r.seen("\"abcdefgh\"", error));
+  return check::report("control: request ids");
+}
+
+static const std::vector<SwimMachine::Segment> kWorkout = {{100, 1800, 0, 0, 0, 0}};
+
+// pause/resume set the state and adjust takes an absolute offset, so a
+// double tap or a resend does the same as one request
+static int repeatSafe()
+{
+  SwimMachine::begin();
+  SimMachine pool(IPAddress(192, 168, 1, 50));
+  SimMachine::run(3000);
+  SwimMachine::loadWorkout(kWorkout);
+  CHECK(SwimMachine::start());
+  SimMachine::run(10000);
+
+  SwimMachine::setPaused(true);
+  SwimMachine::setPaused(true);
+  SimMachine::run(3000);
+  CHECK(SwimMachine::getStatus().paused);
+  CHECK(!pool.on());
+  CHECK_EQ(SwimMachine::getProtocolStats().urgentCount, 1u);
+
+  SwimMachine::setPaused(false);
+  SwimMachine::setPaused(false);
+  SimMachine::run(5000);
+  CHECK(!SwimMachine::getStatus().paused);
+  CHECK(pool.on());
+
+  SwimMachine::setPaceOffset(-5);
+  SwimMachine::setPaceOffset(-5);
+  SimMachine::run(3000);
+  CHECK_EQ(SwimMachine::getStatus().pace100s, 95);
+  CHECK_EQ(pool.profile().back().pace100s, 95);
+  SwimMachine::setPaceOffset(0);
+  SimMachine::run(3000);
+  CHECK_EQ(pool.profile().back().pace100s, 100);
+  return check::report("control: repeat-safe");
+}
+
+// arm with a program is refused on a running lane and leaves the workout
+// it is playing alone; on an idle lane it loads and stages the new one
+static int armRefused()
+{
+  SwimMachine::begin();
+  SimMachine pool(IPAddress(192, 168, 1, 50));
+  SimMachine::run(3000);
+  SwimMachine::loadWorkout(kWorkout);
+  CHECK(SwimMachine::start());
+  SimMachine::run(10000);
+
+  const std::vector<SwimMachine::Segment> other = {{120, 60, 0, 0, 0, 0}, {90, 60, 0, 0, 0, 0}};
+  CHECK(!SwimMachine::arm(other));
+  SwimMachine::SwimStatus st = SwimMachine::getStatus();
+  CHECK(st.active && !st.armed);
+  CHECK_EQ(st.steps, 1u);
+  CHECK_EQ(st.pace100s, 100);
+
+  SwimMachine::stop();
+  while (pool.profile().back().curSpeed > 0)
+    SimMachine::run(100);
+  SimMachine::run(1000);
+  CHECK(!SwimMachine::arm(std::vector<SwimMachine::Segment>{})); // empty
+  CHECK(SwimMachine::arm(other));
+  SimMachine::run(1000);
+  st = SwimMachine::getStatus();
+  CHECK(st.armed && !st.active);
+  CHECK_EQ(pool.profile().back().pace100s, 120);
+  return check::report("control: arm refused while running");
+}
+
+enum Op
+{
+  kPause,
+  kResume,
+  kAdjust,
+  kOps
+};
+static const char *const kOpName[kOps] = {"pause", "resume", "adjust"};
+static const int kOpCommands[kOps] = {1, 2, 1}; // resume: pace, then start
+
+struct Latency
+{
+  std::vector<int64_t> wireUs, ackedUs;
+};
+
+static int64_t percentile(std::vector<int64_t> &v, double p)
+{
+  std::sort(v.begin(), v.end());
+  return v[std::min(v.size() - 1, (size_t)(p * v.size()))];
+}
+
+// 300 ops, a few seconds apart, on a running workout: pause and resume in
+// turn, with an adjust between them. A resume waits for the water to stop:
+// commands are held while the machine winds down, as it ignores them then.
+static int roundTrips(double loss)
+{
+  SwimMachine::begin();
+  SimMachine::Config c;
+  c.loss = loss;
+  SimMachine pool(IPAddress(192, 168, 1, 50), c);
+  int64_t sentUs = -1;
+  auto dispatch = hostnet::onSend;
+  hostnet::onSend = [&](const hostnet::Datagram &d) {
+    if (sentUs < 0 && d.dstPort == 9750 && d.data.size() == 44)
+      sentUs = host::nowUs();
+    dispatch(d);
+  };
+  SimMachine::run(3000);
+  SwimMachine::loadWorkout(kWorkout);
+  CHECK(SwimMachine::start());
+  SimMachine::run(10000);
+
+  Latency lat[kOps];
+  std::mt19937 rng(7);
+  int16_t offset = 0;
+  for (int i = 0; i < 300; ++i)
+  {
+    SimMachine::run(2000 + rng() % 2000);
+    while (SwimMachine::getStatus().paused && pool.profile().back().curSpeed > 0)
+      SimMachine::run(100);
+    SwimMachine::SwimStatus st = SwimMachine::getStatus();
+    uint32_t acks = SwimMachine::getProtocolStats().ackCount;
+    Op op = st.paused ? kResume : i % 3 == 2 ? kAdjust : kPause;
+    sentUs = -1;
+    int64_t t0 = host::nowUs();
+    if (op == kAdjust)
+      SwimMachine::setPaceOffset(offset = offset ? 0 : -3);
+    else
+      SwimMachine::setPaused(op == kPause);
+
+    // acked: every command of the op echoed back, nothing left queued
+    int64_t ackedUs = -1;
+    for (int ms = 0; ms < 10000 && ackedUs < 0; ++ms)
+    {
+      SimMachine::run(1, 1);
+      SwimMachine::ProtocolStats ps = SwimMachine::getProtocolStats();
+      if (ps.ackCount >= acks + kOpCommands[op] && ps.txQueued == 0)
+        ackedUs = host::nowUs();
+    }
+    if (!CHECK(sentUs >= 0 && ackedUs >= 0))
+      break;
+    lat[op].wireUs.push_back(sentUs - t0);
+    lat[op].ackedUs.push_back(ackedUs - t0);
+  }
+
+  for (int op = 0; op < kOps; ++op)
+  {
+    Latency &l = lat[op];
+    if (!CHECK(!l.ackedUs.empty()))
+      continue;
+    int64_t wire99 = percentile(l.wireUs, 0.99), ack50 = percentile(l.ackedUs, 0.5),
+            ack90 = percentile(l.ackedUs, 0.9), ack99 = percentile(l.ackedUs, 0.99), ackMax = l.ackedUs.back();
+    printf("%-7s %4.0f%% %5zu %9.1f %9.1f %9.1f %9.1f %9.1f\n", kOpName[op], loss * 100, l.ackedUs.size(),
+           wire99 / 1000.0, ack50 / 1000.0, ack90 / 1000.0, ack99 / 1000.0, ackMax / 1000.0);
+    // one status period and a poll per command; with loss, half of the
+    // time, and a lost command or ack costs a retransmission timeout
+    int64_t bound = kOpCommands[op] * 260000LL;
+    if (loss == 0)
+    {
+      CHECK(l.wireUs.back() <= 5000); // the next 5 ms poll at the latest
+      CHECK(ackMax <= bound);
+    }
+    else
+    {
+      CHECK(ack50 <= bound);
+      CHECK(ackMax <= bound + 1500000);
+    }
+  }
+  return check::report(loss ? "control: round trips, 5% loss" : "control: round trips");
+}
+
+int main()
+{
+  int failed = host::isolated(requestIds);
+  failed += host::isolated(repeatSafe);
+  failed += host::isolated(armRefused);
+  printf("control call to command on the wire (p99) and to its ack, ms:\n");
+  printf("%-7s %5s %5s %9s %9s %9s %9s %9s\n", "op", "loss", "n", "wire p99", "ack p50", "p90", "p99", "max");
+  failed += host::isolated([] { return roundTrips(0); });
+  failed += host::isolated([] { return roundTrips(0.05); });
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,52 @@
+#include "check.h"
+#include "crc32.h"
+#include <random>
+
+// The bitwise loop crc32.cpp replaced, as the reference
+static uint32_t crcBitwise(const uint8_t *d, size_t n)
+{
+  uint32_t c = 0xFFFFFFFF;
+  while (n--)
+  {
+    c ^= *d++;
+    for (int k = 0; k < 8; ++k)
+      c = (c & 1) ? (c >> 1) ^ 0xEDB88320 : (c >> 1);
+  }
+  return ~c;
+}
+
+int main()
+{
+  // IEEE 802.3 check value
+  CHECK_EQ(Crc32::compute((const uint8_t *)"123456789", 9), 0xCBF43926u);
+  CHECK_EQ(Crc32::compute(nullptr, 0), 0u);
+
+  // every length up to past a status packet, at every alignment
+  std::mt19937 rng(1);
+  uint8_t buf[160 + 4];
+  for (auto &b : buf)
+    b = (uint8_t)rng();
+  for (size_t align = 0; align < 4; ++align)
+    for (size_t n = 0; n <= 160; ++n)
+      CHECK_EQ(Crc32::compute(buf + align, n), crcBitwise(buf + align, n));
+
+  // trailer check on a status packet: header, CRC over bytes 0-106 in 107-110
+  uint8_t pkt[111];
+  for (auto &b : pkt)
+    b = (uint8_t)rng();
+  pkt[0] = 0x0A;
+  pkt[1] = 0xF0;
+  uint32_t c = crcBitwise(pkt, 107);
+  memcpy(pkt + 107, &c, 4);
+  CHECK(Crc32::checkTrailer(pkt, sizeof pkt));
+  for (size_t i = 0; i < sizeof pkt; ++i)
+  { // any single bit flip is caught
+    pkt[i] ^= 0x10;
+    CHECK(!Crc32::checkTrailer(pkt, sizeof pkt));
+    pkt[i] ^= 0x10;
+  }
+  CHECK(!Crc32::checkTrailer(pkt, 3));
+  CHECK(!Crc32::checkTrailer(pkt, 110));
+
+  return check::report("crc32");
+}
@@ -0,0 +1,165 @@
+#include "check.h"
+#include "sim_machine.h"
+#include "swim_machine.h"
+#include <string>
+#include <unistd.h>
+
+// viewer/emulator.js (what the controller is tried against on the LAN) and
+// test/sim_machine.h (what the host tests play against) are two copies of
+// one machine model. The firmware plays a workout against SimMachine and
+// its commands are recorded with their times; a few datagrams the machine
+// must drop are added. That trace goes to a fresh SimMachine and to
+// `node emulator.js --trace`, and their status packets must be the same,
+// byte for byte. Skipped when node is not installed.
+
+static const std::vector<SwimMachine::Segment> kWorkout = {
+    {110, 40, 0, 0, 0, 0},
+    {0, 15, 0, 0, 0, 0},
+    {100, 60, 0, 0, 0, 80}, // build
+    {90, 60, 0, 0, 0, 0},   // stopped during this one
+};
+
+struct Sent
+{
+  uint32_t ms; // since the machine came up
+  std::vector<uint8_t> data;
+};
+
+static std::string hex(const std::vector<uint8_t> &b)
+{
+  std::string s;
+  char h[3];
+  for (uint8_t c : b)
+  {
+    snprintf(h, sizeof h, "%02x", c);
+    s += h;
+  }
+  return s;
+}
+
+// The firmware's commands to the machine: a workout with a pause, stopped
+// before its end, then started again
+static std::vector<Sent> record()
+{
+  std::vector<Sent> trace;
+  SwimMachine::begin();
+  SimMachine pool(IPAddress(192, 168, 1, 50));
+  int64_t upUs = host::nowUs();
+  auto dispatch = hostnet::onSend;
+  hostnet::onSend = [&](const hostnet::Datagram &d) {
+    if (d.dstPort == 9750)
+      trace.push_back({(uint32_t)((host::nowUs() - upUs) / 1000), d.data});
+    dispatch(d);
+  };
+  SimMachine::run(3000);
+  SwimMachine::loadWorkout(kWorkout);
+  CHECK(SwimMachine::start());
+  SimMachine::run(70000); // into the build
+  SwimMachine::setPaused(true);
+  SimMachine::run(10000);
+  SwimMachine::setPaused(false);
+  SimMachine::run(60000);
+  SwimMachine::stop();
+  while (pool.curSpeed() > 0)
+    SimMachine::run(100);
+  SwimMachine::loadWorkout(kWorkout);
+  SwimMachine::start();
+  SimMachine::run(20000);
+  SwimMachine::stop();
+  SimMachine::run(5000);
+  hostnet::onSend = dispatch;
+  CHECK(trace.size() > 10);
+  return trace;
+}
+
+// What the machine must drop: a new command while it winds down after the
+// last stop, a resend of that stop, a corrupt CRC and a short datagram
+static void addNoise(std::vector<Sent> &trace)
+{
+  Sent last = trace.back();
+  CHECK_EQ(last.data[3], 0x21);
+  std::vector<Sent> noise = {{last.ms + 100, last.data}, {last.ms + 140, last.data}, {last.ms + 180, last.data},
+                             {last.ms + 220, last.data}};
+  noise[0].data[2]++; // next idx2: a pace, well framed
+  noise[0].data[3] = 0x24;
+  noise[0].data[4] = 100;
+  uint32_t crc = Crc32::compute(noise[0].data.data(), 40);
+  memcpy(&noise[0].data[40], &crc, 4);
+  noise[2].data[3] = 0x1F; // a start, under the stop's CRC
+  noise[3].data.resize(40);
+  trace.insert(trace.end(), noise.begin(), noise.end());
+}
+
+// The status packets a SimMachine sends on the trace, as "<ms> <hex>"
+static std::vector<std::string> simulate(const std::vector<Sent> &trace)
+{
+  std::vector<std::string> out;
+  SimMachine twin(IPAddress(192, 168, 1, 50));
+  uint32_t endMs = trace.back().ms + 10000;
+  size_t i = 0;
+  for (uint32_t t = 1; t <= endMs; ++t)
+  {
+    host::advanceUs(1000);
+    SimMachine::pollAll();
+    if (t % 250 == 0)
+      out.push_back(std::to_string(t) + " " + hex(twin.statusPacket()));
+    for (; i < trace.size() && trace[i].ms <= t; ++i)
+      hostnet::onSend({IPAddress(192, 168, 1, 10), 9750, twin.ip(), 9750, trace[i].data});
+  }
+  return out;
+}
+
+static std::vector<std::string> emulate(const char *path)
+{
+  std::vector<std::string> out;
+  std::string cmd = std::string("node ../viewer/emulator.js --trace ") + path;
+  FILE *p = popen(cmd.c_str(), "r");
+  if (!CHECK(p))
+    return out;
+  char line[512];
+  while (fgets(line, sizeof line, p))
+  {
+    std::string s = line;
+    while (!s.empty() && (s.back() == '\n' || s.back() == '\r'))
+      s.pop_back();
+    out.push_back(s);
+  }
+  CHECK_EQ(pclose(p), 0);
+  return out;
+}
+
+static int sameTrace()
+{
+  std::vector<Sent> trace = record();
+  addNoise(trace);
+
+  char path[] = "/tmp/test_emulator_XXXXXX";
+  int fd = mkstemp(path);
+  if (!CHECK(fd >= 0))
+    return 1;
+  FILE *f = fdopen(fd, "w");
+  for (const Sent &s : trace)
+    fprintf(f, "%u %s\n", (unsigned)s.ms, hex(s.data).c_str());
+  fclose(f);
+
+  std::vector<std::string> sim = simulate(trace), js = emulate(path);
+  unlink(path);
+  CHECK_EQ(js.size(), sim.size());
+  size_t differ = 0;
+  for (size_t i = 0; i < std::min(js.size(), sim.size()); ++i)
+    if (js[i] != sim[i] && differ++ < 3)
+      printf("  sim_machine.h %s\n  emulator.js   %s\n", sim[i].c_str(), js[i].c_str());
+  CHECK_EQ(differ, 0u);
+  printf("emulator: %zu commands, %zu status packets compared\n", trace.size(), sim.size());
+  return check::report("emulator: same trace, same status");
+}
+
+int main()
+{
+  if (system("command -v node >/dev/null 2>&1") != 0)
+  {
+    printf("emulator: node not found, skipped\n");
+    return 0;
+  }
+  return host::isolated(sameTrace);
+}
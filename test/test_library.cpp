@@ -0,0 +1,129 @@
+#include "check.h"
+#include "sim_machine.h"
+#include "swim_machine.h"
+#include "workout_file.h"
+#include <dirent.h>
+#include <math.h>
+#include <string>
+
+// Every saved workout (data/workouts/*.json, or the directory given) played
+// against the simulated machine on the host clock: a scheduling change can
+// be checked on the whole library in seconds. Per workout it checks that the
+// boundaries are the exact sums of the step durations and that, once the
+// ramp model has seen both directions, the water is at each step's speed
+// within 0.6 s of its boundary. Before a step too short to ramp in (the
+// commands go out at most half of it ahead) it checks that they went out
+// that far ahead.
+
+static uint8_t speedFor(uint16_t pace, double k) { return pace ? (uint8_t)round(k / pace) : 0; }
+
+static int play(const std::string &file, const std::string &title, const std::vector<SwimMachine::Segment> &program)
+{
+  SimMachine::Config cfg;
+  SwimMachine::begin();
+  SimMachine pool(IPAddress(192, 168, 1, 50), cfg);
+  SimMachine::run(2000);
+  SwimMachine::loadWorkout(program);
+  int64_t startUs = host::nowUs();
+  CHECK(SwimMachine::start());
+  for (int s = 0; s < 6 * 60 * 60 && SwimMachine::getStatus().active; ++s)
+    SimMachine::run(1000);
+  CHECK(!SwimMachine::getStatus().active);
+
+  std::vector<SwimMachine::SegmentReport> report = SwimMachine::getSegmentReport();
+  SwimMachine::ProtocolStats ps = SwimMachine::getProtocolStats();
+  int64_t plannedSumMs = 0;
+  int32_t worstLate = 0, worstEarly = 0;
+  int shortSteps = 0; // too short before them to ramp on time
+  uint32_t prevDur = 0;
+  uint8_t prevSpeed = 0;
+  size_t i = 0;
+  for (auto c = WorkoutProgram::first(program); !c.done; WorkoutProgram::next(program, c), ++i)
+  {
+    if (i + 1 >= report.size()) // the report keeps the first 64 steps
+      break;
+    const SwimMachine::SegmentReport &r = report[i];
+    if (i == 0)
+      plannedSumMs = r.plannedMs;
+    CHECK_EQ((int64_t)r.plannedMs, plannedSumMs);
+    plannedSumMs += c.durSec * 1000;
+
+    // a ramp step's speed is the one it starts at; an unchanged speed
+    // has no ramp to time
+    uint8_t speed = speedFor(c.pace100s, cfg.k);
+    int64_t boundaryUs = startUs + (int64_t)r.plannedMs * 1000;
+    int64_t fromUs = i ? boundaryUs - prevDur * 500000LL : startUs;
+    int32_t rampMs = speed > prevSpeed ? (speed - prevSpeed) * cfg.rampUpMs : (prevSpeed - speed) * cfg.rampDownMs;
+    bool tooShort = rampMs > (int32_t)(prevDur * 500);
+    int32_t capMs = prevDur * 500;
+    bool timed = i >= 3 && speed != prevSpeed;
+    prevDur = c.durSec;
+    prevSpeed = c.paceEnd100s ? speedFor(c.paceEnd100s, cfg.k) : speed;
+    if (!timed)
+      continue;
+    int64_t atUs = -1;
+    for (const SimMachine::Reached &e : pool.reached())
+      if (e.us >= fromUs && e.speed == speed)
+      {
+        atUs = e.us;
+        break;
+      }
+    if (!CHECK(atUs >= 0))
+      continue;
+    int32_t err = (int32_t)((atUs - boundaryUs) / 1000);
+    if (tooShort)
+    {
+      CHECK((int32_t)(r.plannedMs - r.issuedMs) >= capMs - 10);
+      shortSteps++;
+      continue;
+    }
+    worstLate = std::max(worstLate, err);
+    worstEarly = std::min(worstEarly, err);
+  }
+  printf("%-24s %-12.12s %6zu %8.1f %8d %8d %6d %9u %8u\n", file.c_str(), title.c_str(), i, plannedSumMs / 60000.0,
+         -worstEarly, worstLate, shortSteps, (unsigned)(ps.commands[0].sent + ps.commands[1].sent + ps.commands[2].sent + ps.commands[3].sent),
+         (unsigned)ps.retransmits);
+  CHECK(i > 0);
+  CHECK(worstLate <= 600 && -worstEarly <= 600);
+  CHECK_EQ(ps.retransmits, 0u);
+  return check::report(("library: " + file).c_str());
+}
+
+int main(int argc, char **argv)
+{
+  std::string dir = argc > 1 ? argv[1] : "../data/workouts";
+  std::vector<std::string> files;
+  if (DIR *d = opendir(dir.c_str()))
+  {
+    while (dirent *e = readdir(d))
+    {
+      std::string n = e->d_name;
+      if (n.size() > 5 && n.compare(n.size() - 5, 5, ".json") == 0)
+        files.push_back(n);
+    }
+    closedir(d);
+  }
+  std::sort(files.begin(), files.end());
+  if (files.empty())
+  {
+    fprintf(stderr, "no workouts in %s\n", dir.c_str());
+    return 1;
+  }
+
+  printf("%-24s %-12s %6s %8s %8s %8s %6s %9s %8s\n", "workout", "title", "steps", "minutes", "early ms", "late ms",
+         "short", "commands", "resends");
+  int failed = 0;
+  for (const std::string &f : files)
+  {
+    Workout w;
+    std::vector<SwimMachine::Segment> program;
+    if (!readWorkout(dir + "/" + f, w) || (program = WorkoutStorage::program(w)).empty())
+    {
+      printf("%-24s cannot be read\n", f.c_str());
+      failed++;
+      continue;
+    }
+    failed += host::isolated([&] { return play(f, w.name.c_str(), program); });
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,109 @@
+#include "check.h"
+#include "sim_machine.h"
+#include "swim_machine.h"
+#include <math.h>
+
+using WorkoutProgram::Node;
+
+// 47 steps, 49 minutes: a warm-up, a rest, then 20 x (1:30, 1:50) to see
+// whether the boundaries drift over a long set
+static const SwimMachine::Segment kWorkout[] = {
+    {120, 120, 0, 0, 0, 0},
+    {90, 60, 0, 0, 0, 0},
+    {120, 60, 0, 0, 0, 0},
+    {0, 30, 0, 0, 0, 0},
+    {100, 60, 0, 0, 0, 0},
+    {0, 0, 20, 2, 0, 0},
+    {90, 60, 0, 0, 0, 0},
+    {110, 60, 0, 0, 0, 0},
+    {0, 60, 0, 0, 0, 0},
+    {120, 120, 0, 0, 0, 0},
+};
+
+static uint8_t speedFor(uint16_t pace, double k) { return pace ? (uint8_t)round(k / pace) : 0; }
+
+// Plays the workout against a simulated machine and prints, per segment,
+// when the water reached the segment's speed relative to its planned
+// boundary (+ = late). Returns the number of failed checks.
+static int scenario(const char *name, SimMachine::Config cfg, int32_t boundMs)
+{
+  SwimMachine::begin();
+  SimMachine pool(IPAddress(192, 168, 1, 50), cfg);
+  SimMachine::run(2000);
+  CHECK(SwimMachine::isMachineFound());
+
+  std::vector<SwimMachine::Segment> program(std::begin(kWorkout), std::end(kWorkout));
+  SwimMachine::loadWorkout(program);
+  int64_t startUs = host::nowUs();
+  CHECK(SwimMachine::start());
+  for (int s = 0; s < 60 * 60 && SwimMachine::getStatus().active; ++s)
+    SimMachine::run(1000);
+  CHECK(!SwimMachine::getStatus().active);
+
+  std::vector<SwimMachine::SegmentReport> report = SwimMachine::getSegmentReport();
+  SwimMachine::ProtocolStats ps = SwimMachine::getProtocolStats();
+  printf("%s: ramp learned %u/%u ms per unit up/down, K %u, %u retransmits\n", name,
+         ps.rampUpMsPerUnit, ps.rampDownMsPerUnit, (unsigned)ps.speedPaceK, (unsigned)ps.retransmits);
+  printf("%4s %5s %6s %10s %8s %9s %9s\n", "step", "pace", "speed", "planned s", "lead ms", "error ms", "reported");
+
+  int32_t worstLate = 0, worstEarly = 0;
+  int64_t errSum = 0;
+  int errCount = 0;
+  int64_t plannedSumMs = 0;
+  uint32_t prevDur = 0;
+  size_t i = 0;
+  for (auto c = WorkoutProgram::first(program); !c.done; WorkoutProgram::next(program, c), ++i)
+  {
+    if (!CHECK(i + 1 < report.size()))
+      break;
+    const SwimMachine::SegmentReport &r = report[i];
+    // boundaries are planned from the start: no drift however long the workout
+    if (i == 0)
+      plannedSumMs = r.plannedMs;
+    CHECK_EQ((int64_t)r.plannedMs, plannedSumMs);
+    plannedSumMs += c.durSec * 1000;
+
+    // when the water got to this segment's speed: searched from the
+    // earliest the commands can go out (half the previous segment ahead)
+    uint8_t speed = speedFor(c.pace100s, cfg.k);
+    int64_t boundaryUs = startUs + (int64_t)r.plannedMs * 1000;
+    int64_t fromUs = i ? boundaryUs - prevDur * 500000LL : startUs;
+    int64_t atUs = -1;
+    for (const SimMachine::Reached &e : pool.reached())
+      if (e.us >= fromUs && e.speed == speed)
+      {
+        atUs = e.us;
+        break;
+      }
+    prevDur = c.durSec;
+    if (!CHECK(atUs >= 0))
+      continue;
+    int32_t err = (int32_t)((atUs - boundaryUs) / 1000);
+    printf("%4zu %5u %6u %10.1f %8d %9d %9d\n", i, c.pace100s, speed, r.plannedMs / 1000.0,
+           (int)((int64_t)r.plannedMs - r.issuedMs), err, r.atSpeedMs < 0 ? -1 : (int)(r.atSpeedMs - r.plannedMs));
+    if (i >= 3) // the ramp model has seen an up and a down ramp
+    {
+      worstLate = std::max(worstLate, err);
+      worstEarly = std::min(worstEarly, err);
+      errSum += err;
+      errCount++;
+    }
+  }
+  CHECK_EQ(i, (size_t)47);
+  printf("%s: after the first three steps the water was at speed between %d ms early and %d ms late, %+d ms on average\n",
+         name, -worstEarly, worstLate, errCount ? (int)(errSum / errCount) : 0);
+  CHECK(worstLate <= boundMs);
+  CHECK(-worstEarly <= boundMs);
+  return check::report(name);
+}
+
+int main()
+{
+  int failed = 0;
+  failed += host::isolated([] { return scenario("lookahead", SimMachine::Config(), 400); });
+
+  SimMachine::Config lossy;
+  lossy.loss = 0.05;
+  failed += host::isolated([&] { return scenario("lookahead, 5% loss", lossy, 600); });
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,193 @@
+#include "check.h"
+#include "sim_machine.h"
+#include "swim_machine.h"
+
+static IPAddress lan(uint8_t host) { return IPAddress(192, 168, 1, host); }
+
+static SimMachine::Config phase(uint32_t ms)
+{
+  SimMachine::Config c;
+  c.phaseMs = ms;
+  return c;
+}
+
+static std::vector<SwimMachine::Segment> workout()
+{
+  return {{100, 120, 0, 0, 0, 0}, {90, 120, 0, 0, 0, 0}};
+}
+
+static bool sent(const SimMachine &s, uint8_t opcode)
+{
+  for (const SimMachine::Command &c : s.commands())
+    if (c.opcode == opcode)
+      return true;
+  return false;
+}
+
+// Machines get slots in the order they are first heard, and each slot's
+// commands reach only its own machine
+static int lanes()
+{
+  SwimMachine::begin();
+  SimMachine a(lan(50), phase(100)), b(lan(51), phase(200));
+  SimMachine::run(1000);
+  CHECK_EQ(SwimMachine::machineCount(), 2u);
+  CHECK(SwimMachine::machineIP(0) == lan(50));
+  CHECK(SwimMachine::machineIP(1) == lan(51));
+  CHECK(SwimMachine::isMachineFound(1));
+
+  SwimMachine::loadWorkout(workout(), 1);
+  CHECK(SwimMachine::start(1));
+  SimMachine::run(5000);
+  CHECK(b.on());
+  CHECK_EQ(b.pace(), 100);
+  CHECK(a.commands().empty());
+  CHECK_EQ(a.received(), 0u); // unicast, not broadcast
+
+  SwimMachine::stop(1);
+  SimMachine::run(2000);
+  CHECK(!b.on());
+  CHECK(a.commands().empty());
+  return check::report("machines: lanes");
+}
+
+// A new machine appearing while lane 0 has a dropout takes a free slot,
+// never lane 0 while its workout runs; an idle lost slot is handed over
+// without the commands queued for its previous machine
+static int dropout()
+{
+  SwimMachine::begin();
+  SimMachine a(lan(50), phase(100)), b(lan(51), phase(200));
+  SimMachine::run(1000);
+  SwimMachine::loadWorkout(workout(), 0);
+  CHECK(SwimMachine::start(0));
+  SimMachine::run(5000);
+  CHECK(a.on());
+
+  a.setOnline(false);
+  SimMachine::run(6000);
+  CHECK(!SwimMachine::isMachineFound(0));
+  CHECK(SwimMachine::getStatus(0).active);
+
+  SimMachine c(lan(52), phase(50));
+  SimMachine::run(1000);
+  CHECK(SwimMachine::machineIP(0) == lan(50));
+  CHECK(SwimMachine::machineIP(2) == lan(52));
+  SimMachine d(lan(53), phase(60));
+  SimMachine::run(1000);
+  CHECK(SwimMachine::machineIP(3) == lan(53));
+
+  // all four slots taken, lane 0 lost but busy: the fifth gets none
+  SimMachine e(lan(54), phase(70));
+  SimMachine::run(1000);
+  CHECK(SwimMachine::machineIP(0) == lan(50));
+  CHECK(SwimMachine::getProtocolStats(0).rxNoSlot > 0);
+  CHECK(SwimMachine::getStatus(0).active);
+
+  // stopped, lane 0 is idle: the stop still pending for 192.168.1.50 is
+  // dropped with the slot, the new machine does not get it
+  SwimMachine::stop(0);
+  SimMachine::run(3000);
+  CHECK(SwimMachine::machineIP(0) == lan(54));
+  CHECK(SwimMachine::isMachineFound(0));
+  CHECK(e.commands().empty());
+  CHECK(!sent(b, 0x21) && !sent(c, 0x21) && !sent(d, 0x21));
+  CHECK_EQ(SwimMachine::getProtocolStats(0).txQueued, 0u);
+  return check::report("machines: dropout");
+}
+
+// The lane map restored at boot (bindMachine) wins over arrival order
+static int rebind()
+{
+  SwimMachine::begin();
+  SwimMachine::bindMachine(lan(61), 0);
+  SwimMachine::bindMachine(lan(60), 2);
+  SwimMachine::bindMachine(lan(60), 1); // already has a slot
+  SwimMachine::bindMachine(lan(62), 0); // slot taken
+  CHECK(SwimMachine::machineIP(1) == IPAddress(0, 0, 0, 0));
+  CHECK(SwimMachine::machineIP(0) == lan(61));
+
+  SimMachine a(lan(60), phase(100)), b(lan(61), phase(200)), c(lan(62), phase(150));
+  SimMachine::run(1000);
+  CHECK(SwimMachine::machineIP(0) == lan(61));
+  CHECK(SwimMachine::machineIP(1) == lan(62));
+  CHECK(SwimMachine::machineIP(2) == lan(60));
+  CHECK(SwimMachine::isMachineFound(0) && SwimMachine::isMachineFound(1) && SwimMachine::isMachineFound(2));
+  CHECK_EQ(SwimMachine::machineCount(), 3u);
+  return check::report("machines: rebind");
+}
+
+// A lone pool that comes back from a new address (DHCP renew) keeps its
+// lane, and so does one whose stored address is stale after a reboot; with
+// several pools bound, a new address still takes a free slot
+static int newAddress()
+{
+  SwimMachine::begin();
+  SimMachine a(lan(50), phase(100));
+  SimMachine::run(1000);
+  CHECK(SwimMachine::machineIP(0) == lan(50));
+  a.setOnline(false);
+  SimMachine::run(6000);
+  CHECK(!SwimMachine::isMachineFound(0));
+
+  SimMachine renewed(lan(70), phase(100));
+  SimMachine::run(1000);
+  CHECK(SwimMachine::machineIP(0) == lan(70));
+  CHECK(SwimMachine::isMachineFound(0));
+  CHECK_EQ(SwimMachine::machineCount(), 1u);
+  CHECK(SwimMachine::machineIP(1) == IPAddress(0, 0, 0, 0));
+  SwimMachine::loadWorkout(workout(), 0);
+  CHECK(SwimMachine::start(0));
+  SimMachine::run(5000);
+  CHECK(renewed.on());
+  SwimMachine::stop(0);
+  SimMachine::run(2000);
+
+  // two pools bound: the lost idle lane keeps its address, the newcomer
+  // gets a slot of its own
+  SimMachine b(lan(51), phase(200));
+  SimMachine::run(1000);
+  CHECK(SwimMachine::machineIP(1) == lan(51));
+  renewed.setOnline(false);
+  SimMachine::run(6000);
+  SimMachine c(lan(71), phase(150));
+  SimMachine::run(1000);
+  CHECK(SwimMachine::machineIP(0) == lan(70));
+  CHECK(SwimMachine::machineIP(2) == lan(71));
+  return check::report("machines: new address");
+}
+
+static int staleBinding()
+{
+  SwimMachine::begin();
+  SwimMachine::bindMachine(lan(50), 0); // stored before the reboot
+  SimMachine a(lan(72), phase(100));
+  SimMachine::run(1000);
+  CHECK(SwimMachine::machineIP(0) == lan(72));
+  CHECK_EQ(SwimMachine::machineCount(), 1u);
+  return check::report("machines: stale binding");
+}
+
+// pinned by setPeerIP(): the slot is not taken over
+static int pinned()
+{
+  SwimMachine::begin();
+  SwimMachine::setPeerIP(lan(50));
+  SimMachine b(lan(73), phase(120));
+  SimMachine::run(1000);
+  CHECK(SwimMachine::machineIP(0) == lan(50));
+  CHECK(SwimMachine::machineIP(1) == lan(73));
+  return check::report("machines: pinned");
+}
+
+int main()
+{
+  int failed = 0;
+  failed += host::isolated(lanes);
+  failed += host::isolated(dropout);
+  failed += host::isolated(rebind);
+  failed += host::isolated(newAddress);
+  failed += host::isolated(staleBinding);
+  failed += host::isolated(pinned);
+  return failed ? 1 : 0;
+}
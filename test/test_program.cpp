@@ -0,0 +1,66 @@
+#include "check.h"
+#include "workout_program.h"
+
+using namespace WorkoutProgram;
+
+// Expanded steps as (pace, duration) pairs
+static std::vector<std::pair<uint16_t, uint16_t>> walk(const Program &p, size_t limit = 1000)
+{
+  std::vector<std::pair<uint16_t, uint16_t>> out;
+  for (Cursor c = first(p); !c.done && out.size() < limit; next(p, c))
+    out.push_back({c.pace100s, c.durSec});
+  return out;
+}
+
+int main()
+{
+  // 2 x (100 @1:40 getting 5 s faster per round, rest 15), then 60 @2:00
+  Program p = {
+      {0, 0, 2, 2, -5, 0},
+      {100, 100, 0, 0, 0, 0},
+      {0, 15, 0, 0, 0, 0},
+      {120, 60, 0, 0, 0, 0},
+  };
+  auto s = walk(p);
+  CHECK_EQ(s.size(), 5u);
+  CHECK(s == (std::vector<std::pair<uint16_t, uint16_t>>{{100, 100}, {0, 15}, {95, 100}, {0, 15}, {120, 60}}));
+  uint32_t steps, activeSec;
+  CHECK(totals(p, steps, activeSec));
+  CHECK_EQ(steps, 5u);
+  CHECK_EQ(activeSec, 260u);
+  CHECK(!totals(p, steps, activeSec, 4));
+
+  // a ramp moves linearly between its paces
+  Cursor c = first({{100, 10, 0, 0, 0, 120}});
+  CHECK_EQ(paceAt(c, 0), 100);
+  CHECK_EQ(paceAt(c, 5000), 110);
+  CHECK_EQ(paceAt(c, 10000), 120);
+  CHECK_EQ(paceAt(c, 60000), 120);
+
+  // blocks with nothing playable are skipped, however many rounds they
+  // claim: the innermost block is past the nesting limit, so every round
+  // of the four around it is empty (WorkoutStorage rejects such programs;
+  // the cursor must still not spin through 65535^4 rounds)
+  Program empty = {
+      {0, 0, 0xFFFF, 5, 0, 0},
+      {0, 0, 0xFFFF, 4, 0, 0},
+      {0, 0, 0xFFFF, 3, 0, 0},
+      {0, 0, 0xFFFF, 2, 0, 0},
+      {0, 0, 0xFFFF, 1, 0, 0},
+      {90, 30, 0, 0, 0, 0},
+      {80, 20, 0, 0, 0, 0},
+  };
+  s = walk(empty);
+  CHECK(s == (std::vector<std::pair<uint16_t, uint16_t>>{{80, 20}}));
+
+  // the same behind a step that is played: only the empty rounds are cut
+  Program mixed = {
+      {0, 0, 3, 3, 0, 0},
+      {70, 10, 0, 0, 0, 0},
+      {0, 0, 0xFFFF, 1, 0, 0},
+      {0, 0, 0xFFFF, 0, 0, 0},
+  };
+  s = walk(mixed);
+  CHECK(s == (std::vector<std::pair<uint16_t, uint16_t>>{{70, 10}, {70, 10}, {70, 10}}));
+  return check::report("program");
+}
@@ -0,0 +1,103 @@
+#include "check.h"
+#include "sim_machine.h"
+#include "swim_machine.h"
+#include <math.h>
+
+// Ramp steps against the simulated machine: the pace it was commanded and
+// the speed of the water, every status period, next to the plan
+
+struct Ramp
+{
+  const char *name;
+  std::vector<SwimMachine::Segment> workout; // step 1 is the ramp
+  double paceBound;  // s/100 m the commanded pace may trail the plan
+  double speedBound; // speed units the water may differ from the plan (whole
+                     // units on the machine, whole seconds in the pace)
+};
+
+static int scenario(const Ramp &r, SimMachine::Config cfg)
+{
+  SwimMachine::begin();
+  SimMachine pool(IPAddress(192, 168, 1, 50), cfg);
+  SimMachine::run(3000);
+  SwimMachine::loadWorkout(r.workout);
+  int64_t startUs = host::nowUs();
+  CHECK(SwimMachine::start());
+  while (SwimMachine::getStatus().active)
+    SimMachine::run(100);
+  SimMachine::run(2000);
+
+  const SwimMachine::Segment &ramp = r.workout[1];
+  std::vector<SwimMachine::SegmentReport> report = SwimMachine::getSegmentReport();
+  if (!CHECK(report.size() >= 3))
+    return check::report(r.name);
+  int64_t fromUs = startUs + (int64_t)report[1].plannedMs * 1000;
+  int64_t durUs = (int64_t)ramp.durSec * 1000000;
+
+  // from 2 s into the ramp (the step change into it has settled) to its end,
+  // or to the first command of the next step when that is sent early
+  int64_t toUs = durUs;
+  for (const SimMachine::Command &c : pool.commands())
+    if (c.us - fromUs > 0 && c.us - fromUs < toUs && c.opcode != 0x24)
+    {
+      toUs = c.us - fromUs;
+      break;
+    }
+  double paceWorst = 0, speedWorst = 0, speedSum = 0;
+  int n = 0;
+  uint16_t prevPace = 0;
+  bool monotonic = true;
+  printf("%s:\n%8s %10s %10s %10s %10s\n", r.name, "s", "plan pace", "commanded", "plan speed", "water");
+  for (const SimMachine::Sample &s : pool.profile())
+  {
+    int64_t el = s.us - fromUs;
+    if (el < 2000000 || el >= toUs)
+      continue;
+    double plan = ramp.pace100s + (double)(ramp.paceEnd100s - ramp.pace100s) * el / durUs;
+    double planSpeed = cfg.k / plan;
+    paceWorst = std::max(paceWorst, std::abs(s.pace100s - plan));
+    speedWorst = std::max(speedWorst, std::abs(s.curSpeed - planSpeed));
+    speedSum += std::abs(s.curSpeed - planSpeed);
+    n++;
+    if (prevPace && (ramp.paceEnd100s > ramp.pace100s ? s.pace100s < prevPace : s.pace100s > prevPace))
+      monotonic = false;
+    prevPace = s.pace100s;
+    if (n % 40 == 1) // every 10 s
+      printf("%8.1f %10.1f %10u %10.1f %10.1f\n", el / 1e6, plan, s.pace100s, planSpeed, s.curSpeed);
+  }
+  SwimMachine::ProtocolStats ps = SwimMachine::getProtocolStats();
+  printf("%s: %u paces streamed, %u steps skipped, %u retransmits; commanded pace within %.1f s/100 m of the plan, "
+         "water within %.2f speed units (%.2f on average)\n",
+         r.name, (unsigned)ps.rampPaceSent, (unsigned)ps.rampPaceSkipped, (unsigned)ps.retransmits, paceWorst, speedWorst, speedSum / n);
+  CHECK(n > 0);
+  CHECK(monotonic);
+  CHECK(paceWorst <= r.paceBound);
+  CHECK(speedWorst <= r.speedBound);
+  // paces go at most once a second; a steeper ramp must skip steps, not fall behind
+  double perSec = std::abs(ramp.paceEnd100s - ramp.pace100s) / (double)ramp.durSec;
+  CHECK(perSec > 1 ? ps.rampPaceSkipped > 0 : ps.rampPaceSkipped == 0);
+  return check::report(r.name);
+}
+
+int main()
+{
+  // a build from 2:00 to 1:30 over 5 minutes: a 1 s/100 m step every 10 s
+  Ramp build = {"ramp: build", {{120, 60, 0, 0, 0, 0}, {120, 300, 0, 0, 0, 90}, {90, 30, 0, 0, 0, 0}}, 1.5, 1.5};
+  // a fade from 1:30 to 2:10 over 2 minutes, one step every 3 s
+  Ramp fade = {"ramp: fade", {{90, 60, 0, 0, 0, 0}, {90, 120, 0, 0, 0, 130}, {0, 30, 0, 0, 0, 0}}, 1.5, 1.5};
+  // 2:10 to 1:10 in 20 s: faster than one command per second can follow
+  // step by step, so steps are skipped to keep up
+  Ramp steep = {"ramp: steep", {{130, 60, 0, 0, 0, 0}, {130, 20, 0, 0, 0, 70}, {70, 30, 0, 0, 0, 0}}, 5.0, 4.0};
+
+  int failed = 0;
+  for (const Ramp &r : {build, fade, steep})
+    failed += host::isolated([&] { return scenario(r, SimMachine::Config()); });
+
+  SimMachine::Config lossy;
+  lossy.loss = 0.1;
+  build.name = "ramp: build, 10% loss";
+  build.paceBound = 2.5;
+  build.speedBound = 2.0;
+  failed += host::isolated([&] { return scenario(build, lossy); });
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+#include "check.h"
+#include "packet_capture.h"
+#include "replay.h"
+#include "sim_machine.h"
+#include <unistd.h>
+
+// A session against the simulated machine, exported from the capture ring
+// as GET /api/capture.pcap would, then replayed: the firmware must send the
+// same commands at the same times, so a trace taken on the device can be
+// replayed to compare two versions
+
+static const std::vector<SwimMachine::Segment> kWorkout = {
+    {100, 30, 0, 0, 0, 0},
+    {80, 20, 0, 0, 0, 0},
+    {0, 15, 0, 0, 0, 0},
+    {120, 30, 0, 0, 0, 0},
+};
+
+static char path[] = "/tmp/test_replay_XXXXXX";
+
+static int record()
+{
+  SwimMachine::begin();
+  SimMachine pool(IPAddress(192, 168, 1, 50));
+  SimMachine::run(3000);
+  SwimMachine::loadWorkout(kWorkout);
+  CHECK(SwimMachine::start());
+  while (SwimMachine::getStatus().active)
+    SimMachine::run(100);
+  SimMachine::run(2000);
+
+  PacketCapture::Cursor c;
+  PacketCapture::startExport(c);
+  FILE *f = fopen(path, "wb");
+  if (!CHECK(f))
+    return 1;
+  uint8_t buf[512];
+  for (size_t n; (n = PacketCapture::read(c, buf, sizeof buf)) > 0;)
+    fwrite(buf, 1, n, f);
+  fclose(f);
+  return check::report("replay: record");
+}
+
+static bool readTrace(std::vector<replay::Packet> &trace)
+{
+  std::vector<uint8_t> file;
+  FILE *f = fopen(path, "rb");
+  if (!f)
+    return false;
+  uint8_t buf[4096];
+  for (size_t n; (n = fread(buf, 1, sizeof buf, f)) > 0;)
+    file.insert(file.end(), buf, buf + n);
+  fclose(f);
+  return replay::load(file, trace);
+}
+
+static int replayed(bool echo)
+{
+  std::vector<replay::Packet> trace;
+  if (!CHECK(readTrace(trace)))
+    return 1;
+  std::vector<replay::Command> rec = replay::recorded(trace);
+  CHECK(rec.size() >= 8);
+
+  replay::Options opt;
+  opt.echo = echo;
+  opt.workout = kWorkout;
+  std::vector<replay::Command> log = replay::run(trace, opt);
+  CHECK_EQ(log.size(), rec.size());
+  int64_t worst = 0;
+  for (size_t i = 0; i < log.size() && i < rec.size(); ++i)
+  {
+    if (!CHECK(log[i].opcode == rec[i].opcode && log[i].param == rec[i].param && log[i].idx2 == rec[i].idx2))
+      break;
+    worst = std::max(worst, std::abs(log[i].us - rec[i].us));
+  }
+  CHECK(worst <= 10000); // the start() call lands on a different 5 ms poll
+  printf("replay%s: %zu commands as recorded, at most %lld us apart\n", echo ? " --echo" : "",
+         log.size(), (long long)worst);
+  return check::report(echo ? "replay: echo" : "replay: as recorded");
+}
+
+int main()
+{
+  int fd = mkstemp(path);
+  if (fd < 0)
+    return 1;
+  close(fd);
+  int failed = host::isolated(record);
+  failed += host::isolated([] { return replayed(false); });
+  failed += host::isolated([] { return replayed(true); });
+  unlink(path);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+#include "check.h"
+#include "workout_storage.h"
+#include <string>
+
+using namespace WorkoutStorage;
+
+// WorkoutStorage's JSON codec at its limits: what from_json() accepts,
+// to_json() must write and from_json() read back the same, so a workout
+// that was uploaded is never lost when it is saved or loaded again.
+
+static Workout parse(const std::string &j, bool &ok)
+{
+  Workout w;
+  ok = from_json((const uint8_t *)j.data(), j.size(), w);
+  return w;
+}
+
+static bool roundTrip(const Workout &w)
+{
+  String j = to_json(w);
+  if (!CHECK(j.length() > 0))
+    return false;
+  Workout back;
+  if (!CHECK(from_json((const uint8_t *)j.c_str(), j.length(), back)))
+    return false;
+  CHECK(back.id == w.id);
+  CHECK(back.name == w.name);
+  if (!CHECK_EQ(back.steps.size(), w.steps.size()))
+    return false;
+  for (size_t i = 0; i < w.steps.size(); ++i)
+  {
+    const SwimStep &a = w.steps[i], &b = back.steps[i];
+    CHECK(a.pace100s == b.pace100s && a.paceEnd100s == b.paceEnd100s && a.durSec == b.durSec);
+    CHECK(a.repeat == b.repeat && a.body == b.body && a.paceStep == b.paceStep);
+    CHECK(a.note == b.note);
+  }
+  CHECK(to_json(back) == j);
+  return true;
+}
+
+// n bytes of note, two-byte characters included
+static std::string note(size_t n, char tag)
+{
+  std::string s;
+  while (s.size() + 2 <= n)
+    s += s.size() % 6 ? std::string(1, tag) : std::string("\xC3\xA9"); // é
+  while (s.size() < n)
+    s += tag;
+  return s;
+}
+
+static std::string step(uint32_t pace, uint32_t paceEnd, uint32_t dur, const std::string &n)
+{
+  std::string s = "{\"speed\":" + std::to_string(pace);
+  if (paceEnd)
+    s += ",\"speed_end\":" + std::to_string(paceEnd);
+  return s + ",\"dur\":" + std::to_string(dur) + ",\"note\":\"" + n + "\"}";
+}
+
+// kMaxSteps entries: blocks nested kMaxDepth deep around swims and rests,
+// every note kMaxNoteLen bytes, the title kMaxTitleLen, paces and
+// durations at their maximum
+static std::string atLimits(size_t entries, uint8_t depth)
+{
+  std::string j = "{\"id\":\"1750867563160\",\"title\":\"" + note(kMaxTitleLen, 't') + "\",\"swims\":[";
+  for (uint8_t d = 0; d < depth; ++d)
+    j += "{\"repeat\":1,\"pace_step\":-1,\"note\":\"" + note(kMaxNoteLen, 'b') + "\",\"swims\":[";
+  for (size_t i = depth; i < entries; ++i)
+  {
+    if (i > depth)
+      j += ",";
+    uint32_t pace = i % 3 == 2 ? 0 : kMaxPace100s;
+    j += step(pace, i % 3 == 1 ? kMaxPace100s - 100 : 0, kMaxStepSec, note(kMaxNoteLen, 'a' + i % 26));
+  }
+  for (uint8_t d = 0; d < depth; ++d)
+    j += "]}";
+  return j + "]}";
+}
+
+static int limits()
+{
+  bool ok;
+  Workout w = parse(atLimits(kMaxSteps, kMaxDepth), ok);
+  CHECK(ok);
+  CHECK_EQ(w.steps.size(), kMaxSteps);
+  CHECK_EQ(w.name.length(), kMaxTitleLen);
+  CHECK_EQ(w.steps.back().note.length(), kMaxNoteLen);
+  CHECK_EQ(w.steps[kMaxDepth - 1].repeat, 1);
+  CHECK_EQ(w.steps[kMaxDepth - 1].body, kMaxSteps - kMaxDepth);
+  roundTrip(w);
+  printf("storage: %zu entries, %u deep, %zu bytes of JSON\n", w.steps.size(), (unsigned)kMaxDepth,
+         (size_t)to_json(w).length());
+
+  parse(atLimits(kMaxSteps + 1, kMaxDepth), ok);
+  CHECK(!ok); // one entry too many
+  parse(atLimits(kMaxSteps, kMaxDepth + 1), ok);
+  CHECK(!ok); // nested one level too deep
+  return check::report("storage: limits");
+}
+
+// longer text is cut (never inside a character), and what is cut reads back
+static int longText()
+{
+  std::string j = "{\"id\":\"7\",\"title\":\"" + note(3 * kMaxTitleLen, 't') + "\",\"swims\":[" +
+                  step(100, 0, 60, note(3 * kMaxNoteLen, 'x')) + "," + step(0, 0, 30, note(kMaxNoteLen + 1, 'y')) + "]}";
+  bool ok;
+  Workout w = parse(j, ok);
+  CHECK(ok);
+  CHECK(w.name.length() <= kMaxTitleLen && w.name.length() >= kMaxTitleLen - 1);
+  for (const SwimStep &s : w.steps)
+    CHECK(s.note.length() <= kMaxNoteLen && s.note.length() >= kMaxNoteLen - 1);
+  roundTrip(w);
+  return check::report("storage: long text");
+}
+
+// the saved library reads, writes and reads back the same
+static int library()
+{
+  for (const char *f : {"1750867563160", "1750942801592", "1751205737071"})
+  {
+    std::string path = std::string("../data/workouts/") + f + ".json";
+    FILE *in = fopen(path.c_str(), "rb");
+    if (!CHECK(in))
+      continue;
+    std::string j;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof buf, in)) > 0)
+      j.append(buf, n);
+    fclose(in);
+    bool ok;
+    Workout w = parse(j, ok);
+    CHECK(ok && !w.steps.empty());
+    CHECK(w.id == String(f));
+    roundTrip(w);
+  }
+  return check::report("storage: library");
+}
+
+int main()
+{
+  int failed = limits();
+  failed += longText();
+  failed += library();
+  return failed ? 1 : 0;
+}
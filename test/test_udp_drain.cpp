@@ -0,0 +1,134 @@
+#include "check.h"
+#include "UDPEventSender.h"
+
+static const uint16_t kPort = 45654;
+static const IPAddress kGroup(239, 255, 0, 1);
+
+static hostnet::Datagram datagram(size_t len, uint8_t tag, uint32_t stamp = 0)
+{
+  hostnet::Datagram d{IPAddress(192, 168, 1, 50), 45654, kGroup, kPort, std::vector<uint8_t>(len)};
+  d.data[0] = tag;
+  if (len >= 8)
+    memcpy(&d.data[4], &stamp, 4);
+  return d;
+}
+
+// loop() drains up to the budget per call, and an oversized datagram does
+// not hold up the ones behind it
+static void testDrain()
+{
+  UDPEventSender s;
+  s.begin(kGroup, kPort, kPort);
+  size_t got = 0;
+  s.onReceive([&](const uint8_t *, size_t, const IPAddress &, uint16_t) { got++; });
+
+  for (int i = 0; i < 40; ++i)
+    hostnet::inject(datagram(111, 0x0A));
+  s.loop();
+  CHECK_EQ(got, 16u);
+  CHECK_EQ(s.stats().budgetHits, 1u);
+  s.loop();
+  s.loop();
+  CHECK_EQ(got, 40u);
+  CHECK_EQ(s.stats().polls, 3u);
+  CHECK_EQ(s.stats().maxBatch, 16u);
+  CHECK_EQ(s.stats().budgetHits, 2u);
+  s.loop(); // nothing queued: not a poll
+  CHECK_EQ(s.stats().polls, 3u);
+
+  s.setReceiveBudget(0); // clamped to 1
+  hostnet::inject(datagram(111, 0x0A));
+  hostnet::inject(datagram(111, 0x0A));
+  s.loop();
+  CHECK_EQ(got, 41u);
+  s.setReceiveBudget(16);
+
+  size_t lastLen = 0;
+  s.onReceive([&](const uint8_t *, size_t len, const IPAddress &, uint16_t) { lastLen = len; got++; });
+  hostnet::inject(datagram(2000, 0x55));
+  hostnet::inject(datagram(111, 0x0A));
+  s.loop();
+  CHECK_EQ(got, 44u); // the left-over one, the cut one and the one behind it
+  CHECK_EQ(lastLen, 111u);
+  CHECK_EQ(s.stats().truncated, 1u);
+}
+
+struct Result
+{
+  uint32_t sent, handled, lost;
+  double meanMs;
+  uint32_t maxMs;
+};
+
+// Status packets every 250 ms among `foreignPerSec` other datagrams on the
+// group, polled every pollMs with the given budget: how long each status
+// packet waits in the socket before the handler (and thus the next
+// command) sees it, and how many the full receive queue drops.
+static Result flood(uint32_t pollMs, uint8_t budget, uint32_t foreignPerSec)
+{
+  const uint32_t kRunMs = 60000;
+  UDPEventSender s;
+  s.begin(kGroup, kPort, kPort);
+  s.setReceiveBudget(budget);
+  uint32_t now = 0;
+  Result r = {};
+  uint64_t sum = 0;
+  s.onReceive([&](const uint8_t *d, size_t, const IPAddress &, uint16_t) {
+    if (d[0] != 0x0A)
+      return;
+    uint32_t stamp;
+    memcpy(&stamp, d + 4, 4);
+    uint32_t wait = now - stamp;
+    r.handled++;
+    sum += wait;
+    if (wait > r.maxMs)
+      r.maxMs = wait;
+  });
+
+  uint32_t foreignDue = 0; // in 1/foreignPerSec ms steps
+  for (now = 0; now < kRunMs; ++now)
+  {
+    foreignDue += foreignPerSec;
+    for (; foreignDue >= 1000; foreignDue -= 1000)
+      hostnet::inject(datagram(111, 0x55));
+    if (now % 250 == 0)
+    {
+      hostnet::inject(datagram(111, 0x0A, now));
+      r.sent++;
+    }
+    if (now % pollMs == 0)
+      s.loop();
+  }
+  r.lost = r.sent - r.handled; // the few still queued count as lost too
+  r.meanMs = r.handled ? (double)sum / r.handled : 0;
+  return r;
+}
+
+int main()
+{
+  testDrain();
+
+  // the ESP32's lwIP queues 6 datagrams per UDP socket
+  // (CONFIG_LWIP_UDP_RECVMBOX_SIZE)
+  hostnet::queueLimit = 6;
+  printf("status packet wait in the socket (60 s, status every 250 ms):\n");
+  printf("%-28s %8s %6s %8s %6s\n", "", "other/s", "lost", "mean ms", "max ms");
+  const uint32_t rates[] = {0, 40, 200, 800};
+  for (uint32_t rate : rates)
+  {
+    Result before = flood(250, 1, rate); // one datagram per 250 ms tick
+    Result single = flood(5, 1, rate);   // protocol task, one per poll
+    Result after = flood(5, 16, rate);   // protocol task, drained per poll
+    printf("%-28s %8u %6u %8.1f %6u\n", "before: 250 ms, 1 per poll", rate, before.lost, before.meanMs, before.maxMs);
+    printf("%-28s %8u %6u %8.1f %6u\n", "5 ms, 1 per poll", rate, single.lost, single.meanMs, single.maxMs);
+    printf("%-28s %8u %6u %8.1f %6u\n", "after: 5 ms, budget 16", rate, after.lost, after.meanMs, after.maxMs);
+
+    // draining keeps up: nothing lost, and no packet waits past one poll
+    CHECK_EQ(after.lost, 0u);
+    CHECK(after.maxMs < 5);
+    if (rate >= 40)
+      CHECK(before.lost > 0);
+  }
+
+  return check::report("udp_drain");
+}
@@ -0,0 +1,215 @@
+#include "check.h"
+#include "sim_machine.h"
+#include "swim_machine.h"
+
+/* Workouts across the points where the ESP32's 32-bit clocks wrap:
+   millis() after 2^32 ms (49.7 days) and micros() every 2^32 us (71.6
+   minutes). The millis() wrap is a micros() wrap too (2^32 ms = 1000 x
+   2^32 us). The workout clock is 64-bit and does not wrap; the network
+   timing (RTO, link timeout) and the 32-bit packet timestamp do. */
+
+static const int64_t kMillisWrapUs = 4294967296LL * 1000;
+static const int64_t kMicrosWrapUs = 4294967296LL;
+
+static const SwimMachine::Segment kWorkout[] = {
+    {100, 30, 0, 0, 0, 0},
+    {80, 30, 0, 0, 0, 0},
+    {0, 20, 0, 0, 0, 0},
+    {120, 30, 0, 0, 0, 0},
+    {90, 30, 0, 0, 0, 0},
+    {110, 30, 0, 0, 0, 0},
+};
+
+// Timestamps (bytes 32-35) of the commands sent, with the clock at the time
+struct Stamp
+{
+  int64_t us;
+  uint32_t tick;
+};
+
+static std::vector<Stamp> stamps;
+
+static void recordStamps()
+{
+  auto forward = hostnet::onSend;
+  hostnet::onSend = [forward](const hostnet::Datagram &d) {
+    if (d.dstPort == 9750 && d.data.size() == 44)
+    {
+      uint32_t t;
+      memcpy(&t, &d.data[32], 4);
+      stamps.push_back({host::nowUs(), t});
+    }
+    forward(d);
+  };
+}
+
+// The packet timestamp counts ms since boot in 32 bits: it wraps with
+// millis(), but never falls behind it or repeats
+static void checkStamps()
+{
+  CHECK(stamps.size() >= 5);
+  for (size_t i = 0; i < stamps.size(); ++i)
+  {
+    uint32_t ms = (uint32_t)(stamps[i].us / 1000);
+    if (!CHECK((int32_t)(stamps[i].tick - ms) >= 0 && (int32_t)(stamps[i].tick - ms) < 10))
+    {
+      printf("  command %zu at %u ms stamped %u\n", i, (unsigned)ms, (unsigned)stamps[i].tick);
+      break;
+    }
+    if (i && !CHECK((int32_t)(stamps[i].tick - stamps[i - 1].tick) > 0))
+      break;
+  }
+}
+
+// Plays the workout with the wrap `beforeWrapS` into it; returns failed
+// checks. At 109 s the wrap falls between the commands for step 4 going
+// out and its boundary.
+static int across(const char *name, int64_t wrapUs, uint32_t beforeWrapS, SimMachine::Config cfg)
+{
+  host::setNowUs(wrapUs - (beforeWrapS + 3) * 1000000LL);
+  SwimMachine::begin();
+  SimMachine pool(IPAddress(192, 168, 1, 50), cfg);
+  recordStamps();
+  SimMachine::run(3000);
+  CHECK(SwimMachine::isMachineFound());
+
+  std::vector<SwimMachine::Segment> program(std::begin(kWorkout), std::end(kWorkout));
+  SwimMachine::loadWorkout(program);
+  int64_t startUs = host::nowUs();
+  CHECK(SwimMachine::start());
+  bool alwaysFound = true;
+  uint32_t maxLinkAge = 0, maxRto = 0;
+  for (int ds = 0; ds < 10 * 60 * 5 && SwimMachine::getStatus().active; ++ds)
+  {
+    SimMachine::run(100);
+    SwimMachine::SwimStatus st = SwimMachine::getStatus();
+    alwaysFound = alwaysFound && st.found;
+    maxLinkAge = std::max(maxLinkAge, st.linkAgeMs);
+    maxRto = std::max(maxRto, SwimMachine::getProtocolStats().rtoMs);
+  }
+  CHECK(host::nowUs() > wrapUs + 30 * 1000000LL); // the wrap was crossed with time to spare
+  CHECK(!SwimMachine::getStatus().active);
+  SimMachine::run(3000);
+  CHECK(!pool.on());
+
+  // the link held and the RTO stayed where it was
+  CHECK(alwaysFound);
+  CHECK(maxLinkAge < 1000);
+  CHECK(maxRto <= 1000);
+
+  // every segment on time, including the one across the wrap
+  std::vector<SwimMachine::SegmentReport> report = SwimMachine::getSegmentReport();
+  if (!CHECK_EQ(report.size(), program.size() + 1))
+    return check::report(name);
+  int64_t plannedMs = report[0].plannedMs; // after the start-up lead
+  int32_t worst = 0;
+  for (size_t i = 0; i < program.size(); ++i)
+  {
+    CHECK_EQ((int64_t)report[i].plannedMs, plannedMs);
+    int64_t boundaryUs = startUs + plannedMs * 1000;
+    plannedMs += program[i].durSec * 1000;
+    uint8_t speed = program[i].pace100s ? (uint8_t)round(cfg.k / program[i].pace100s) : 0;
+    int64_t fromUs = i ? boundaryUs - program[i - 1].durSec * 500000LL : startUs;
+    int64_t atUs = -1;
+    for (const SimMachine::Reached &e : pool.reached())
+      if (e.us >= fromUs && e.speed == speed)
+      {
+        atUs = e.us;
+        break;
+      }
+    if (!CHECK(atUs >= 0))
+      continue;
+    if (i >= 3) // the ramp model has seen an up and a down ramp
+      worst = std::max(worst, (int32_t)std::abs((atUs - boundaryUs) / 1000));
+  }
+  CHECK(worst <= 600);
+  checkStamps();
+
+  SwimMachine::ProtocolStats ps = SwimMachine::getProtocolStats();
+  printf("%s: %zu commands, %u acks, %u retransmits, RTO up to %u ms, water at speed within %d ms of each boundary\n",
+         name, stamps.size(), (unsigned)ps.ackCount, (unsigned)ps.retransmits, (unsigned)maxRto, worst);
+  return check::report(name);
+}
+
+// Paused before the wrap, resumed after it: the pause is counted once and
+// the rest of the workout moves by exactly its length
+static int pauseAcross()
+{
+  host::setNowUs(kMillisWrapUs - 33 * 1000000LL);
+  SwimMachine::begin();
+  SimMachine pool(IPAddress(192, 168, 1, 50));
+  recordStamps();
+  SimMachine::run(3000);
+
+  SwimMachine::loadWorkout({{100, 60, 0, 0, 0, 0}});
+  int64_t startUs = host::nowUs();
+  CHECK(SwimMachine::start());
+  SimMachine::run(20000);
+  SwimMachine::setPaused(true);
+  SimMachine::run(3000);
+  CHECK(!pool.on());
+  SimMachine::run(17000); // across the wrap
+  CHECK(host::nowUs() > kMillisWrapUs);
+  SwimMachine::SwimStatus st = SwimMachine::getStatus();
+  CHECK(st.paused && st.active);
+  CHECK(st.pausedMs >= 19990 && st.pausedMs <= 20010);
+  CHECK(st.workoutMs >= 19990 && st.workoutMs <= 20010);
+
+  SwimMachine::setPaused(false);
+  int64_t endUs = -1;
+  for (int ds = 0; ds < 600 && endUs < 0; ++ds)
+  {
+    SimMachine::run(100);
+    if (!SwimMachine::getStatus().active)
+      endUs = host::nowUs();
+  }
+  CHECK(endUs >= 0);
+  int64_t total = (endUs - startUs) / 1000 - SwimMachine::getSegmentReport()[0].plannedMs;
+  CHECK(total >= 80000 && total <= 80000 + 100); // 60 s swum + 20 s paused, in 100 ms polls
+  checkStamps();
+  printf("pause across the wrap: workout ended %lld ms after start\n", (long long)total);
+  return check::report("wrap: pause");
+}
+
+// A command unacknowledged across the micros() wrap is resent on its RTO
+// with backoff: not at once, not after 71 minutes
+static int resendAcross()
+{
+  host::setNowUs(kMicrosWrapUs - 10 * 1000000LL);
+  SwimMachine::begin();
+  SimMachine pool(IPAddress(192, 168, 1, 50));
+  SimMachine::run(3000);
+  SwimMachine::loadWorkout({{100, 60, 0, 0, 0, 0}});
+  CHECK(SwimMachine::start());
+  SimMachine::run(6000);
+  CHECK(pool.on());
+
+  pool.setOnline(false);
+  SwimMachine::stop();
+  uint32_t before = SwimMachine::getProtocolStats().retransmits;
+  SimMachine::run(4000); // the wrap is 1 s in
+  CHECK(host::nowUs() > kMicrosWrapUs);
+  uint32_t resent = SwimMachine::getProtocolStats().retransmits - before;
+  CHECK(resent >= 1 && resent <= 4);
+  CHECK(pool.on());
+
+  pool.setOnline(true);
+  SimMachine::run(5000); // the RTO has backed off, at most RTO_MAX_MS
+  CHECK(!pool.on());
+  CHECK_EQ(SwimMachine::getProtocolStats().txQueued, 0u);
+  uint32_t after = SwimMachine::getProtocolStats().retransmits - before;
+  printf("resend across the wrap: %u retransmits while the machine was away, %u in all\n",
+         (unsigned)resent, (unsigned)after);
+  return check::report("wrap: resend");
+}
+
+int main()
+{
+  int failed = 0;
+  failed += host::isolated([] { return across("wrap: millis", kMillisWrapUs, 109, SimMachine::Config()); });
+
+  failed += host::isolated([] { return across("wrap: micros", kMicrosWrapUs, 109, SimMachine::Config()); });
+  failed += host::isolated(resendAcross);
+  failed += host::isolated(pauseAcross);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include "workout_storage.h"
+#include <stdio.h>
+#include <string>
+
+/* A saved workout file read the way the firmware reads one: the bytes
+   through WorkoutStorage::from_json(), with its limits, and the program
+   from WorkoutStorage::program(). */
+inline bool readWorkout(const std::string &path, Workout &w)
+{
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  std::string text;
+  char buf[4096];
+  for (size_t n; (n = fread(buf, 1, sizeof buf, f)) > 0;)
+    text.append(buf, n);
+  fclose(f);
+  return WorkoutStorage::from_json((const uint8_t *)text.data(), text.size(), w);
+}
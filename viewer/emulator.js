@@ -0,0 +1,196 @@
+/* -----  emulator.js  -----------------------------------------------
+   Stand-in for an Endless Pools machine: takes the 44-byte commands on
+   UDP 9750 and answers with 111-byte status packets on the multicast
+   group, with a speed ramp, a workout countdown and idx2 echo.
+
+   Run with:  node emulator.js [--interval 250] [--k 6000]
+                               [--ramp-up 150] [--ramp-down 100]
+                               [--loss 0] [--warp 1] [--quiet]
+                               [--profile speed.csv]
+               node emulator.js --trace commands.txt [options]
+
+   --interval   ms between status packets (the machine sends ~4/s)
+   --k          speed * pace100s (speed ~ 1/pace)
+   --ramp-up    ms per speed unit when speeding up
+   --ramp-down  ms per speed unit when slowing down
+   --loss       probability (0..1) of dropping a command or status packet
+   --warp       run the machine N times faster, to match a controller
+                built with SWIM_CLOCK_WARP (POST /api/clock?warp=N)
+   --profile    write one CSV row per status packet (machine time, pace,
+                target and current speed, commands so far): the speed
+                profile a workout actually produced, e.g. to check that a
+                ramp step (speed -> speed_end) is tracked
+   --trace      no sockets: play the commands in the file on the model,
+                1 ms at a time, and print every status packet as
+                "<ms> <hex>". Each line of the file is "<ms> <hex>", one
+                44-byte command. test/test_emulator.cpp feeds the same trace
+                to test/sim_machine.h and compares. --loss is ignored.
+
+   Point the controller at it with no real machine on the network: the
+   controller learns this host's address from the status packets.
+--------------------------------------------------------------------*/
+import dgram from 'dgram';
+import fs    from 'fs';
+
+const MCAST_ADDR = '239.255.0.1';
+const STATUS_PORT = 45654;
+const CMD_PORT = 9750;
+
+/* ---------- arguments -------------------------------------------- */
+const cfg = { interval: 250, k: 6000, 'ramp-up': 150, 'ramp-down': 100, loss: 0, warp: 1, quiet: false, profile: null, trace: null };
+for (const args = process.argv.slice(2); args.length;) {
+  const a = args.shift().replace(/^--/, '');
+  if (a === 'quiet') cfg.quiet = true;
+  else if (a === 'profile') cfg.profile = args.shift();
+  else if (a === 'trace') cfg.trace = args.shift();
+  else if (a in cfg) cfg[a] = Number(args.shift());
+  else { console.error('unknown option --' + a); process.exit(1); }
+}
+const log = (...m) => { if (!cfg.quiet) console.log(new Date().toISOString().slice(11, 23), ...m); };
+
+/* ---------- CRC-32 (same framing as crc32.cpp) -------------------- */
+const CRC_TABLE = new Uint32Array(256).map((_, i) => {
+  let c = i;
+  for (let k = 0; k < 8; k++) c = c & 1 ? (c >>> 1) ^ 0xEDB88320 : c >>> 1;
+  return c >>> 0;
+});
+function crc32(buf, n) {
+  let c = 0xFFFFFFFF;
+  for (let i = 0; i < n; i++) c = CRC_TABLE[(c ^ buf[i]) & 0xFF] ^ (c >>> 8);
+  return (c ^ 0xFFFFFFFF) >>> 0;
+}
+
+/* ---------- machine model ---------------------------------------- */
+const m = {
+  on: false,
+  pace100s: 0,      // last Set Pace
+  durationSec: 0,   // last Set Duration
+  remainingMs: 0,
+  curSpeed: 0,      // float while ramping, reported rounded
+  runtimeSec: 0,    // this workout
+  totalRuntimeSec: 0,
+  msgId: 0,         // idx2 of the last command accepted
+  state: 0x08,      // idle off
+  commands: 0,      // commands accepted
+  clockMs: 0        // machine time (warped)
+};
+
+const profile = cfg.profile ? fs.createWriteStream(cfg.profile) : null;
+profile?.write('ms,state,pace100s,tgt_speed,cur_speed,commands\n');
+
+const targetSpeed = () => (m.on && m.pace100s ? Math.min(255, Math.round(cfg.k / m.pace100s)) : 0);
+
+function onCommand(cmd, param) {
+  switch (cmd) {
+    case 0x1F: // Start
+      if (!m.on) { m.on = true; m.remainingMs = m.durationSec * 1000; m.runtimeSec = 0; }
+      break;
+    case 0x21: // Stop
+      m.on = false;
+      break;
+    case 0x24: // Set Pace
+      m.pace100s = param;
+      break;
+    case 0x25: // Set Duration
+      m.durationSec = param;
+      m.remainingMs = param * 1000;
+      break;
+    default:
+      log(`unhandled command 0x${cmd.toString(16)}`);
+  }
+}
+
+function step(dtMs) {
+  const tgt = targetSpeed();
+  m.clockMs += dtMs;
+  if (m.curSpeed < tgt) m.curSpeed = Math.min(tgt, m.curSpeed + dtMs / cfg['ramp-up']);
+  else if (m.curSpeed > tgt) m.curSpeed = Math.max(tgt, m.curSpeed - dtMs / cfg['ramp-down']);
+
+  if (m.on) {
+    m.runtimeSec += dtMs / 1000;
+    m.totalRuntimeSec += dtMs / 1000;
+    m.remainingMs -= dtMs;
+    if (m.durationSec && m.remainingMs <= 0) { // workout time is up
+      m.remainingMs = 0;
+      m.on = false;
+      log('duration elapsed, stopping');
+    }
+  }
+
+  // status code as the machine reports it (see commands.csv)
+  const cur = Math.round(m.curSpeed);
+  if (m.on) m.state = cur < tgt ? (cur === 0 ? 0x49 : 0x4B) : cur > tgt ? 0x4A : 0x0F;
+  else m.state = cur > 0 ? 0x4E : 0x08;
+}
+
+function statusPacket(unixSec) {
+  const b = Buffer.alloc(111);
+  b[0] = 0x0A; b[1] = 0xF0;
+  b[2] = m.msgId;
+  b[3] = m.state;
+  b[4] = Math.round(m.curSpeed);
+  b[5] = targetSpeed();
+  b.writeUInt16LE(m.pace100s, 7);
+  b.writeUInt16LE(Math.ceil(m.remainingMs / 1000), 11);
+  b.writeFloatLE(m.runtimeSec, 23);
+  b.writeFloatLE(m.totalRuntimeSec, 27);
+  b.writeUInt32LE(unixSec, 71);
+  b.writeUInt32LE(crc32(b, 107), 107);
+  return b;
+}
+
+// One 44-byte datagram on the command port
+function receive(msg, from) {
+  if (msg.length !== 44 || msg[0] !== 0x0A || msg[1] !== 0xF0) return;
+  if (crc32(msg, 40) !== msg.readUInt32LE(40)) { log('bad CRC from', from); return; }
+  const idx2 = msg[2], cmd = msg[3], param = msg.readUInt16LE(4);
+  if (idx2 === m.msgId) return; // retransmission of a command already applied
+  // like the machine, ignore commands while it is winding down
+  if ([0x4E, 0x0E, 0x4A, 0x0A].includes(m.state)) { log(`busy (0x${m.state.toString(16)}), ignoring 0x${cmd.toString(16)}`); return; }
+  m.msgId = idx2;
+  m.commands++;
+  onCommand(cmd, param);
+  log(`<- idx2=0x${idx2.toString(16)} cmd=0x${cmd.toString(16)} param=${param} from ${from}`);
+}
+
+/* ---------- trace: the model without sockets or wall clock --------- */
+// Each ms: the water moves, the status packet goes out when due (time 0
+// in its timestamp field), then that ms's commands arrive
+function playTrace(file) {
+  cfg.quiet = true;
+  const cmds = fs.readFileSync(file, 'utf8').split('\n').filter((l) => l.trim())
+    .map((l) => { const [ms, hex] = l.trim().split(/\s+/); return { ms: Number(ms), msg: Buffer.from(hex, 'hex') }; });
+  const endMs = (cmds.length ? cmds[cmds.length - 1].ms : 0) + 10000;
+  const lines = [];
+  for (let t = 1, i = 0; t <= endMs; t++) {
+    step(1);
+    if (t % cfg.interval === 0) lines.push(`${t} ${statusPacket(0).toString('hex')}`);
+    for (; i < cmds.length && cmds[i].ms <= t; i++) receive(cmds[i].msg, 'trace');
+  }
+  process.stdout.write(lines.join('\n') + '\n');
+}
+
+/* ---------- sockets ---------------------------------------------- */
+if (cfg.trace) playTrace(cfg.trace);
+else {
+  const cmdSock = dgram.createSocket({ type: 'udp4', reuseAddr: true });
+  cmdSock.on('message', (msg, rinfo) => {
+    if (Math.random() < cfg.loss) return;
+    receive(msg, rinfo.address);
+  });
+  cmdSock.bind(CMD_PORT, () => log(`commands on UDP ${CMD_PORT}`));
+
+  const out = dgram.createSocket('udp4');
+  out.bind(() => {
+    out.setMulticastTTL(1);
+    log(`status to ${MCAST_ADDR}:${STATUS_PORT} every ${cfg.interval} ms`);
+    let last = performance.now();
+    setInterval(() => {
+      const now = performance.now();
+      step((now - last) * cfg.warp);
+      last = now;
+      if (Math.random() >= cfg.loss) out.send(statusPacket(Math.floor(Date.now() / 1000)), STATUS_PORT, MCAST_ADDR);
+      profile?.write(`${Math.round(m.clockMs)},${m.state},${m.pace100s},${targetSpeed()},${m.curSpeed.toFixed(1)},${m.commands}\n`);
+    }, cfg.interval);
+  });
+}
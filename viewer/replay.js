@@ -0,0 +1,180 @@
+/* -----  replay.js  -------------------------------------------------
+   Plays a recorded swim-machine session back at the controller and
+   logs the commands it sends in response.
+
+   Run with:  node replay.js <trace> [--speed N] [--echo] [--out run.json]
+
+   <trace>   a pcap from the controller's GET /api/capture.pcap, or a
+             text file with one hex-encoded packet per line (optionally
+             prefixed by a millisecond timestamp: "1234 0af0...").
+   --speed   replay speed factor (default 1 = recorded timing)
+   --echo    closed loop: patch byte 2 of each status packet with the
+             idx2 of the controller's latest command (and fix the CRC),
+             like the machine acknowledging it
+   --out     write the command log as JSON, for diffing two firmware
+             versions against the same trace
+
+   The status packets go to 239.255.0.1:45654 as if sent by the machine.
+   Commands are received on UDP 9750, so the controller must reach this
+   host: stop the real machine or pin it with setPeerIP().
+--------------------------------------------------------------------*/
+import fs    from 'fs';
+import path  from 'path';
+import dgram from 'dgram';
+
+const MCAST_ADDR = '239.255.0.1';
+const STATUS_PORT = 45654;
+const CMD_PORT = 9750;
+
+/* ---------- arguments -------------------------------------------- */
+let tracePath = null, speed = 1, echo = false, outPath = null;
+for (const args = process.argv.slice(2); args.length;) {
+  const a = args.shift();
+  if (a === '--speed') speed = Number(args.shift()) || 1;
+  else if (a === '--echo') echo = true;
+  else if (a === '--out') outPath = args.shift();
+  else tracePath = a;
+}
+if (!tracePath) {
+  console.error('usage: node replay.js <trace> [--speed N] [--echo] [--out run.json]');
+  process.exit(1);
+}
+
+/* ---------- command names from commands.csv ---------------------- */
+const COMMANDS = {};
+try {
+  const csv = fs.readFileSync(path.join(path.dirname(new URL(import.meta.url).pathname), 'commands.csv'), 'utf8')
+                .trim().split(/\r?\n/).slice(1);
+  for (const line of csv) {
+    const [hex, name] = line.split(/[,;]/);
+    COMMANDS[parseInt(hex, 16)] = name.trim();
+  }
+} catch { /* names are cosmetic */ }
+
+/* ---------- CRC-32 (same framing as crc32.cpp) -------------------- */
+const CRC_TABLE = new Uint32Array(256).map((_, i) => {
+  let c = i;
+  for (let k = 0; k < 8; k++) c = c & 1 ? (c >>> 1) ^ 0xEDB88320 : c >>> 1;
+  return c >>> 0;
+});
+function crc32(buf, n) {
+  let c = 0xFFFFFFFF;
+  for (let i = 0; i < n; i++) c = CRC_TABLE[(c ^ buf[i]) & 0xFF] ^ (c >>> 8);
+  return (c ^ 0xFFFFFFFF) >>> 0;
+}
+
+/* ---------- trace loading ---------------------------------------- */
+// -> [{ ms, buf }] of 111-byte status packets, ms relative to the first
+function loadPcap(d) {
+  const le = d.readUInt32LE(0) === 0xA1B2C3D4;
+  const u32 = (o) => le ? d.readUInt32LE(o) : d.readUInt32BE(o);
+  const link = u32(20);
+  const out = [];
+  for (let o = 24; o + 16 <= d.length;) {
+    const ms = u32(o) * 1000 + u32(o + 4) / 1000;
+    const incl = u32(o + 8);
+    let pkt = d.subarray(o + 16, o + 16 + incl);
+    o += 16 + incl;
+    if (link === 101 || link === 228) pkt = pkt.subarray((pkt[0] & 0x0F) * 4 + 8); // IPv4 + UDP
+    else if (link === 1) pkt = pkt.subarray(14 + (pkt[14] & 0x0F) * 4 + 8);        // Ethernet
+    if (pkt.length === 111) out.push({ ms, buf: Buffer.from(pkt) });
+  }
+  return out;
+}
+
+function loadHex(text) {
+  const out = [];
+  let ms = 0;
+  for (const line of text.split(/\r?\n/)) {
+    const m = line.trim().match(/^(?:(\d+(?:\.\d+)?)\s+)?([0-9a-fA-F]+)$/);
+    if (!m) continue;
+    const buf = Buffer.from(m[2], 'hex');
+    if (buf.length !== 111) continue;
+    ms = m[1] !== undefined ? Number(m[1]) : ms + 250; // status interval when untimed
+    out.push({ ms, buf });
+  }
+  return out;
+}
+
+const raw = fs.readFileSync(tracePath);
+const trace = (raw.readUInt32LE(0) === 0xA1B2C3D4 || raw.readUInt32BE(0) === 0xA1B2C3D4)
+  ? loadPcap(raw) : loadHex(raw.toString('utf8'));
+if (!trace.length) {
+  console.error('no 111-byte status packets in', tracePath);
+  process.exit(1);
+}
+const t0 = trace[0].ms;
+console.log(`${trace.length} status packets, ${((trace.at(-1).ms - t0) / 1000).toFixed(1)} s recorded, speed x${speed}`);
+
+/* ---------- command log ------------------------------------------ */
+const log = [];
+let lastIdx2 = null;
+const cmdSock = dgram.createSocket({ type: 'udp4', reuseAddr: true });
+cmdSock.on('message', (msg, rinfo) => {
+  if (msg.length !== 44) return;
+  const entry = {
+    ms: Math.round(performance.now() - startMs),
+    idx2: msg[2],
+    cmd: msg[3],
+    name: COMMANDS[msg[3]] ?? 'unknown',
+    param: msg[4] | (msg[5] << 8),
+    retransmit: msg[2] === lastIdx2,
+    crcOk: crc32(msg, 40) === msg.readUInt32LE(40),
+    from: rinfo.address
+  };
+  lastIdx2 = msg[2];
+  log.push(entry);
+  console.log(`${String(entry.ms).padStart(8)} ms  idx2=0x${entry.idx2.toString(16)}  `
+            + `0x${entry.cmd.toString(16)} ${entry.name} ${entry.param}`
+            + `${entry.retransmit ? '  (retransmit)' : ''}${entry.crcOk ? '' : '  BAD CRC'}`);
+});
+cmdSock.bind(CMD_PORT);
+
+/* ---------- playback --------------------------------------------- */
+const out = dgram.createSocket('udp4');
+let startMs = 0;
+
+function send(buf) {
+  if (echo && lastIdx2 !== null) {
+    buf = Buffer.from(buf);
+    buf[2] = lastIdx2;
+    buf.writeUInt32LE(crc32(buf, 107), 107);
+  }
+  out.send(buf, STATUS_PORT, MCAST_ADDR);
+}
+
+function finish() {
+  const count = (f) => log.filter(f).length;
+  const byCmd = {};
+  for (const e of log) byCmd[e.name] = (byCmd[e.name] ?? 0) + 1;
+  const summary = {
+    trace: path.basename(tracePath),
+    speed,
+    echo,
+    commands: log.length,
+    retransmits: count(e => e.retransmit),
+    badCrc: count(e => !e.crcOk),
+    byCommand: byCmd
+  };
+  console.log(summary);
+  if (outPath) fs.writeFileSync(outPath, JSON.stringify({ summary, log }, null, 2));
+  out.close();
+  cmdSock.close();
+}
+
+out.bind(() => {
+  out.setMulticastTTL(1);
+  startMs = performance.now();
+  let i = 0;
+  // schedule against the start time so timer jitter does not accumulate
+  const next = () => {
+    if (i >= trace.length) { setTimeout(finish, 2000); return; } // let last acks arrive
+    send(trace[i].buf);
+    i++;
+    if (i < trace.length) {
+      const due = startMs + (trace[i].ms - t0) / speed;
+      setTimeout(next, Math.max(0, due - performance.now()));
+    } else next();
+  };
+  next();
+});
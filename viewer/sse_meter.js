@@ -0,0 +1,86 @@
+/* -----  sse_meter.js  ----------------------------------------------
+   Measures what the controller pushes over its event stream (/events):
+   events and bytes per minute, per event name.
+
+   Run with:  node sse_meter.js <host> [--seconds 60] [--stalled 0]
+                                [--out meter.json]
+
+   Point it at the controller while idle and while a workout runs, on
+   two firmware versions, and compare the per-minute figures (each byte
+   is also one the ESP32 formatted and sent over Wi-Fi to every client).
+
+   --stalled N also opens N connections that are never read (phones with
+   the screen locked) and prints the controller's /api/sse counters and
+   heap at the end; the heap should stay where it is without them.
+--------------------------------------------------------------------*/
+import fs from 'fs';
+
+/* ---------- arguments -------------------------------------------- */
+let host = null, seconds = 60, stalled = 0, outPath = null;
+for (const args = process.argv.slice(2); args.length;) {
+  const a = args.shift();
+  if (a === '--seconds') seconds = Number(args.shift()) || 60;
+  else if (a === '--stalled') stalled = Number(args.shift()) || 0;
+  else if (a === '--out') outPath = args.shift();
+  else host = a;
+}
+if (!host) {
+  console.error('usage: node sse_meter.js <host> [--seconds 60] [--stalled 0] [--out meter.json]');
+  process.exit(1);
+}
+
+/* ---------- count ------------------------------------------------- */
+const byEvent = {};
+let total = 0;
+function count(name, bytes) {
+  const e = byEvent[name] ??= { events: 0, bytes: 0, maxBytes: 0 };
+  e.events++;
+  e.bytes += bytes;
+  e.maxBytes = Math.max(e.maxBytes, bytes);
+  total += bytes;
+}
+
+const ctrl = new AbortController();
+const started = performance.now();
+setTimeout(() => ctrl.abort(), seconds * 1000);
+
+// bodies never read: the TCP window closes and the controller's queue fills
+for (let i = 0; i < stalled; ++i)
+  fetch(`http://${host}/events`, { signal: ctrl.signal }).catch(() => {});
+
+try {
+  const res = await fetch(`http://${host}/events`, { signal: ctrl.signal });
+  const dec = new TextDecoder();
+  let buf = '';
+  for await (const chunk of res.body) {
+    buf += dec.decode(chunk, { stream: true });
+    // events are separated by a blank line; bytes as sent, framing included
+    let i;
+    while ((i = buf.indexOf('\n\n')) >= 0) {
+      const block = buf.slice(0, i + 2);
+      buf = buf.slice(i + 2);
+      const name = (block.match(/^event: ?(.*)$/m) || [, 'message'])[1];
+      count(name, Buffer.byteLength(block));
+    }
+  }
+} catch (e) {
+  if (e.name !== 'AbortError') { console.error(e.message); process.exit(1); }
+}
+
+/* ---------- report ------------------------------------------------ */
+const minutes = (performance.now() - started) / 60000;
+const perMin = (n) => Math.round(n / minutes);
+const rows = Object.entries(byEvent).map(([name, e]) => ({
+  event: name,
+  events_per_min: perMin(e.events),
+  bytes_per_min: perMin(e.bytes),
+  max_bytes: e.maxBytes
+}));
+console.table(rows);
+console.log(`total ${perMin(total)} bytes/min over ${(minutes * 60).toFixed(0)} s`);
+let sse = null;
+if (stalled) {
+  sse = await (await fetch(`http://${host}/api/sse`)).json();
+  console.log(sse);
+}
+if (outPath) fs.writeFileSync(outPath, JSON.stringify({ host, seconds, stalled, bytesPerMin: perMin(total), rows, sse }, null, 2));
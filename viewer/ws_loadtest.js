@@ -0,0 +1,81 @@
+/* -----  ws_loadtest.js  --------------------------------------------
+   Round-trip latency of the controller's WebSocket control channel
+   (/ws): request sent to ack received, as percentiles.
+
+   Run with:  node ws_loadtest.js <host> [--clients 1] [--requests 200]
+                                  [--interval 50] [--op ping] [--m 0]
+                                  [--out latency.json]
+
+   --clients   sockets opened at once (the phones at the pool)
+   --requests  requests per socket, one in flight at a time
+   --interval  ms between a socket's requests
+   --op        op to send; "ping" touches nothing, "pause"/"resume"
+               exercise the real path (only with no one in the water)
+
+   Compare with the same host over HTTP to see what the socket saves,
+   e.g.  curl -o /dev/null -w '%{time_total}\n' -X POST http://<host>/api/pause
+--------------------------------------------------------------------*/
+import fs from 'fs';
+
+const WS = globalThis.WebSocket ?? (await import('ws')).default;
+
+/* ---------- arguments -------------------------------------------- */
+const cfg = { clients: 1, requests: 200, interval: 50, op: 'ping', m: 0, out: null };
+let host = null;
+for (const args = process.argv.slice(2); args.length;) {
+  const a = args.shift();
+  if (!a.startsWith('--')) { host = a; continue; }
+  const k = a.slice(2);
+  if (!(k in cfg)) { console.error('unknown option', a); process.exit(1); }
+  cfg[k] = typeof cfg[k] === 'number' ? Number(args.shift()) : args.shift();
+}
+if (!host) {
+  console.error('usage: node ws_loadtest.js <host> [--clients 1] [--requests 200] [--interval 50] [--op ping] [--m 0] [--out latency.json]');
+  process.exit(1);
+}
+
+/* ---------- one client ------------------------------------------- */
+function runClient(n) {
+  return new Promise((resolve, reject) => {
+    const ws = new WS(`ws://${host}/ws`);
+    const samples = [];
+    const errors = {};
+    let seq = 0, sentAt = 0;
+
+    const next = () => {
+      if (seq >= cfg.requests) { ws.close(); resolve({ samples, errors }); return; }
+      sentAt = performance.now();
+      ws.send(JSON.stringify({ id: `lt${n}-${++seq}`, op: cfg.op, m: cfg.m }));
+    };
+    ws.onopen = next;
+    ws.onerror = (e) => reject(new Error(`client ${n}: ${e.message ?? 'socket error'}`));
+    ws.onmessage = (e) => {
+      if (typeof e.data !== 'string') return; // packet stream, not ours
+      const reply = JSON.parse(e.data);
+      if (reply.id !== `lt${n}-${seq}`) return;
+      samples.push(performance.now() - sentAt);
+      if (!reply.ok) errors[reply.error] = (errors[reply.error] ?? 0) + 1;
+      setTimeout(next, cfg.interval);
+    };
+  });
+}
+
+/* ---------- report ----------------------------------------------- */
+const results = await Promise.all(Array.from({ length: cfg.clients }, (_, i) => runClient(i)));
+const all = results.flatMap(r => r.samples).sort((a, b) => a - b);
+const pct = (p) => all[Math.min(all.length - 1, Math.floor(p / 100 * all.length))];
+const errors = {};
+for (const r of results) for (const [k, v] of Object.entries(r.errors)) errors[k] = (errors[k] ?? 0) + v;
+
+const summary = {
+  host, ...cfg,
+  samples: all.length,
+  ms: {
+    min: all[0], p50: pct(50), p90: pct(90), p99: pct(99), max: all.at(-1),
+    mean: all.reduce((t, x) => t + x, 0) / all.length
+  },
+  errors
+};
+for (const k in summary.ms) summary.ms[k] = Math.round(summary.ms[k] * 10) / 10;
+console.log(summary);
+if (cfg.out) fs.writeFileSync(cfg.out, JSON.stringify({ summary, samples: all }, null, 2));
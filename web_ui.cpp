@@ -31,11 +31,14 @@ void WebUI::loop()
 {
     static uint32_t t0 = millis();
     NetworkSetup::loop();
-    if (millis() - t0 > 2000)
+    if (millis() - t0 > 10000) // keepalive; state is sent on connect and on change
     {
         t0 = millis();
         push_event("ping", "{}");
     }
+#ifdef WEBSERVERENABLED
+    AppNetwork::loop();
+#endif
 }
 
 void WebUI::push_event(const char *e, const char *j)
@@ -47,20 +50,8 @@ void WebUI::push_event(const char *e, const char *j)
 
 void WebUI::push_network_event(const uint8_t *data, size_t len)
 {
-    // Convert data bytes to hex string
-    static char hexStr[256]; // enough for 128 bytes * 2 + 1
-    size_t pos = 0;
-    for (size_t i = 0; i < len && pos + 2 < sizeof(hexStr); i++)
-    {
-        sprintf(&hexStr[pos], "%02X", data[i]);
-        pos += 2;
-    }
-    hexStr[pos] = '\0';
-
-    // Send hex string as JSON string
-    String json = String("{\"packet\":\"") + hexStr + "\"}";
-    
+    // raw bytes to the WebSocket subscribers of "packets" (status.html)
 #ifdef WEBSERVERENABLED
-    AppNetwork::push_event("network", json.c_str());
+    AppNetwork::push_packet(data, len);
 #endif
 }
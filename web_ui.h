@@ -6,12 +6,12 @@ namespace WebUI {
   /** Initialise filesystem and bring up networking; all HTTP routes/SSE are owned by AppNetwork. */
   void begin();
 
-  /** Call in loop() to drive SSE heartbeats. */
+  /** Call in loop() to drive SSE heartbeats and WebSocket cleanup. */
   void loop();
 
   /** Push a Server-Sent Event. */
   void push_event(const char *event, const char *json);
 
-  /** Push a network event as hex string. */
+  /** Push a protocol packet to the WebSocket packet subscribers (binary). */
   void push_network_event(const uint8_t *data, size_t len);
 }
@@ -2,8 +2,11 @@
 #include <Arduino.h>
 #include "workout_storage.h"
 #include "swim_machine.h"
+#include "progress_key.h"
+#include "progress_json.h"
 #include "web_ui.h"
 #include <ArduinoJson.h>
+#include "settings_file.h"
 #define HUB75EBABLE
 #ifdef HUB75EBABLE
 #include "hub75.h"
@@ -29,8 +32,72 @@ inline void heapCheckHardImpl(const char* file, int line) {
 #define HEAP_CHECK_HARD() heapCheckHardImpl(__FILE__, __LINE__)
 #endif
 
-static Workout current_workout_; // store currently active workout
+static Workout current_workout_[SwimMachine::kMaxMachines]; // currently active workout per machine
+static WorkoutProgram::Program current_program_[SwimMachine::kMaxMachines]; // its playback program
+static const size_t kStatusSteps = 8;      // upcoming steps drawn on the panel
 
+static String armed_id_[SwimMachine::kMaxMachines];        // workout staged by arm(), "" = none
+
+// Lane events: machine 0 keeps the plain name, the others get "<name><m>"
+static String lane_event(const char *name, size_t m)
+{
+  String e = name;
+  if (m)
+    e += String((unsigned)m);
+  return e;
+}
+
+/* ---------- lane map: which pool is which ?m= --------------------- */
+// The address each machine slot is bound to, kept in settings.json as
+// "lanes": ["192.168.1.40", ""] so a pool gets the same lane after a reboot
+// instead of whichever slot its first status packet happened to take.
+static IPAddress s_lanes[SwimMachine::kMaxMachines];
+
+static void lanes_load()
+{
+  SettingsFile::Doc d;
+  if (!SettingsFile::read(d))
+    return;
+  size_t m = 0;
+  for (JsonVariantConst v : d["lanes"].as<JsonArrayConst>())
+  {
+    IPAddress ip;
+    if (m < SwimMachine::kMaxMachines && ip.fromString(v | ""))
+    {
+      s_lanes[m] = ip;
+      SwimMachine::bindMachine(ip, m);
+    }
+    m++;
+  }
+}
+
+// Rewrites "lanes", keeping the other keys (hub75.cpp owns those)
+static void lanes_store()
+{
+  SettingsFile::update([](SettingsFile::Doc &d) {
+    JsonArray a = d.createNestedArray("lanes");
+    for (const IPAddress &ip : s_lanes)
+      a.add(ip == IPAddress(0, 0, 0, 0) ? String() : ip.toString());
+  });
+}
+
+// Store a slot that was bound to a new address (a free slot going back to
+// unbound keeps its stored address)
+static void lanes_track()
+{
+  bool changed = false;
+  for (size_t m = 0; m < SwimMachine::kMaxMachines; ++m)
+  {
+    IPAddress ip = SwimMachine::machineIP(m);
+    if (ip != IPAddress(0, 0, 0, 0) && ip != s_lanes[m])
+    {
+      s_lanes[m] = ip;
+      changed = true;
+    }
+  }
+  if (changed)
+    lanes_store();
+}
 
 void WorkoutManager::begin()
 {
@@ -46,71 +113,165 @@ HEAP_CHECK_HARD();
 Serial.println("workoutstorage");
 HEAP_CHECK_HARD();
 #endif
-  // Clear currently active workout on start
-  current_workout_ = Workout{};
+  // Clear currently active workouts on start
+  for (auto &w : current_workout_)
+    w = Workout{};
+  for (auto &p : current_program_)
+    p.clear();
+  lanes_load();
 }
 
-bool WorkoutManager::run(const String &workout_id)
+// Load a workout into machine m (not started), and arm it with arm set.
+// When arming is refused nothing is replaced and no plan goes out.
+bool WorkoutManager::load_(const String &workout_id, size_t m, bool arm)
 {
   Workout w;
   if (!WorkoutStorage::load(workout_id, w))
   {
-    Serial.printf("WorkoutManager::run: failed to load workout id=%s\n", workout_id.c_str());
+    Serial.printf("WorkoutManager: failed to load workout id=%s\n", workout_id.c_str());
     return false; // Workout not found or failed to load
   }
-  if (!SwimMachine::isMachineFound())
+  if (!SwimMachine::isMachineFound(m))
   {
     Serial.printf("Swim machine not found");
     return false;
   }
 
-  current_workout_ = w;
+  WorkoutProgram::Program program = WorkoutStorage::program(w);
+  if (arm && !SwimMachine::arm(program, m))
+  {
+    Serial.printf("Could not arm swim machine");
+    return false;
+  }
+  if (!arm)
+    SwimMachine::loadWorkout(program, m);
+  current_workout_[m] = w;
+  armed_id_[m] = "";
+  current_program_[m] = program;
+
+  // the whole workout goes out once; progress events then carry the step index
+  String plan = WorkoutStorage::to_json(w);
+  WebUI::push_event(lane_event("plan", m).c_str(), plan.c_str());
+  return true;
+}
 
-  std::vector<SwimMachine::Segment> segments;
-  for (const auto &step : w.steps)
+bool WorkoutManager::run(const String &workout_id, size_t m)
+{
+  if (m >= SwimMachine::kMaxMachines)
+    return false;
+  if (armed_id_[m] == workout_id && SwimMachine::isArmed(m))
+    return go(m);
+  if (!load_(workout_id, m))
+    return false;
+  if (!SwimMachine::start(m))
   {
-    SwimMachine::Segment seg;
-    seg.pace100s = step.pace100s;
-    seg.durSec = step.durSec;
-    segments.push_back(seg);
+    Serial.printf("Could not start swim machine");
+    return false;
   }
 
-  SwimMachine::loadWorkout(segments);
-  if (!SwimMachine::start())
+  push_status_(m, true);
+  return true;
+}
+
+bool WorkoutManager::arm(const String &workout_id, size_t m)
+{
+  if (m >= SwimMachine::kMaxMachines)
+    return false;
+  if (SwimMachine::getStatus(m).active)
+    return false; // never restage a lane that is swimming
+  if (armed_id_[m] == workout_id && SwimMachine::isArmed(m))
+    return true;
+  if (SwimMachine::motorRunning(m))
+    return false; // the pool side is running it: keep what is loaded
+  if (!load_(workout_id, m, true))
+    return false;
+  armed_id_[m] = workout_id;
+  push_status_(m, true);
+  return true;
+}
+
+bool WorkoutManager::go(size_t m)
+{
+  if (m >= SwimMachine::kMaxMachines || !SwimMachine::isArmed(m))
+    return false;
+  armed_id_[m] = "";
+  if (!SwimMachine::start(m))
   {
     Serial.printf("Could not start swim machine");
     return false;
   }
 
-  push_status_();
+  push_status_(m, true);
   return true;
 }
 
-void WorkoutManager::pause()
+void WorkoutManager::workout_changed(const String &workout_id)
+{
+  // the staged segments are stale; the next run() reloads from storage
+  for (auto &id : armed_id_)
+    if (id == workout_id)
+      id = "";
+}
+
+void WorkoutManager::pause(size_t m)
+{
+  if (m >= SwimMachine::kMaxMachines)
+    return;
+  SwimMachine::pause(m);
+  push_status_(m, true);
+}
+
+void WorkoutManager::set_paused(bool paused, size_t m)
+{
+  if (m >= SwimMachine::kMaxMachines)
+    return;
+  SwimMachine::setPaused(paused, m);
+  push_status_(m, true);
+}
+
+void WorkoutManager::adjust(int16_t pace_offset, size_t m)
 {
-  SwimMachine::pause();
-  push_status_();
+  if (m >= SwimMachine::kMaxMachines)
+    return;
+  SwimMachine::setPaceOffset(pace_offset, m);
+  push_status_(m, true);
 }
 
-void WorkoutManager::stop()
+String WorkoutManager::workout_id(size_t m)
 {
-  SwimMachine::stop();
-  push_status_();
+  return m < SwimMachine::kMaxMachines ? current_workout_[m].id : String();
+}
+
+void WorkoutManager::stop(size_t m)
+{
+  if (m >= SwimMachine::kMaxMachines)
+    return;
+  SwimMachine::stop(m);
+  push_status_(m, true);
 }
 
 
-static bool s_active = false;
+static bool s_active[SwimMachine::kMaxMachines] = {};
+
+static bool any_active()
+{
+  for (bool a : s_active)
+    if (a)
+      return true;
+  return false;
+}
+
 void WorkoutManager::tick()
 {
 #ifdef HUB75EBABLE
   // Keep the panel awake while a workout runs; otherwise count down to off.
-  HUB75_screensaverTick(s_active);
+  HUB75_screensaverTick(any_active());
 #endif
-  if(!s_active){
+  if(!any_active()){
 #ifdef HUB75EBABLE
 static uint32_t prev2 =0;
   uint32_t now = millis();
-  if(now > 250 && now<prev2+50)
+  if(now - prev2 < 50)   // unsigned: survives the millis() wrap
     return;
   prev2 = now;
     drawSwimmerAnimationTick();
@@ -118,55 +279,75 @@ static uint32_t prev2 =0;
   }
   static uint32_t prev =0;
   uint32_t now = millis();
-  if(now > 250 && now<prev+250)
+  if(now - prev < 250)   // unsigned: survives the millis() wrap
     return;
   prev = now;
+  lanes_track();
   // Just push status, no internal timer needed
-  push_status_();
+  size_t n = SwimMachine::machineCount();
+  for (size_t m = 0; m < n; ++m)
+    push_status_(m);
 }
 
-void WorkoutManager::push_status_()
+static ProgressGate s_progress[SwimMachine::kMaxMachines];
+
+String WorkoutManager::progress_json(size_t m)
 {
-  SwimMachine::SwimStatus st = SwimMachine::getStatus();
+  char out[ProgressJson::kMax];
+  ProgressJson::write(SwimMachine::getStatus(m), out, sizeof out);
+  return String(out);
+}
 
-  // Build status JSON on the heap to avoid loopTask stack overflow
-  const size_t base = 2048;              // base for fixed fields
-  const size_t per  = 64;                // per remaining_swims entry (approx)
-  size_t cap = base + (current_workout_.steps.size() * per);
-  if (cap > 6144) cap = 6144;            // clamp to a sane upper bound
-  DynamicJsonDocument doc(cap);
-  doc["running"] = st.active;
-  s_active=st.active;
+#ifdef HUB75EBABLE
+// The panel draws from the status document it always did: current step,
+// its note and the next few steps
+static void draw_panel(size_t m, const SwimMachine::SwimStatus &st)
+{
+  const Workout &current = current_workout_[m];
+  const size_t per = 64 + WorkoutStorage::kMaxNoteLen; // per remaining_swims entry
+  DynamicJsonDocument doc(512 + kStatusSteps * per);
   doc["paused"] = st.paused;
-  doc["current_step"] = st.idx;
   doc["elapsed_ms"] = st.elapsedMs;
-  doc["workout_title"] = current_workout_.name;
-
-  if (st.idx >= 0 && st.idx < (int)current_workout_.steps.size())
-  {
-    doc["current_step_note"] = current_workout_.steps[st.idx].note;
-  }
-
-  // Add remaining swims from current step onward
   JsonArray remaining = doc.createNestedArray("remaining_swims");
-  if (st.idx >= 0)
-    for (int i = st.idx; i < (int)current_workout_.steps.size(); ++i)
+  if (!st.at.done && st.at.node < current.steps.size())
+  {
+    doc["current_step_note"] = current.steps[st.at.node].note;
+    const WorkoutProgram::Program &prog = current_program_[m];
+    WorkoutProgram::Cursor c = st.at;
+    for (size_t n = 0; n < kStatusSteps && !c.done; ++n, WorkoutProgram::next(prog, c))
     {
-      const auto &s = current_workout_.steps[i];
       JsonObject swim = remaining.createNestedObject();
-      swim["pace100s"] = s.pace100s;
-      swim["durSec"] = s.durSec;
-      swim["note"] = s.note;
+      swim["pace100s"] = c.pace100s;
+      swim["durSec"] = c.durSec;
+      swim["note"] = current.steps[c.node].note;
     }
+  }
+  printJSon(doc);
+}
+#endif
+
+// "progress<m>" when something changed (or force, or the resync interval
+// passed); the panel is redrawn every call while this machine is on it
+void WorkoutManager::push_status_(size_t m, bool force)
+{
+  SwimMachine::SwimStatus st = SwimMachine::getStatus(m);
+  s_active[m] = st.active;
 
+  if (s_progress[m].due(st, millis(), force))
+  {
+    char out[ProgressJson::kMax];
+    ProgressJson::write(st, out, sizeof out);
+    WebUI::push_event(lane_event("progress", m).c_str(), out);
+  }
 
-  String out;
-  serializeJson(doc, out);
-  if(s_active){    
+  // the panel shows the first machine that is running a workout
+  bool onPanel = st.active;
+  for (size_t i = 0; i < m; ++i)
+    if (s_active[i])
+      onPanel = false;
+  if(onPanel){    
 #ifdef HUB75EBABLE
-    printJSon(doc);
+    draw_panel(m, st);
 #endif
   }
-  WebUI::push_event("status", out.c_str());
-  
 }
@@ -7,10 +7,27 @@ class WorkoutManager {
   static void tick();          // call in loop()
 
   // UPDATED: accept an ID to run that specific workout
-  static bool run(const String& workout_id);
-  static void pause();
-  static void stop();
+  // m selects the machine (lane), see SwimMachine::kMaxMachines
+  static bool run(const String& workout_id, size_t m = 0);
+  // two-phase start: arm() loads the workout and pre-sends duration and
+  // first pace while the swimmer gets ready; go() then sends only start.
+  // run() takes the same shortcut when the workout is already armed.
+  static bool arm(const String& workout_id, size_t m = 0);
+  static bool go(size_t m = 0);
+  static void workout_changed(const String& workout_id); // saved/deleted: disarm it
+  static void pause(size_t m = 0);                    // toggle
+  static void set_paused(bool paused, size_t m = 0);  // repeat-safe pause/resume
+  static void adjust(int16_t pace_offset, size_t m = 0); // s/100 m on every swim pace, - = faster
+  static void stop(size_t m = 0);
+  static String workout_id(size_t m = 0);             // workout loaded on machine m
+
+  // SSE: "plan<m>" carries the loaded workout (pushed when it is loaded,
+  // and replayed from the stream's latest to each client as it connects),
+  // "progress<m>" the playback state (pushed when it changes; built fresh
+  // for a client as it connects).
+  static String progress_json(size_t m);
 
  private:
-  static void push_status_();
+  static bool load_(const String& workout_id, size_t m, bool arm = false);
+  static void push_status_(size_t m, bool force = false);
 };
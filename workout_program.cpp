@@ -0,0 +1,106 @@
+#include "workout_program.h"
+
+using namespace WorkoutProgram;
+
+// A swim pace of the program in the rounds the cursor is in
+static uint16_t resolvePace(const Program &p, const Cursor &c, uint16_t base)
+{
+  int32_t pace = base;
+  if (!pace)
+    return 0; // rests (and constant paces' missing end) stay 0
+  for (uint8_t d = 0; d < c.depth; ++d)
+    pace += (int32_t)p[c.stack[d].node].paceStep * c.stack[d].round;
+  return pace < 1 ? 1 : pace > 0xFFFF ? 0xFFFF : (uint16_t)pace;
+}
+
+// Settle on the first step at or after entry i, closing finished rounds
+// and opening blocks on the way
+static void settle(const Program &p, Cursor &c, size_t i)
+{
+  // frames at this depth and deeper began their round in this call: if
+  // one ends here, it had nothing to play and neither will the others
+  uint8_t fresh = kMaxDepth;
+  for (;;)
+  {
+    while (c.depth)
+    {
+      auto &f = c.stack[c.depth - 1];
+      size_t end = f.node + 1 + p[f.node].body;
+      if (i < end)
+        break;
+      if (c.depth - 1 < fresh && ++f.round < p[f.node].repeat)
+      {
+        i = f.node + 1; // next round
+        fresh = c.depth - 1;
+        break;
+      }
+      c.depth--; // block done, i is already past it
+    }
+    if (i >= p.size())
+    {
+      c.done = true;
+      return;
+    }
+    const Node &n = p[i];
+    if (n.repeat)
+    {
+      if (!n.body || c.depth == kMaxDepth)
+      { // nothing to play (rejected by WorkoutStorage, skipped if it gets here)
+        i += 1 + n.body;
+        continue;
+      }
+      if (c.depth < fresh)
+        fresh = c.depth;
+      c.stack[c.depth++] = {(uint16_t)i, 0};
+      i++;
+      continue;
+    }
+    c.node = (uint16_t)i;
+    c.pace100s = resolvePace(p, c, n.pace100s);
+    c.paceEnd100s = n.pace100s ? resolvePace(p, c, n.paceEnd100s) : 0;
+    c.durSec = n.durSec;
+    return;
+  }
+}
+
+Cursor WorkoutProgram::first(const Program &p)
+{
+  Cursor c;
+  c.index = 0;
+  c.done = false;
+  settle(p, c, 0);
+  return c;
+}
+
+void WorkoutProgram::next(const Program &p, Cursor &c)
+{
+  if (c.done)
+    return;
+  c.index++;
+  settle(p, c, c.node + 1);
+}
+
+uint16_t WorkoutProgram::paceAt(const Cursor &c, uint32_t elapsedMs)
+{
+  if (!c.paceEnd100s || !c.pace100s || !c.durSec)
+    return c.pace100s;
+  uint32_t durMs = (uint32_t)c.durSec * 1000;
+  if (elapsedMs >= durMs)
+    return c.paceEnd100s;
+  int32_t span = (int32_t)c.paceEnd100s - c.pace100s;
+  return (uint16_t)(c.pace100s + (int32_t)((int64_t)span * elapsedMs / durMs));
+}
+
+bool WorkoutProgram::totals(const Program &p, uint32_t &steps, uint32_t &activeSec, uint32_t maxSteps)
+{
+  steps = 0;
+  activeSec = 0;
+  for (Cursor c = first(p); !c.done; next(p, c))
+  {
+    if (++steps > maxSteps)
+      return false;
+    if (c.pace100s)
+      activeSec += c.durSec;
+  }
+  return true;
+}
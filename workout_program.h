@@ -0,0 +1,61 @@
+#pragma once
+#include <Arduino.h>
+#include <vector>
+
+/* Compact workout program: swim/rest steps and repeat blocks, stored in
+   pre-order. A repeat entry is followed by its body (`body` entries,
+   nested blocks included), so "20 x (100 @1:30, rest 15)" is three
+   entries instead of forty steps. A block may carry a pace progression:
+   every round adds `paceStep` to the swims inside it (negative = faster).
+   A swim with `paceEnd100s` set is a ramp: its pace moves linearly from
+   pace100s to paceEnd100s over the step (a build or a fade).
+
+   A Cursor walks the program one step at a time with a fixed-size stack,
+   so playback needs no flattened copy; memory depends on the number of
+   entries, not on the number of steps they expand to. */
+
+namespace WorkoutProgram
+{
+  constexpr uint8_t kMaxDepth = 4; // nested repeat blocks
+
+  struct Node
+  {
+    uint16_t pace100s; // step: seconds / 100 m; 0 = rest
+    uint16_t durSec;   // step: seconds
+    uint16_t repeat;   // 0 = step; otherwise a block run this many times
+    uint16_t body;     // block: entries that follow and belong to it
+    int16_t paceStep;  // block: added to its swims' pace per round
+    uint16_t paceEnd100s; // step: pace at the end of a ramp, 0 = constant pace
+  };
+
+  using Program = std::vector<Node>;
+
+  struct Cursor
+  {
+    int32_t index = -1;    // step number in the expanded workout, -1 = not started
+    uint16_t node = 0;     // program entry of the current step
+    uint16_t pace100s = 0; // pace this round (progressions applied)
+    uint16_t paceEnd100s = 0; // ramp end pace this round, 0 = constant
+    uint16_t durSec = 0;
+    bool done = true;      // walked past the last step
+    uint8_t depth = 0;
+    struct
+    {
+      uint16_t node;  // repeat entry
+      uint16_t round; // 0-based
+    } stack[kMaxDepth];
+  };
+
+  /** Cursor on the first step (done if the program has none). */
+  Cursor first(const Program &p);
+
+  /** Advance to the next step; sets done after the last one. */
+  void next(const Program &p, Cursor &c);
+
+  /** Pace of the current step `elapsedMs` into it (ramps interpolated). */
+  uint16_t paceAt(const Cursor &c, uint32_t elapsedMs);
+
+  /** Steps and swimming seconds of the whole program; stops counting
+      (and returns false) once the steps exceed maxSteps. */
+  bool totals(const Program &p, uint32_t &steps, uint32_t &activeSec, uint32_t maxSteps = UINT32_MAX);
+}
@@ -21,57 +21,217 @@ static String path_for(const String& id) {
 
 
 
+// Entries [i, end) into arr; blocks nest their body under "swims"
+static void write_swims(JsonArray arr, const std::vector<SwimStep> &steps, size_t &i, size_t end) {
+  while (i < end) {
+    const SwimStep &s = steps[i++];
+    JsonObject o = arr.createNestedObject();
+    if (s.repeat) {
+      o["repeat"] = s.repeat;
+      if (s.paceStep) o["pace_step"] = s.paceStep;
+      o["note"] = s.note;
+      size_t bodyEnd = i + s.body;
+      write_swims(o.createNestedArray("swims"), steps, i, bodyEnd < end ? bodyEnd : end);
+      continue;
+    }
+    o["speed"] = s.pace100s; // rename field from pace100s -> speed
+    if (s.paceEnd100s) o["speed_end"] = s.paceEnd100s;
+    o["dur"] = s.durSec;
+    o["note"] = s.note;
+  }
+}
+
+// Exactly what write_swims() puts in the document: root id, title and
+// swims; one array slot and up to four members per entry; the copied
+// strings. Anything from_json() accepts fits.
+static size_t json_capacity(const Workout &w) {
+  size_t cap = JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(w.steps.size()) + w.steps.size() * JSON_OBJECT_SIZE(4);
+  cap += JSON_STRING_SIZE(w.id.length()) + JSON_STRING_SIZE(w.name.length());
+  for (const auto &s : w.steps) cap += JSON_STRING_SIZE(s.note.length());
+  return cap;
+}
+
 String WorkoutStorage::to_json(const Workout &w) {
-  // Use heap allocation to avoid stack overflow; size based on content
-  size_t cap = 512 + (w.steps.size() * 96);
-  for (const auto &s : w.steps) cap += s.note.length();
-  if (cap < 1024) cap = 1024;
-  if (cap > 8192) cap = 8192;
-  DynamicJsonDocument doc(cap);
+  size_t cap = json_capacity(w);
+  DynamicJsonDocument doc(cap); // on the heap: about 54 KB at the limits
 
   doc["id"] = String(w.id);        // store as string
   doc["title"] = w.name;           // use "title" not "name"
   JsonArray arr = doc.createNestedArray("swims");   // "swims" key
-  for (auto &s : w.steps) {
-    JsonObject o = arr.createNestedObject();
-    o["speed"] = s.pace100s; // rename field from pace100s -> speed
-    o["dur"] = s.durSec;
-    o["note"] = s.note;
+  size_t i = 0;
+  write_swims(arr, w.steps, i, w.steps.size());
+  if (doc.overflowed()) {
+    Serial.printf("to_json: workout %s does not fit in %u bytes\n", w.id.c_str(), (unsigned)cap);
+    return String();
   }
   String out;
   serializeJson(doc, out);
   return out;
 }
 
-bool WorkoutStorage::from_json(const uint8_t *data, size_t len, Workout &w) {
-  // Allocate document on heap sized to input length (clamped)
-  size_t cap = len + 512;
-  if (cap < 1024) cap = 1024;
-  if (cap > 8192) cap = 8192;
-  DynamicJsonDocument doc(cap);
+// Non-negative number <= max (fractions are cut); a missing field reads as 0
+static bool read_uint(JsonVariantConst v, uint32_t max, uint32_t &out) {
+  if (v.isNull()) { out = 0; return true; }
+  if (!v.is<double>()) return false;
+  double d = v.as<double>();
+  if (!(d >= 0 && d <= max)) return false; // also rejects NaN
+  out = (uint32_t)d;
+  return true;
+}
+
+static String read_text(JsonVariantConst v, const char *def, size_t maxLen) {
+  String t = String(v | def);
+  if (t.length() > maxLen) {
+    while (maxLen > 0 && (t[maxLen] & 0xC0) == 0x80) maxLen--; // keep UTF-8 whole
+    t = t.substring(0, maxLen);
+  }
+  return t;
+}
+
+// Signed number within [-max, max]; a missing field reads as 0
+static bool read_int(JsonVariantConst v, int32_t max, int32_t &out) {
+  if (v.isNull()) { out = 0; return true; }
+  if (!v.is<double>()) return false;
+  double d = v.as<double>();
+  if (!(d >= -max && d <= max)) return false;
+  out = (int32_t)d;
+  return true;
+}
+
+// Append a "swims" array to out (pre-order). slowest/fastest are the pace
+// shifts the enclosing blocks' progressions can add, so every swim can be
+// checked against the pace limits without expanding the repeats.
+static bool read_swims(JsonArrayConst swims, std::vector<SwimStep> &out, uint8_t depth,
+                       int32_t slowest, int32_t fastest) {
+  for (JsonVariantConst elem : swims) {  // use "swims"
+    if (!elem.is<JsonObjectConst>()) {
+      Serial.println("JSON: swim step is not an object");
+      return false;
+    }
+    if (out.size() >= kMaxSteps) {
+      Serial.printf("JSON: more than %u steps\n", (unsigned)kMaxSteps);
+      return false;
+    }
+    SwimStep s;
+    s.note = read_text(elem["note"], "", kMaxNoteLen);
+    if (!elem["repeat"].isNull()) {
+      uint32_t rep;
+      int32_t shift;
+      JsonVariantConst body = elem["swims"];
+      if (!read_uint(elem["repeat"], kMaxRepeat, rep) || rep == 0 ||
+          !read_int(elem["pace_step"], kMaxPace100s, shift) ||
+          !body.is<JsonArrayConst>() || body.size() == 0) {
+        Serial.println("JSON: bad repeat block");
+        return false;
+      }
+      if (depth >= kMaxDepth) {
+        Serial.printf("JSON: repeat blocks nested deeper than %u\n", (unsigned)kMaxDepth);
+        return false;
+      }
+      s.pace100s = 0;
+      s.durSec = 0;
+      s.repeat = (uint16_t)rep;
+      s.paceStep = (int16_t)shift;
+      size_t at = out.size();
+      out.push_back(s);
+      int32_t range = shift * (int32_t)(rep - 1);
+      if (!read_swims(body.as<JsonArrayConst>(), out, depth + 1,
+                      slowest + (range > 0 ? range : 0), fastest + (range < 0 ? range : 0)))
+        return false;
+      out[at].body = (uint16_t)(out.size() - at - 1);
+      continue;
+    }
+    uint32_t pace, paceEnd, dur;
+    if (!read_uint(elem["speed"], kMaxPace100s, pace) ||   // rename speed->pace100s
+        !read_uint(elem["speed_end"], kMaxPace100s, paceEnd) ||
+        !read_uint(elem["dur"], kMaxStepSec, dur)) {
+      Serial.println("JSON: swim step speed/dur out of range");
+      return false;
+    }
+    if (paceEnd && !pace) {
+      Serial.println("JSON: speed_end on a rest");
+      return false;
+    }
+    for (uint32_t p : {pace, paceEnd}) {
+      if (p && ((int32_t)p + fastest < 1 || (int32_t)p + slowest > (int32_t)kMaxPace100s)) {
+        Serial.println("JSON: pace progression leaves the pace range");
+        return false;
+      }
+    }
+    s.pace100s = (uint16_t)pace;
+    s.paceEnd100s = paceEnd == pace ? 0 : (uint16_t)paceEnd;
+    s.durSec = dur;
+    out.push_back(s);
+  }
+  return true;
+}
 
-  auto err = deserializeJson(doc, data, len);
-  if (err) {
-    Serial.printf("JSON parse error: %s\n", err.c_str());
+// The workout in a parsed document into w; false (w untouched) if invalid
+static bool read_workout(const JsonDocument &doc, Workout &w) {
+  if (!doc.is<JsonObject>()) {
+    Serial.println("JSON: workout is not an object");
+    return false;
+  }
+  JsonObjectConst root = doc.as<JsonObjectConst>();
+  JsonVariantConst swims = root["swims"];
+  if (!swims.isNull() && !swims.is<JsonArrayConst>()) {
+    Serial.println("JSON: swims is not an array");
     return false;
   }
+
+  // parse into a scratch workout so w is untouched on failure
+  Workout out;
   // convert string id to uint32_t using atol or strtoull
-  const char* strid = doc["id"] | "";
-  w.id = strtoull(strid, nullptr, 10);
+  const char* strid = root["id"] | "";
+  out.id = strtoull(strid, nullptr, 10);
 
-  w.name = String(doc["title"] | "Unnamed");  // use "title"
+  out.name = read_text(root["title"], "Unnamed", kMaxTitleLen);  // use "title"
 
-  w.steps.clear();
-  for (auto elem : doc["swims"].as<JsonArray>()) {  // use "swims"
-    SwimStep s;
-    s.pace100s = elem["speed"] | 0U;              // rename speed->pace100s
-    s.durSec = elem["dur"] | 0UL;
-    s.note = String(elem["note"] | "");
-    w.steps.push_back(s);
+  if (!read_swims(swims.as<JsonArrayConst>(), out.steps, 0, 0, 0))
+    return false;
+  uint32_t steps, activeSec;
+  if (!WorkoutProgram::totals(program(out), steps, activeSec, kMaxExpanded)) {
+    Serial.printf("JSON: workout expands to more than %u steps\n", (unsigned)kMaxExpanded);
+    return false;
   }
+  w = out;
   return true;
 }
 
+// Nesting of a workout at kMaxDepth: root, swims, then a block object
+// and its swims per level, and the step objects
+static const uint8_t kJsonNesting = 2 * kMaxDepth + 3;
+
+bool WorkoutStorage::from_json(const uint8_t *data, size_t len, Workout &w) {
+  // Sized to the input first. When that is too small, to the limits: every
+  // entry an object with all seven keys, every copied string (keys too)
+  // within the input. Whatever to_json() writes reads back.
+  size_t cap = len + 512;
+  if (cap < 1024) cap = 1024;
+  size_t limits = JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(kMaxSteps) + kMaxSteps * JSON_OBJECT_SIZE(7) + len;
+  for (;;) {
+    DynamicJsonDocument doc(cap); // heap; one at a time
+    auto err = deserializeJson(doc, data, len, DeserializationOption::NestingLimit(kJsonNesting));
+    if (err == DeserializationError::NoMemory && cap < limits) {
+      cap = limits;
+      continue;
+    }
+    if (err) {
+      Serial.printf("JSON parse error: %s\n", err.c_str());
+      return false;
+    }
+    return read_workout(doc, w);
+  }
+}
+
+WorkoutProgram::Program WorkoutStorage::program(const Workout &w) {
+  WorkoutProgram::Program p;
+  p.reserve(w.steps.size());
+  for (const auto &s : w.steps)
+    p.push_back({s.pace100s, (uint16_t)s.durSec, s.repeat, s.body, s.paceStep, s.paceEnd100s});
+  return p;
+}
+
 std::vector<String> WorkoutStorage::list_ids() {
   std::vector<String> ids;
   File dir = LittleFS.open("/workouts","r");
@@ -101,12 +261,13 @@ bool WorkoutStorage::load(String id, Workout &out) {
 
 bool WorkoutStorage::save(const Workout &w) {
   if (!LittleFS.exists("/workouts")) LittleFS.mkdir("/workouts");  
+  String S = to_json(w);
+  if (S.length() == 0) return false;     // do not replace a good file with nothing
   String p = path_for(w.id);  
   Serial.println("saving file");
   Serial.println(p);
   File f = LittleFS.open(p, "w");
   if (!f) return false;
-  String S = to_json(w);
   Serial.println("saving file");
   Serial.println(S);
   f.print(S);
@@ -5,23 +5,42 @@
 #include <ArduinoJson.h>
 #include <LittleFS.h>
 
+#include "workout_program.h"
+
+/* One program entry: a swim/rest step, or a repeat block whose body is the
+   `body` entries after it (pre-order, see workout_program.h). In JSON a
+   block is {"repeat": n, "pace_step": d, "note": "", "swims": [...]}. */
 struct SwimStep {
   uint16_t pace100s;   // seconds per 100 m (0 = rest)
   uint32_t durSec;     // duration in seconds
   String   note;       // user‐entered note
+  uint16_t paceEnd100s = 0; // ramp: pace at the end of the step ("speed_end"), 0 = constant
+  uint16_t repeat = 0; // > 0: repeat block
+  uint16_t body = 0;   // block: entries in it
+  int16_t  paceStep = 0; // block: pace change per round (s/100 m, - = faster)
 };
 
 struct Workout {
   String id;                 // unique workout ID
   String name;
-  std::vector<SwimStep> steps;
+  std::vector<SwimStep> steps; // program entries, not expanded
 };
 
 namespace WorkoutStorage {
+  /* Limits enforced by from_json(); uploads outside them are rejected. */
+  constexpr size_t   kMaxSteps     = 256;      // program entries (steps + blocks)
+  constexpr uint32_t kMaxExpanded  = 2000;     // steps after expanding the repeats
+  constexpr uint32_t kMaxRepeat    = 100;
+  constexpr uint8_t  kMaxDepth     = WorkoutProgram::kMaxDepth;
+  constexpr uint32_t kMaxStepSec   = 90 * 60;  // the machine's own workout limit
+  constexpr uint32_t kMaxPace100s  = 3600;
+  constexpr size_t   kMaxNoteLen   = 128;      // longer notes are cut
+  constexpr size_t   kMaxTitleLen  = 64;
+
   /** Initialise LittleFS; must be called once in setup(). */
   bool begin();
 
-  /** List all workout IDs (reads /workouts/*.json). */
+  /** List all workout IDs (reads /workouts/<id>.json). */
   std::vector<String> list_ids();
 
   /** Load a single workout by ID. Returns false if not found. */
@@ -34,8 +53,12 @@ namespace WorkoutStorage {
   bool erase(String id);
 
 
-  /** JSON <→> Workout codecs. */
+  /** JSON <→> Workout codecs. to_json() returns "" if the workout does not fit;
+      from_json() returns false on malformed input and leaves w untouched. */
   String  to_json(const Workout &w);
+
+  /** The playback program of a workout (what SwimMachine::loadWorkout takes). */
+  WorkoutProgram::Program program(const Workout &w);
   
   bool from_json(const uint8_t *data, size_t len, Workout &w);
 }